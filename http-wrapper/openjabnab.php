@@ -1,61 +1,127 @@
 <?php
-	$socket = fsockopen("127.0.0.1", 8080);
-	if(!$socket)
-		echo "Problem with OpenJabNab !";
-	else
+	// Read exactly $length bytes from $socket, false on error
+	function ojn_read($socket, $length)
 	{
-		// Get raw data, if exist
-		$rawdata = file_get_contents("php://input");
-
-		// Types :
-		// 1 = GET
-		// 2 = Normal POST
-		// 3 = Raw POST
-		if($rawdata)
-			$type = 3;
-		else if ($_SERVER['REQUEST_METHOD'] == 'POST')
-			$type = 2;
-		else
-			$type = 1;
-		// Headers :
-		$headers = "";
-		foreach($_SERVER as $key => $value)
+		$data = "";
+		while(strlen($data) < $length)
 		{
-			if(strncmp($key, "HTTP_", 5) == 0)
-			{
-				$header_key = substr($key, 5);
-				$header_key = str_replace("_", "-", $header_key);
-				$headers .= $header_key . ": " . $value . "\r\n";
-			}
+			$chunk = fread($socket, $length - strlen($data));
+			if($chunk === false || $chunk === "")
+				return false;
+			$data .= $chunk;
 		}
-		switch($type)
+		return $data;
+	}
+
+	// A persistent socket closed by OpenJabNab (restart ...) is at EOF before anything is sent
+	// Data waiting here would be the answer of an aborted request, the socket can't be used either
+	function ojn_alive($socket)
+	{
+		stream_set_blocking($socket, false);
+		$data = fread($socket, 1);
+		stream_set_blocking($socket, true);
+		return $data === "" && !feof($socket);
+	}
+
+	// Send a v2 frame, false if it was not completely written
+	// OpenJabNab never runs an incomplete frame, so only then the request can be sent again
+	function ojn_send($socket, $type, $requestid, $requestdata)
+	{
+		$requestlen = 9 + strlen($requestdata);
+		$request = pack("LCLa*", $requestlen, $type | 0x80, $requestid, $requestdata);
+		return fwrite($socket, $request) === strlen($request);
+	}
+
+	// Read the answer of a v2 frame, false on error
+	function ojn_receive($socket, $requestid)
+	{
+		$header = ojn_read($socket, 8);
+		if($header === false)
+			return false;
+		$answer = unpack("Llength/Lid", $header);
+		if($answer['id'] != $requestid || $answer['length'] < 8)
+			return false;
+		if($answer['length'] == 8)
+			return "";
+		return ojn_read($socket, $answer['length'] - 8);
+	}
+
+	// Get raw data, if exist
+	$rawdata = file_get_contents("php://input");
+
+	// Types :
+	// 1 = GET
+	// 2 = Normal POST
+	// 3 = Raw POST
+	if($rawdata)
+		$type = 3;
+	else if ($_SERVER['REQUEST_METHOD'] == 'POST')
+		$type = 2;
+	else
+		$type = 1;
+	// Headers :
+	$headers = "";
+	foreach($_SERVER as $key => $value)
+	{
+		if(strncmp($key, "HTTP_", 5) == 0)
 		{
-			case 1: // GET
-				$requestdata = $headers . "\x00" . str_replace("+", " ", $_SERVER['REQUEST_URI']);
-				break;
-			case 2: // POST
-				if(isset($_SERVER["CONTENT_TYPE"]))
-					$headers .= "Content-Type: " . $_SERVER["CONTENT_TYPE"] . "\r\n";
-				if(isset($_SERVER["CONTENT_LENGTH"]))
-					$headers .= "Content-Length: " . $_SERVER["CONTENT_LENGTH"] . "\r\n";
-				$postdata_array = array();
-				foreach($_POST as $key => $value)
-						$postdata_array[] = urlencode($key) . "=" . urlencode($value);
-				$requestdata = $headers . "\x00" . $_SERVER['REQUEST_URI'] . "\x00" . implode($postdata_array, "&");
-				break;
-			case 3: // Raw Post
-				if(isset($_SERVER["CONTENT_LENGTH"]))
-					$headers .= "Content-Length: " . $_SERVER["CONTENT_LENGTH"] . "\r\n";
-				$requestdata = $headers . "\x00" . $_SERVER['REQUEST_URI'] . "\x00" . $rawdata;
-				break;
+			$header_key = substr($key, 5);
+			$header_key = str_replace("_", "-", $header_key);
+			$headers .= $header_key . ": " . $value . "\r\n";
 		}
-		$requestlen = 5 + strlen($requestdata);
-		$request = pack("LCa*", $requestlen, $type, $requestdata);
-
-		fwrite($socket, $request);
-		while (!feof($socket)) 
-			echo fgets($socket, 128);
+	}
+	switch($type)
+	{
+		case 1: // GET
+			$requestdata = $headers . "\x00" . str_replace("+", " ", $_SERVER['REQUEST_URI']);
+			break;
+		case 2: // POST
+			if(isset($_SERVER["CONTENT_TYPE"]))
+				$headers .= "Content-Type: " . $_SERVER["CONTENT_TYPE"] . "\r\n";
+			if(isset($_SERVER["CONTENT_LENGTH"]))
+				$headers .= "Content-Length: " . $_SERVER["CONTENT_LENGTH"] . "\r\n";
+			$postdata_array = array();
+			foreach($_POST as $key => $value)
+					$postdata_array[] = urlencode($key) . "=" . urlencode($value);
+			$requestdata = $headers . "\x00" . $_SERVER['REQUEST_URI'] . "\x00" . implode($postdata_array, "&");
+			break;
+		case 3: // Raw Post
+			if(isset($_SERVER["CONTENT_LENGTH"]))
+				$headers .= "Content-Length: " . $_SERVER["CONTENT_LENGTH"] . "\r\n";
+			$requestdata = $headers . "\x00" . $_SERVER['REQUEST_URI'] . "\x00" . $rawdata;
+			break;
+	}
 
+	// The socket is kept open by the PHP worker and reused by the next requests
+	$answer = false;
+	$socket = @pfsockopen("127.0.0.1", 8080);
+	if($socket && !ojn_alive($socket))
+	{
 		fclose($socket);
+		$socket = @pfsockopen("127.0.0.1", 8080);
 	}
+	if($socket)
+	{
+		$requestid = mt_rand(1, 0x7FFFFFFF);
+		$sent = ojn_send($socket, $type, $requestid, $requestdata);
+		if(!$sent)
+		{
+			// Nothing was run, retry once with a fresh socket
+			fclose($socket);
+			$socket = @pfsockopen("127.0.0.1", 8080);
+			if($socket)
+				$sent = ojn_send($socket, $type, $requestid, $requestdata);
+		}
+		// A request may have been run even if its answer is lost, it is never sent twice
+		if($sent)
+			$answer = ojn_receive($socket, $requestid);
+	}
+	if($answer === false)
+	{
+		if($socket)
+			fclose($socket);
+		echo "Problem with OpenJabNab !";
+	}
+	else
+		echo $answer;
 ?>
@@ -0,0 +1,87 @@
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QList>
+#include <QTextStream>
+#include "bench.h"
+#include "settings.h"
+#include "xmppclient.h"
+
+// DIGEST-MD5 handshakes per second : the server side computation, then full handshakes with a running server
+// Usage : bench_auth [handshakes] [concurrent handshakes] [host] [bunny password]
+
+#define MD5(x) QCryptographicHash::hash(x, QCryptographicHash::Md5)
+#define MD5_HEX(x) QCryptographicHash::hash(x, QCryptographicHash::Md5).toHex()
+
+// Same as PluginAuth
+static QByteArray ComputeResponse(QByteArray const& HA1, QByteArray const& nonce, QByteArray const& cnonce, QByteArray const& nc, QByteArray const& digest_uri, QByteArray const& mode)
+{
+	QByteArray HA2 = MD5_HEX(mode + ":" + digest_uri);
+	return MD5_HEX(HA1 + ":" + nonce + ":" + nc + ":" + cnonce + ":auth:" + HA2);
+}
+
+int main(int argc, char ** argv)
+{
+	QCoreApplication app(argc, argv);
+	GlobalSettings::Init(); // Same openjabnab.ini as the server
+	int handshakes = argc > 1 ? QString(argv[1]).toInt() : 5000;
+	int concurrent = qMax(1, argc > 2 ? QString(argv[2]).toInt() : 50);
+	QString host = argc > 3 ? QString(argv[3]) : QString("127.0.0.1");
+	QByteArray password = argc > 4 ? QByteArray(argv[4]) : QByteArray();
+	quint16 port = GlobalSettings::GetInt("OpenJabNabServers/ListeningXmppPort", 5222);
+	QByteArray domain = GlobalSettings::GetString("OpenJabNabServers/XmppServer").toAscii();
+
+	// Response check and rspauth, with the credential hashed each time as before, then cached by the bunny
+	QByteArray id = "0019dbc00000";
+	QByteArray nonce = "1804289383";
+	QByteArray cnonce = QByteArray("846930886") + QByteArray(1, (char)0);
+	QByteArray nc = "00000001";
+	QByteArray uri = "xmpp/" + domain;
+	int checksum = 0;
+	QElapsedTimer timer;
+	timer.start();
+	for(int i = 0; i < handshakes * 10; i++)
+	{
+		QByteArray HA1 = MD5_HEX(MD5(id + "::" + password) + ":" + nonce + ":" + cnonce);
+		checksum += ComputeResponse(HA1, nonce, cnonce, nc, uri, "AUTHENTICATE").at(0) + ComputeResponse(HA1, nonce, cnonce, nc, uri, "").at(0);
+	}
+	BenchReport("Digest, password hashed", handshakes * 10, timer.elapsed());
+	QByteArray credentialDigest = MD5(id + "::" + password);
+	timer.start();
+	for(int i = 0; i < handshakes * 10; i++)
+	{
+		QByteArray HA1 = MD5_HEX(credentialDigest + ":" + nonce + ":" + cnonce);
+		checksum += ComputeResponse(HA1, nonce, cnonce, nc, uri, "AUTHENTICATE").at(0) + ComputeResponse(HA1, nonce, cnonce, nc, uri, "").at(0);
+	}
+	BenchReport("Digest, credential cached", handshakes * 10, timer.elapsed());
+
+	// Stream, auth and rspauth round trips, then the stream restart, with a new connection each time
+	// Bunnies 0019dbc00000, 0019dbc00001 ...
+	int done = 0;
+	int failures = 0;
+	timer.start();
+	while(done < handshakes)
+	{
+		int count = qMin(concurrent, handshakes - done);
+		QList<BenchXmppClient *> clients;
+		BenchWaiter authenticated(count);
+		for(int i = 0; i < count; i++)
+		{
+			BenchXmppClient * c = new BenchXmppClient("0019db" + QByteArray::number(0xc00000 + i, 16), password, domain);
+			QObject::connect(c, SIGNAL(Authenticated()), &authenticated, SLOT(Done()));
+			QObject::connect(c, SIGNAL(Failed()), &authenticated, SLOT(Fail()));
+			c->Open(host, port, true);
+			clients << c;
+		}
+		authenticated.Wait();
+		foreach(BenchXmppClient * c, clients)
+			c->Close();
+		qDeleteAll(clients);
+		done += count;
+		failures += authenticated.Failures();
+	}
+	BenchReport("Handshakes", handshakes - failures, timer.elapsed());
+
+	GlobalSettings::Close();
+	return failures != 0 || checksum == 0;
+}
@@ -0,0 +1,16 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <QString>
+#include <QTextStream>
+#include <QtGlobal>
+
+// "<name> : <count> in <ms>ms, <rate>/s"
+inline void BenchReport(QString const& name, qint64 count, qint64 ms)
+{
+	QTextStream out(stdout);
+	qint64 rate = ms > 0 ? count * 1000 / ms : 0;
+	out << name << " : " << count << " in " << ms << "ms, " << rate << "/s" << endl;
+}
+
+#endif
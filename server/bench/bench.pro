@@ -0,0 +1,6 @@
+######################################################################
+# Benchmarks, not built with the server : qmake && make here, then run them from ../bin/
+######################################################################
+
+TEMPLATE = subdirs
+SUBDIRS = httprequest xmppreactor auth recordstore
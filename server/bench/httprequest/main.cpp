@@ -0,0 +1,111 @@
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QList>
+#include <QStringList>
+#include <cstring>
+#include "bench.h"
+#include "httprequest.h"
+#include "oldhttprequest.h"
+
+// Wrapper frames as read by HttpHandler::ReceiveWrapperData, several frames per read
+// The old parser (OldHTTPRequest) and the new one are compared on the same v1 frames, then the new one on v2 frames
+// Usage : bench_httprequest [rounds]
+
+static QByteArray Frame(HTTPRequest::RequestType type, quint32 id, QByteArray const& headers, QByteArray const& uri, QByteArray const& post = QByteArray(), bool v2 = true)
+{
+	QByteArray data = headers + '\0' + uri;
+	if(type != HTTPRequest::GET)
+		data += '\0' + post;
+	int headerSize = v2 ? (int)HTTPRequest::WrapperV2HeaderSize : 5;
+	int size = headerSize + data.size();
+	QByteArray frame(headerSize, 0);
+	memcpy(frame.data(), &size, 4);
+	frame[4] = (char)(v2 ? (type | HTTPRequest::WrapperV2Flag) : type);
+	if(v2)
+		memcpy(frame.data() + 5, &id, 4);
+	return frame + data;
+}
+
+// Each frame copied out of the received data, as ReceiveWrapperData did before
+template<class Request> static int ParseCopies(QByteArray const& read, int rounds)
+{
+	int checksum = 0;
+	for(int r = 0; r < rounds; r++)
+	{
+		QByteArray receivedData = read;
+		while(!receivedData.isEmpty())
+		{
+			int frameSize = *(int *)receivedData.constData();
+			QByteArray frame = receivedData.left(frameSize);
+			receivedData.remove(0, frameSize);
+			Request request(frame);
+			checksum += request.GetArg("sn").size() + request.GetURI().size() + request.GetPostArg("login").size();
+		}
+	}
+	return checksum;
+}
+
+int main(int argc, char ** argv)
+{
+	QCoreApplication app(argc, argv);
+	int rounds = argc > 1 ? QString(argv[1]).toInt() : 20000;
+
+	QByteArray headers = "HOST: 127.0.0.1\r\nUSER-AGENT: MTL\r\nACCEPT: */*\r\n";
+	QByteArray read;
+	QByteArray readV1;
+	for(int v2 = 1; v2 >= 0; v2--)
+	{
+		QByteArray & r = v2 ? read : readV1;
+		r += Frame(HTTPRequest::GET, 1, headers, "/vl/p4.jsp?sn=0019db001122&v=18673&st=1&sd=0&h=4&tc=7fffffff", QByteArray(), v2);
+		r += Frame(HTTPRequest::GET, 2, headers, "/ojn_api/bunny/0019db001122/clock/setVoice?voice=fr&token=3f2504e04f8941d39a0c0305e82c3301", QByteArray(), v2);
+		r += Frame(HTTPRequest::GET, 3, headers, "/ojn/FR/api.jsp?sn=0019db001122&token=1234567890&tts=Bonjour%20tout%20le%20monde", QByteArray(), v2);
+		r += Frame(HTTPRequest::POST, 4, headers + "Content-Type: application/x-www-form-urlencoded\r\n", "/ojn_api/accounts/auth", "login=admin&pass=secret", v2);
+		r += Frame(HTTPRequest::POSTRAW, 5, headers, "/vl/rfid.jsp?sn=0019db001122&t=d0021a0352aa1b2c", QByteArray(512, 'x'), v2);
+	}
+	qint64 count = (qint64)rounds * 5;
+	int checksum = 0;
+
+	// Old and new parsers, v1 frames copied out of the received data
+	QElapsedTimer timer;
+	timer.start();
+	checksum += ParseCopies<OldHTTPRequest>(readV1, rounds);
+	BenchReport("Old parser, copied frames", count, timer.elapsed());
+	timer.start();
+	checksum += ParseCopies<HTTPRequest>(readV1, rounds);
+	BenchReport("New parser, copied frames", count, timer.elapsed());
+
+	// Frames parsed in place, the requests share the received data
+	timer.start();
+	for(int r = 0; r < rounds; r++)
+	{
+		QByteArray receivedData = read;
+		int pos = 0;
+		while(pos < receivedData.size())
+		{
+			int frameSize = *(int *)(receivedData.constData() + pos);
+			HTTPRequest request(receivedData, pos, frameSize);
+			pos += frameSize;
+			checksum += request.GetArg("sn").size() + request.GetURI().size() + request.GetPostArg("login").size();
+		}
+		receivedData.clear();
+	}
+	BenchReport("New parser, v2 frames in place", count, timer.elapsed());
+
+	// Parsing only, arguments are decoded on demand
+	timer.start();
+	for(int r = 0; r < rounds; r++)
+	{
+		int pos = 0;
+		while(pos < read.size())
+		{
+			int frameSize = *(int *)(read.constData() + pos);
+			HTTPRequest request(read, pos, frameSize);
+			pos += frameSize;
+			checksum += request.GetURI().size();
+		}
+	}
+	BenchReport("New parser, v2 frames, parse only", count, timer.elapsed());
+
+	return checksum == 0;
+}
@@ -0,0 +1,64 @@
+#include <QList>
+#include <QPair>
+#include <QUrl>
+#include "log.h"
+#include "oldhttprequest.h"
+
+OldHTTPRequest::OldHTTPRequest(QByteArray const& data):type(INVALID)
+{
+	if (data.size() < 4 || *(int*)data.left(4).constData() != data.size())
+	{
+		LogError("HTTP Request : Invalid data");
+		return;
+	}
+	RequestType t = (RequestType)data.at(4);
+	QByteArray content = data.mid(5);
+	switch (t)
+	{
+		case GET:
+			rawHeaders = content.left(content.indexOf('\0')); // Copy headers, stop at first \x00
+			rawUri = content.mid(rawHeaders.length()+1); // Copy URI
+			type = GET;
+			break;
+			
+		case POST:
+		{
+			rawHeaders = content.left(content.indexOf('\0')); // Copy headers, stop at first \x00
+			content = content.mid(rawHeaders.length()+1);
+			rawUri = content.left(content.indexOf('\0')); // Copy URI
+			rawPostData = content.mid(rawUri.length()+1);
+			// Parse Post Data
+			QList<QByteArray> listOfParams = rawPostData.split('&');
+			foreach(QByteArray param, listOfParams)
+			{
+				QByteArray key = param.left(param.indexOf('='));
+				QByteArray value = param.mid(param.indexOf('=')+1);
+				formPostData[QUrl::fromPercentEncoding(key)] = QUrl::fromPercentEncoding(value);
+			}
+			type = POST;
+			break;
+		}
+		
+		case POSTRAW:
+			rawHeaders = content.left(content.indexOf('\0')); // Copy headers, stop at first \x00
+			content = content.mid(rawHeaders.length()+1);
+			rawUri = content.left(content.indexOf('\0')); // Copy URI
+			rawPostData = content.mid(rawUri.length()+1);
+			type = POSTRAW;
+			break;
+	
+		default:
+			LogError("HTTP Request : Invalid type");
+			return;
+	}
+	// Parse URI
+	QUrl url(rawUri);
+	uri = url.path();
+	if(url.hasQuery())
+	{
+		QList<QPair<QString, QString> > items = url.queryItems();
+		typedef QPair<QString, QString> queryItemDef;
+		foreach(queryItemDef item, items)
+			getData[QUrl::fromPercentEncoding(item.first.toAscii())] = QUrl::fromPercentEncoding(item.second.toAscii());
+	}
+}
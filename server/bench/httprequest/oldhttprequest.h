@@ -0,0 +1,30 @@
+#ifndef _OLDHTTPREQUEST_H_
+#define _OLDHTTPREQUEST_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+// Parser of HTTPRequest before the views and the lazy arguments, kept to compare them
+// Same parsing code, ForwardTo and toString left out
+class OldHTTPRequest
+{
+public:
+	enum RequestType { INVALID, GET, POST, POSTRAW };
+
+	OldHTTPRequest(QByteArray const&);
+	QString const& GetURI() const { return uri; }
+	QString GetArg(QString const& s) const { return getData.value(s, QString()); }
+	QString GetPostArg(QString const& s) const { return formPostData.value(s, QString()); }
+
+private:
+	QByteArray rawUri;
+	QByteArray rawHeaders;
+	QByteArray rawPostData;
+	QString uri;
+	QHash<QString, QString> getData;
+	QHash<QString, QString> formPostData;
+	RequestType type;
+};
+
+#endif
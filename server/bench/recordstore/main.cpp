@@ -0,0 +1,150 @@
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include <QVariant>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#include "bench.h"
+#include "recordstore.h"
+#include "settings.h"
+
+// Startup on a synthetic set of bunnies, with one config file per bunny and with the record store,
+// then the record store import done when the server stops (BunnyManager::Close)
+// Usage : bench_recordstore [bunnies] [percent changed before the stop]
+// The files are in the page cache, drop it between the steps to see a cold start
+
+// Same layout as Bunny::SaveConfig
+static QByteArray Snapshot(int i)
+{
+	QHash<QString, QVariant> globalSettings;
+	globalSettings.insert("BunnyName", QString("Bunny %1").arg(i));
+	globalSettings.insert("BunnyPassword", QByteArray("0123456789ab"));
+	globalSettings.insert("LastIP", QString("192.168.%1.%2").arg(i / 256 % 256).arg(i % 256));
+	globalSettings.insert("Last JabberConnection", QDateTime::currentDateTime());
+	globalSettings.insert("LastLocate", QDateTime::currentDateTime());
+	globalSettings.insert("LastLocateString", QString("ping my.domain.com\nbroad my.domain.com\nxmpp_domain my.domain.com:5222\n"));
+	globalSettings.insert("singleClickPlugin", QString("tts"));
+	QHash<QString, QHash<QString, QVariant> > pluginsSettings;
+	pluginsSettings["clock"].insert("voice", QString("fr"));
+	pluginsSettings["sleep"].insert("wakeupList", QStringList() << "08:00" << "08:00" << "08:00" << "08:00" << "08:00" << "10:00" << "10:00");
+	pluginsSettings["sleep"].insert("sleepList", QStringList() << "22:00" << "22:00" << "22:00" << "22:00" << "23:00" << "23:00" << "22:00");
+	QList<QString> listOfPlugins;
+	listOfPlugins << "clock" << "sleep" << "tts" << "weather" << "surprise";
+	QHash<QByteArray, QString> knownRFIDTags;
+	knownRFIDTags.insert("d0021a0352aa1b2c", "Ztamp");
+
+	QByteArray data;
+	QDataStream out(&data, QIODevice::WriteOnly);
+	out.setVersion(QDataStream::Qt_4_3);
+	out << globalSettings << pluginsSettings << listOfPlugins << knownRFIDTags;
+	return data;
+}
+
+// Same as Bunny::LoadConfig
+static int Decode(QByteArray const& snapshot)
+{
+	QHash<QString, QVariant> globalSettings;
+	QHash<QString, QHash<QString, QVariant> > pluginsSettings;
+	QList<QString> listOfPlugins;
+	QHash<QByteArray, QString> knownRFIDTags;
+	QDataStream in(snapshot);
+	in.setVersion(QDataStream::Qt_4_3);
+	in >> globalSettings >> pluginsSettings >> listOfPlugins >> knownRFIDTags;
+	return globalSettings.size() + listOfPlugins.size();
+}
+
+static QString FileName(QDir const& dir, int i)
+{
+	return dir.absoluteFilePath(QString("0019db%1.dat").arg(0xd00000 + i, 6, 16, QChar('0')));
+}
+
+static void WriteFile(QString const& fileName, QByteArray const& data, time_t modified)
+{
+	QFile f(fileName);
+	if(f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		f.write(data);
+	f.close();
+	if(modified)
+	{
+		struct utimbuf times;
+		times.actime = times.modtime = modified;
+		::utime(QFile::encodeName(fileName).constData(), &times);
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	QCoreApplication app(argc, argv);
+	GlobalSettings::Init(); // Log settings
+	int count = argc > 1 ? QString(argv[1]).toInt() : 50000;
+	int changedPercent = argc > 2 ? QString(argv[2]).toInt() : 1;
+	int checksum = 0;
+
+	QDir dir = QDir::temp();
+	QString name = QString("ojn-bench-%1").arg(::getpid());
+	dir.mkdir(name);
+	dir.cd(name);
+	// Written before the last stop
+	time_t past = QDateTime::currentDateTime().addSecs(-3600).toTime_t();
+	for(int i = 0; i < count; i++)
+		WriteFile(FileName(dir, i), Snapshot(i), past);
+	QString storeName = RecordStore::FileName(dir);
+
+	// One file per bunny : listed (bunnies loaded when first needed), then all of them read and decoded
+	QElapsedTimer timer;
+	timer.start();
+	QStringList filters;
+	filters << "*.dat";
+	QFileInfoList files = dir.entryInfoList(filters, QDir::Files);
+	checksum += files.size();
+	BenchReport("Startup, .dat files listed", files.size(), timer.elapsed());
+	timer.start();
+	foreach(QFileInfo f, files)
+	{
+		QFile in(f.absoluteFilePath());
+		if(in.open(QIODevice::ReadOnly))
+			checksum += Decode(in.readAll());
+	}
+	BenchReport("Startup, .dat files read and decoded", files.size(), timer.elapsed());
+
+	// First stop with the store enabled : every file is read
+	timer.start();
+	RecordStore::Import(dir, storeName);
+	BenchReport("Stop, import without store", count, timer.elapsed());
+
+	// Record store : index, then all of the bunnies decoded
+	RecordStore store;
+	timer.start();
+	store.Open(storeName);
+	QList<QByteArray> keys = store.Keys();
+	BenchReport("Startup, store index", keys.size(), timer.elapsed());
+	timer.start();
+	foreach(QByteArray key, keys)
+		checksum += Decode(store.GetSnapshot(key));
+	BenchReport("Startup, store decoded", keys.size(), timer.elapsed());
+
+	// Stops : unchanged records are copied from the previous store, changed files are read again
+	timer.start();
+	RecordStore::Import(dir, storeName, &store);
+	BenchReport("Stop, import, nothing changed", count, timer.elapsed());
+	int changed = (qint64)count * changedPercent / 100;
+	for(int i = 0; i < changed; i++)
+		WriteFile(FileName(dir, i), Snapshot(i + count), 0);
+	timer.start();
+	RecordStore::Import(dir, storeName, &store);
+	BenchReport(QString("Stop, import, %1 changed").arg(changed), count, timer.elapsed());
+	store.Close();
+
+	foreach(QString f, dir.entryList(QDir::Files))
+		dir.remove(f);
+	QFile::remove(storeName);
+	QDir::temp().rmdir(name);
+	GlobalSettings::Close();
+	return checksum == 0;
+}
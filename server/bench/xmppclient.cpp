@@ -0,0 +1,196 @@
+#include <QCryptographicHash>
+#include <QTextStream>
+#include <cstring>
+#include "xmppclient.h"
+
+#define MD5(x) QCryptographicHash::hash(x, QCryptographicHash::Md5)
+#define MD5_HEX(x) QCryptographicHash::hash(x, QCryptographicHash::Md5).toHex()
+
+BenchXmppClient::BenchXmppClient(QByteArray const& id, QByteArray const& pass, QByteArray const& d, QObject * parent):QObject(parent),bunnyID(id),password(pass),domain(d)
+{
+	state = State_Closed;
+	authenticate = false;
+	stanzasToSend = 0;
+	stanzasWaiting = 0;
+	window = 1;
+	nextId = 0;
+	connect(&socket, SIGNAL(connected()), this, SLOT(Connected()));
+	connect(&socket, SIGNAL(readyRead()), this, SLOT(ReceiveData()));
+	connect(&socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(SocketError()));
+}
+
+void BenchXmppClient::Open(QString const& host, quint16 port, bool auth)
+{
+	authenticate = auth;
+	receivedData.clear();
+	state = State_Connecting;
+	socket.connectToHost(host, port);
+}
+
+void BenchXmppClient::Close()
+{
+	if(state == State_Closed)
+		return;
+	state = State_Closed;
+	socket.write("</stream:stream>");
+	socket.disconnectFromHost();
+}
+
+void BenchXmppClient::SendStanzas(int count, int w)
+{
+	stanzasToSend = count;
+	stanzasWaiting = 0;
+	window = qMax(1, w);
+	SendPresences();
+}
+
+void BenchXmppClient::Connected()
+{
+	state = State_Stream;
+	OpenStream();
+}
+
+void BenchXmppClient::OpenStream()
+{
+	socket.write("<?xml version='1.0' encoding='UTF-8'?><stream:stream to='" + domain + "' xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' version='1.0'>");
+}
+
+// Same computation as PluginAuth, the bunny's side of it
+void BenchXmppClient::SendAuthResponse(QByteArray const& challengeStanza)
+{
+	// <challenge xmlns='urn:ietf:params:xml:ns:xmpp-sasl'>...</challenge>
+	int start = challengeStanza.indexOf('>', challengeStanza.lastIndexOf("<challenge")) + 1;
+	int end = challengeStanza.size() - (int)strlen("</challenge>");
+	QByteArray challenge = QByteArray::fromBase64(challengeStanza.mid(start, end - start));
+	int nonceStart = challenge.indexOf("nonce=\"") + 7;
+	QByteArray nonce = challenge.mid(nonceStart, challenge.indexOf('"', nonceStart) - nonceStart);
+
+	QByteArray cnonce = QByteArray::number(qrand());
+	QByteArray nc = "00000001";
+	QByteArray digestUri = "xmpp/" + domain;
+	QByteArray cnonce0 = cnonce + QByteArray(1, (char)0); // The bunny sends a dummy \0 after its cnonce
+	QByteArray HA1 = MD5_HEX(MD5(bunnyID + "::" + password) + ":" + nonce + ":" + cnonce0);
+	QByteArray HA2 = MD5_HEX("AUTHENTICATE:" + digestUri);
+	QByteArray response = MD5_HEX(HA1 + ":" + nonce + ":" + nc + ":" + cnonce0 + ":auth:" + HA2);
+
+	QByteArray authString = "username=\"" + bunnyID + "\",nonce=\"" + nonce + "\",cnonce=\"" + cnonce + "\",nc=" + nc + ",qop=auth,digest-uri=\"" + digestUri + "\",response=" + response + ",charset=utf-8";
+	socket.write("<response xmlns='urn:ietf:params:xml:ns:xmpp-sasl'>" + authString.toBase64() + "</response>");
+}
+
+void BenchXmppClient::SendPresences()
+{
+	while(stanzasToSend > 0 && stanzasWaiting < window)
+	{
+		socket.write("<presence from='" + bunnyID + "@" + domain + "/idle' id='" + QByteArray::number(nextId++) + "'/>");
+		stanzasToSend--;
+		stanzasWaiting++;
+	}
+}
+
+bool BenchXmppClient::Take(char const * marker, QByteArray * content)
+{
+	int i = receivedData.indexOf(marker);
+	if(i == -1)
+		return false;
+	int end = i + strlen(marker);
+	if(content)
+		*content = receivedData.left(end);
+	receivedData.remove(0, end);
+	return true;
+}
+
+void BenchXmppClient::ReceiveData()
+{
+	receivedData += socket.readAll();
+	if(receivedData.contains("<failure"))
+	{
+		Fail("Authentication failure");
+		return;
+	}
+	forever
+	{
+		switch(state)
+		{
+			case State_Stream:
+				if(!Take("</stream:features>"))
+					return;
+				state = authenticate ? State_Challenge : State_Ready;
+				emit Opened();
+				if(state == State_Challenge)
+					socket.write("<auth xmlns='urn:ietf:params:xml:ns:xmpp-sasl' mechanism='DIGEST-MD5'/>");
+				break;
+
+			case State_Challenge:
+				{
+					QByteArray challenge;
+					if(!Take("</challenge>", &challenge))
+						return;
+					SendAuthResponse(challenge);
+					state = State_RspAuth;
+				}
+				break;
+
+			case State_RspAuth:
+				// rspauth=..., or success right away with Config/StandAloneAuthBypass
+				if(Take("<success xmlns='urn:ietf:params:xml:ns:xmpp-sasl'/>"))
+				{
+					OpenStream();
+					state = State_Features;
+					break;
+				}
+				if(!Take("</challenge>"))
+					return;
+				socket.write("<response xmlns='urn:ietf:params:xml:ns:xmpp-sasl'/>");
+				state = State_Success;
+				break;
+
+			case State_Success:
+				if(!Take("<success xmlns='urn:ietf:params:xml:ns:xmpp-sasl'/>"))
+					return;
+				OpenStream();
+				state = State_Features;
+				break;
+
+			case State_Features:
+				if(!Take("</stream:features>"))
+					return;
+				state = State_Ready;
+				emit Authenticated();
+				break;
+
+			case State_Ready:
+				{
+					int answered = 0;
+					while(Take("<presence "))
+						answered++;
+					// Only a partial marker may be useful
+					if(receivedData.size() > 9)
+						receivedData.remove(0, receivedData.size() - 9);
+					if(!answered)
+						return;
+					stanzasWaiting -= answered;
+					SendPresences();
+					if(stanzasToSend == 0 && stanzasWaiting <= 0)
+						emit StanzasDone();
+				}
+				return;
+
+			default:
+				return;
+		}
+	}
+}
+
+void BenchXmppClient::SocketError()
+{
+	if(state != State_Closed)
+		Fail(socket.errorString());
+}
+
+void BenchXmppClient::Fail(QString const& reason)
+{
+	QTextStream(stderr) << bunnyID << " : " << reason << endl;
+	state = State_Closed;
+	socket.abort();
+	emit Failed();
+}
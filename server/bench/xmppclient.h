@@ -0,0 +1,100 @@
+#ifndef _XMPPCLIENT_H_
+#define _XMPPCLIENT_H_
+
+#include <QByteArray>
+#include <QEventLoop>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTcpSocket>
+
+// One bunny talking to a running server : stream, DIGEST-MD5 auth, then presence round trips
+// Bunnies are created by the server on their first auth, use a test server
+class BenchXmppClient : public QObject
+{
+	Q_OBJECT
+
+public:
+	BenchXmppClient(QByteArray const& bunnyID, QByteArray const& password, QByteArray const& domain, QObject * parent = 0);
+
+	// Opened() is emitted with the stream features, then Authenticated() if authenticate is set
+	void Open(QString const& host, quint16 port, bool authenticate);
+	// Send count presences, window of them waiting for their answer at once
+	void SendStanzas(int count, int window);
+	void Close();
+	// Closed or failed
+	bool IsClosed() const;
+
+signals:
+	void Opened();
+	void Authenticated();
+	void StanzasDone();
+	void Failed();
+
+private slots:
+	void Connected();
+	void ReceiveData();
+	void SocketError();
+
+private:
+	enum State { State_Closed, State_Connecting, State_Stream, State_Challenge, State_RspAuth, State_Success, State_Features, State_Ready };
+
+	void OpenStream();
+	void SendAuthResponse(QByteArray const& challenge);
+	void SendPresences();
+	// Removes the data received up to the end of marker, returns false if it isn't there yet
+	bool Take(char const * marker, QByteArray * content = 0);
+	void Fail(QString const& reason);
+
+	QTcpSocket socket;
+	QByteArray bunnyID;
+	QByteArray password;
+	QByteArray domain;
+	QByteArray receivedData;
+	State state;
+	bool authenticate;
+	int stanzasToSend;
+	int stanzasWaiting;
+	int window;
+	int nextId;
+};
+
+// Runs the event loop until each client sent the signal it is connected to, or Failed()
+class BenchWaiter : public QObject
+{
+	Q_OBJECT
+
+public:
+	BenchWaiter(int count):remaining(count),failed(0) {}
+	void Wait() { if(remaining > 0) loop.exec(); }
+	int Failures() const { return failed; }
+
+public slots:
+	void Done() { Count(false); }
+	void Fail() { Count(true); }
+
+private:
+	// A client counts once, it may fail after it was done
+	void Count(bool failure)
+	{
+		if(counted.contains(sender()))
+			return;
+		counted.insert(sender());
+		if(failure)
+			failed++;
+		if(--remaining == 0)
+			loop.quit();
+	}
+
+	int remaining;
+	int failed;
+	QSet<QObject *> counted;
+	QEventLoop loop;
+};
+
+inline bool BenchXmppClient::IsClosed() const
+{
+	return state == State_Closed;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QList>
+#include <QTextStream>
+#include "bench.h"
+#include "settings.h"
+#include "xmppclient.h"
+
+// Connections and stanzas per second of a running server, for its Config/XmppReactorThreads
+// With reactor threads, parsing, authentication and answers are done by them, the main thread
+// only gets the bunny state changes and the plugin calls
+// Restart the server with another number of reactor threads to compare them
+// Usage : bench_xmppreactor [connections] [stanzas per connection] [stanzas in flight] [host] [bunny password]
+
+int main(int argc, char ** argv)
+{
+	QCoreApplication app(argc, argv);
+	GlobalSettings::Init(); // Same openjabnab.ini as the server
+	int connections = argc > 1 ? QString(argv[1]).toInt() : 500;
+	int stanzas = argc > 2 ? QString(argv[2]).toInt() : 200;
+	int window = argc > 3 ? QString(argv[3]).toInt() : 4;
+	QString host = argc > 4 ? QString(argv[4]) : QString("127.0.0.1");
+	QByteArray password = argc > 5 ? QByteArray(argv[5]) : QByteArray();
+	quint16 port = GlobalSettings::GetInt("OpenJabNabServers/ListeningXmppPort", 5222);
+	QByteArray domain = GlobalSettings::GetString("OpenJabNabServers/XmppServer").toAscii();
+	QTextStream(stdout) << "Config/XmppReactorThreads = " << GlobalSettings::GetInt("Config/XmppReactorThreads", 0) << ", " << connections << " connections" << endl;
+
+	// Bunnies 0019dbb00000, 0019dbb00001 ...
+	QList<BenchXmppClient *> clients;
+	for(int i = 0; i < connections; i++)
+		clients << new BenchXmppClient("0019db" + QByteArray::number(0xb00000 + i, 16), password, domain);
+
+	// Stream features received, then authenticated
+	BenchWaiter opened(connections);
+	BenchWaiter authenticated(connections);
+	QElapsedTimer timer;
+	timer.start();
+	foreach(BenchXmppClient * c, clients)
+	{
+		QObject::connect(c, SIGNAL(Opened()), &opened, SLOT(Done()));
+		QObject::connect(c, SIGNAL(Failed()), &opened, SLOT(Fail()));
+		QObject::connect(c, SIGNAL(Authenticated()), &authenticated, SLOT(Done()));
+		QObject::connect(c, SIGNAL(Failed()), &authenticated, SLOT(Fail()));
+		c->Open(host, port, true);
+	}
+	opened.Wait();
+	BenchReport("Connections", connections - opened.Failures(), timer.elapsed());
+	authenticated.Wait();
+	BenchReport("Connections authenticated", connections - authenticated.Failures(), timer.elapsed());
+
+	// Presence round trips, answered by XmppHandler::OnPresence in the connection's thread
+	QList<BenchXmppClient *> ready;
+	foreach(BenchXmppClient * c, clients)
+		if(!c->IsClosed())
+			ready << c;
+	BenchWaiter answered(ready.size());
+	timer.start();
+	foreach(BenchXmppClient * c, ready)
+	{
+		QObject::connect(c, SIGNAL(StanzasDone()), &answered, SLOT(Done()));
+		QObject::connect(c, SIGNAL(Failed()), &answered, SLOT(Fail()));
+		c->SendStanzas(stanzas, window);
+	}
+	answered.Wait();
+	BenchReport("Stanzas", (qint64)(ready.size() - answered.Failures()) * stanzas, timer.elapsed());
+
+	foreach(BenchXmppClient * c, clients)
+		c->Close();
+	qDeleteAll(clients);
+	GlobalSettings::Close();
+	return authenticated.Failures() + answered.Failures() != 0;
+}
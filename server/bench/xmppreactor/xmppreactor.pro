@@ -0,0 +1,20 @@
+TEMPLATE = app
+CONFIG += qt release console
+CONFIG -= debug
+QT += network
+QT -= gui
+TARGET = bench_xmppreactor
+DESTDIR = ../../bin/
+DEPENDPATH += . .. ../../lib/
+INCLUDEPATH += . .. ../../lib/
+LIBS += -L../../bin/ -lcommon
+MOC_DIR = ./tmp/moc
+OBJECTS_DIR = ./tmp/obj
+unix {
+	QMAKE_LFLAGS += -Wl,-rpath,\'\$$ORIGIN\'
+	QMAKE_CXXFLAGS += -Werror
+}
+
+# Input
+HEADERS += ../bench.h ../xmppclient.h
+SOURCES += main.cpp ../xmppclient.cpp
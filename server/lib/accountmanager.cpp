@@ -4,6 +4,7 @@
 #include <QDir>
 #include <QFile>
 #include <QLibrary>
+#include <QMutexLocker>
 #include <QString>
 #include <QUuid>
 #include "account.h"
@@ -11,6 +12,7 @@
 #include "apimanager.h"
 #include "bunny.h"
 #include "bunnymanager.h"
+#include "configwriter.h"
 #include "ztamp.h"
 #include "bunnymanager.h"
 #include "log.h"
@@ -45,34 +47,30 @@ AccountManager::~AccountManager()
 
 void AccountManager::LoadAccounts()
 {
-	LogInfo(QString("Finding accounts in : %1").arg(accountsDir.path()));
-	/* Apply filters on accounts files */
-	QStringList filters;
-	filters << "*.dat";
-	accountsDir.setNameFilters(filters);
-	foreach (QFileInfo ffile, accountsDir.entryInfoList(QDir::Files))
+	if(RecordStore::IsEnabled() && store.Open(RecordStore::FileName(accountsDir)))
 	{
-		/* Open File */
-		QByteArray configFileName = accountsDir.absoluteFilePath(ffile.fileName().toAscii()).toAscii();
-		QFile file(configFileName);
-		if (!file.open(QIODevice::ReadOnly))
-		{
-			LogError(QString("Cannot open config file for reading : %1").arg(QString(configFileName)));
-			continue;
-		}
-		QDataStream in(&file);
-		in.setVersion(QDataStream::Qt_4_3);
-		int version;
-		in >> version;
-		Account * a = new Account(in, version);
-		if (in.status() != QDataStream::Ok)
+		foreach(QByteArray login, store.Keys())
+			LoadAccount(store.GetSnapshot(login), accountsDir.absoluteFilePath(QString::fromUtf8(login) + ".dat"));
+	}
+	else
+	{
+		LogInfo(QString("Finding accounts in : %1").arg(accountsDir.path()));
+		/* Apply filters on accounts files */
+		QStringList filters;
+		filters << "*.dat";
+		accountsDir.setNameFilters(filters);
+		foreach (QFileInfo ffile, accountsDir.entryInfoList(QDir::Files))
 		{
-			LogWarning(QString("Problem when loading config file for account: %1").arg(QString(configFileName)));
-			delete a;
-			continue;
+			/* Open File */
+			QByteArray configFileName = accountsDir.absoluteFilePath(ffile.fileName().toAscii()).toAscii();
+			QFile file(configFileName);
+			if (!file.open(QIODevice::ReadOnly))
+			{
+				LogError(QString("Cannot open config file for reading : %1").arg(QString(configFileName)));
+				continue;
+			}
+			LoadAccount(file.readAll(), configFileName);
 		}
-		listOfAccounts.append(a);
-		listOfAccountsByName.insert(a->GetLogin(), a);
 	}
 
 	/* Bound to disappear on next releases */
@@ -118,25 +116,38 @@ void AccountManager::LoadAccounts()
 	LogInfo(QString("Total of accounts: %1").arg(listOfAccounts.count()));
 }
 
+void AccountManager::LoadAccount(QByteArray const& data, QString const& configFileName)
+{
+	QDataStream in(data);
+	in.setVersion(QDataStream::Qt_4_3);
+	int version;
+	in >> version;
+	Account * a = new Account(in, version);
+	if (in.status() != QDataStream::Ok)
+	{
+		LogWarning(QString("Problem when loading config file for account: %1").arg(configFileName));
+		delete a;
+		return;
+	}
+	listOfAccounts.append(a);
+	listOfAccountsByName.insert(a->GetLogin(), a);
+}
+
 void AccountManager::SaveAccounts()
 {
 	/* For each loaded account */
 	foreach(Account * a, listOfAccounts) {
 			/* Skip default admin */
 			if(a->GetLogin() != "admin") {
-				/* Select file */
-				QFile accountFile(accountsDir.absoluteFilePath(QString("%1.dat").arg(a->GetLogin())));
-				/* Open it, write access */
-				if(accountFile.open(QIODevice::WriteOnly))
-				{
-					/* Save Version */
-					QDataStream out(&accountFile);
-					out.setVersion(QDataStream::Qt_4_3);
-					out << Account::Version();
-					/* Save Data */
-					out << *a;
-				}	else
-					LogError(QString("Can't open %1.dat, account will not be saved").arg(a->GetLogin()));
+				QByteArray data;
+				QDataStream out(&data, QIODevice::WriteOnly);
+				out.setVersion(QDataStream::Qt_4_3);
+				/* Save Version */
+				out << Account::Version();
+				/* Save Data */
+				out << *a;
+				/* Written by the ConfigWriter thread */
+				ConfigWriter::Write(accountsDir.absoluteFilePath(QString("%1.dat").arg(a->GetLogin())), data);
 		}
 	}
 }
@@ -151,6 +162,7 @@ void AccountManager::DeleteAccount(QByteArray const& login) {
 		listOfAccounts.removeAll(a);
 		QFile accountFile(accountsDir.absoluteFilePath(QString("%1.dat").arg(a->GetLogin())));
 		delete a;
+		ConfigWriter::Wait(accountFile.fileName());
 		if(accountFile.exists())
 			accountFile.remove();
 	}
@@ -164,6 +176,7 @@ Account const& AccountManager::Guest()
 
 Account const& AccountManager::GetAccount(QByteArray const& token)
 {
+	QMutexLocker locker(&tokensLock);
 	QHash<QByteArray, TokenData>::iterator it = listOfTokens.find(token);
 	if(it != listOfTokens.end())
 	{
@@ -202,6 +215,7 @@ QByteArray AccountManager::GetToken(QString const& login, QByteArray const& hash
 			t.account = *it;
 			t.expire_time = QDateTime::currentDateTime().toTime_t() + GlobalSettings::GetInt("Config/SessionTimeout", 300);
 			(*it)->SetToken(token);
+			QMutexLocker locker(&tokensLock);
 			listOfTokens.insert(token, t);
 			return token;
 		}
@@ -301,6 +315,7 @@ API_CALL(AccountManager::Api_RemoveAccount)
 	listOfAccounts.removeAt(indexOfAccount);
 	listOfAccountsByName.remove(a->GetLogin());
 	QFile accountFile(accountsDir.absoluteFilePath(QString("%1.dat").arg(a->GetLogin())));
+	ConfigWriter::Wait(accountFile.fileName());
 	if(accountFile.remove())
 		return new ApiManager::ApiOk(QString("Account %1 removed").arg(login));
 	return new ApiManager::ApiError(QString("Error when removing account %1").arg(login));
@@ -402,7 +417,9 @@ API_CALL(AccountManager::Api_GetUserInfos)
 	list.insert("login",ac->GetLogin());
 	list.insert("username",ac->GetUsername());
 	list.insert("language",ac->GetLanguage());
+	tokensLock.lock();
 	list.insert("isValid",listOfTokens.contains(ac->GetToken()));
+	tokensLock.unlock();
 	list.insert("token",QString(ac->GetToken()));
 	list.insert("isAdmin",ac->IsAdmin());
 	return new ApiManager::ApiMappedList(list);
@@ -428,6 +445,7 @@ API_CALL(AccountManager::Api_GetConnectedUsers)
 		return new ApiManager::ApiError("Access denied");
 
 	QList<QString> list;
+	QMutexLocker locker(&tokensLock);
 	foreach (Account* a, listOfAccounts)
 		if(listOfTokens.contains(a->GetToken()))
 			list.append(a->GetLogin());
@@ -5,10 +5,12 @@
 #include <QList>
 #include <QDir>
 #include <QHash>
+#include <QMutex>
 #include "global.h"
 #include "account.h"
 #include "apihandler.h"
 #include "apimanager.h"
+#include "recordstore.h"
 
 typedef struct {
 	Account * account;
@@ -34,14 +36,17 @@ protected:
 private:
 	AccountManager();
 	void LoadAccounts();
+	void LoadAccount(QByteArray const& data, QString const& name);
 	void SaveAccounts();
 	static void InitApiCalls();
 	void DeleteAccount(QByteArray const&);
 
 	QDir accountsDir;
+	RecordStore store; // Config/UseRecordStore
 	QList<Account *> listOfAccounts;
 	QHash<QString, Account *> listOfAccountsByName;
 	QHash<QByteArray, TokenData> listOfTokens;
+	QMutex tokensLock; // GetAccount is also called by Api worker threads
 
 	// API
 	API_CALL(Api_Auth);
@@ -69,7 +74,12 @@ inline void AccountManager::Init()
 
 inline void AccountManager::Close()
 {
-	Instance().SaveAccounts();
+	AccountManager & m = Instance();
+	m.SaveAccounts();
+	// The store is written for the next start
+	if(RecordStore::IsEnabled())
+		RecordStore::Import(m.accountsDir, RecordStore::FileName(m.accountsDir), &m.store);
+	m.store.Close();
 }
 
 #endif
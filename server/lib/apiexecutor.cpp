@@ -0,0 +1,139 @@
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <memory>
+#include "apiexecutor.h"
+#include "apimanager.h"
+#include "bunny.h"
+#include "bunnymanager.h"
+#include "log.h"
+#include "plugininterface.h"
+#include "pluginmanager.h"
+#include "settings.h"
+
+ApiTask::ApiTask(QString const& c, HTTPRequest const& r, QString const& s):call(c),request(r),strand(s)
+{
+	setAutoDelete(false);
+}
+
+void ApiTask::run()
+{
+	std::auto_ptr<ApiManager::ApiAnswer> apianswer(ApiManager::Instance().ProcessApiCall(call, request));
+	answer = apianswer->GetData();
+	ApiExecutor::Instance().TaskDone(this);
+	emit Finished();
+	deleteLater();
+}
+
+ApiExecutor::ApiExecutor():pool(0) {}
+
+ApiExecutor & ApiExecutor::Instance()
+{
+	static ApiExecutor e;
+	return e;
+}
+
+void ApiExecutor::Init()
+{
+	int threads = GlobalSettings::GetInt("Config/ApiWorkerThreads", 0);
+	if(threads <= 0)
+		return;
+	Instance().pool = new QThreadPool();
+	Instance().pool->setMaxThreadCount(threads);
+	LogInfo(QString("Api calls are run on %1 worker threads").arg(threads));
+}
+
+void ApiExecutor::Close()
+{
+	if(Instance().pool)
+	{
+		Instance().pool->waitForDone();
+		delete Instance().pool;
+		Instance().pool = 0;
+	}
+}
+
+bool ApiExecutor::IsMainThread()
+{
+	return QThread::currentThread() == QCoreApplication::instance()->thread();
+}
+
+bool ApiExecutor::HasPendingTasks(QString const& strand)
+{
+	QMutexLocker locker(&strandsLock);
+	return strands.contains(strand);
+}
+
+void ApiExecutor::WaitForStrand(QString const& strand)
+{
+	QMutexLocker locker(&strandsLock);
+	while(strands.contains(strand))
+		strandDone.wait(&strandsLock);
+}
+
+// Only calls known to be safe out of the main thread get a strand :
+// Violet api, and bunny/plugin calls of plugins flagged with IsApiThreadSafe
+QString ApiExecutor::GetStrand(QString const& call, HTTPRequest const& request) const
+{
+	if(call.startsWith("/ojn/FR/api"))
+	{
+		// Bunnies are only created on the main thread
+		Bunny * b = BunnyManager::GetBunny(request.GetArg("sn").toAscii());
+		return b ? "bunny/" + b->GetID() : QString();
+	}
+
+	QStringList list = call.split('/', QString::SkipEmptyParts);
+	if(list.size() == 4 && list.at(0) == "bunny")
+	{
+		PluginInterface * plugin = PluginManager::Instance().GetPluginByName(list.at(2));
+		if(!plugin || !plugin->IsApiThreadSafe())
+			return QString();
+		Bunny * b = BunnyManager::GetBunny(list.at(1).toAscii());
+		return b ? "bunny/" + b->GetID() : QString();
+	}
+	if(list.size() == 3 && list.at(0) == "plugin")
+	{
+		PluginInterface * plugin = PluginManager::Instance().GetPluginByName(list.at(1));
+		if(plugin && plugin->IsApiThreadSafe())
+			return "plugin/" + plugin->GetName();
+	}
+	return QString();
+}
+
+ApiTask * ApiExecutor::Submit(QString const& call, HTTPRequest const& request, QObject * receiver, char const * slot)
+{
+	if(!pool)
+		return 0;
+	QString strand = GetStrand(call, request);
+	if(strand.isNull())
+		return 0;
+
+	ApiTask * task = new ApiTask(call, request, strand);
+	QObject::connect(task, SIGNAL(Finished()), receiver, slot, Qt::QueuedConnection);
+
+	QMutexLocker locker(&strandsLock);
+	QQueue<ApiTask *> & queue = strands[strand];
+	queue.enqueue(task);
+	if(queue.count() == 1)
+		pool->start(task);
+	return task;
+}
+
+// Start the next task of the strand, if any
+void ApiExecutor::TaskDone(ApiTask * task)
+{
+	QMutexLocker locker(&strandsLock);
+	QHash<QString, QQueue<ApiTask *> >::iterator it = strands.find(task->strand);
+	if(it == strands.end())
+		return;
+	it->dequeue();
+	if(it->isEmpty())
+	{
+		strands.erase(it);
+		strandDone.wakeAll();
+	}
+	else
+		pool->start(it->head());
+}
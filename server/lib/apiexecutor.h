@@ -0,0 +1,73 @@
+#ifndef _APIEXECUTOR_H_
+#define _APIEXECUTOR_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QRunnable>
+#include <QWaitCondition>
+#include <QString>
+#include "global.h"
+#include "httprequest.h"
+
+class QThreadPool;
+// One Api call run by a worker thread, Finished() is received in the caller's thread
+class OJN_EXPORT ApiTask : public QObject, public QRunnable
+{
+	Q_OBJECT
+	friend class ApiExecutor;
+public:
+	ApiTask(QString const& call, HTTPRequest const& request, QString const& strand);
+	void run();
+	QByteArray const& GetAnswer() const;
+
+signals:
+	// The task is deleted once this signal is processed
+	void Finished();
+
+private:
+	QString call;
+	HTTPRequest request;
+	QString strand;
+	QByteArray answer;
+};
+
+// Runs Api calls on Config/ApiWorkerThreads threads
+// Calls on the same bunny (or plugin) share a strand and are run one after the other
+class OJN_EXPORT ApiExecutor
+{
+	friend class ApiTask;
+public:
+	static ApiExecutor & Instance();
+	static void Init();
+	static void Close();
+
+	// Returns 0 if the call has to be run synchronously on the main thread
+	ApiTask * Submit(QString const& call, HTTPRequest const& request, QObject * receiver, char const * slot);
+
+	static bool IsMainThread();
+	// True while a task of the strand is queued or running
+	bool HasPendingTasks(QString const& strand);
+	// Blocks until the tasks of the strand are done, before deleting what they use
+	// No task of the strand must be submitted meanwhile
+	void WaitForStrand(QString const& strand);
+
+private:
+	ApiExecutor();
+	QString GetStrand(QString const& call, HTTPRequest const& request) const;
+	void TaskDone(ApiTask *);
+
+	QThreadPool * pool;
+	QMutex strandsLock;
+	QWaitCondition strandDone;
+	QHash<QString, QQueue<ApiTask *> > strands; // The head of each queue is running
+};
+
+inline QByteArray const& ApiTask::GetAnswer() const
+{
+	return answer;
+}
+
+#endif
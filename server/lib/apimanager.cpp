@@ -9,6 +9,7 @@
 #include "httprequest.h"
 #include "plugininterface.h"
 #include "pluginmanager.h"
+#include "responsecache.h"
 #include "ttsmanager.h"
 
 ApiManager::ApiManager()
@@ -80,10 +81,21 @@ ApiManager::ApiAnswer * ApiManager::ProcessGlobalApiCall(Account const& account,
 	}
 	else if(request == "ping")
 	{
-		return new ApiManager::ApiString(QString::number(BunnyManager::Instance().GetConnectedBunnyCount()) + "/" + QString::number(GlobalSettings::GetInt("Config/MaxNumberOfBunnies", 64)) + "/" + QString::number(GlobalSettings::GetInt("Config/MaxBurstNumberOfBunnies", GlobalSettings::GetInt("Config/MaxNumberOfBunnies", 64))));
+		QByteArray ping;
+		if(!ResponseCache::Instance().Get(ResponseCache::PingKey, ping))
+		{
+			ping = (QString::number(BunnyManager::Instance().GetConnectedBunnyCount()) + "/" + QString::number(GlobalSettings::GetInt("Config/MaxNumberOfBunnies", 64)) + "/" + QString::number(GlobalSettings::GetInt("Config/MaxBurstNumberOfBunnies", GlobalSettings::GetInt("Config/MaxNumberOfBunnies", 64)))).toAscii();
+			ResponseCache::Instance().Insert(ResponseCache::PingKey, ping);
+		}
+		return new ApiManager::ApiString(QString(ping));
 	}
 	else if (request == "stats")
 	{
+		// Invalidated by ResponseCache::ServerStatsChanged
+		QByteArray cached;
+		if(ResponseCache::Instance().Get(ResponseCache::StatsKey, cached))
+			return new ApiManager::ApiXml(QString(cached));
+
 		int bunnies = BunnyManager::Instance().GetBunnyCount();
 		int connectedBunnies = BunnyManager::Instance().GetConnectedBunnyCount();
 
@@ -97,6 +109,7 @@ ApiManager::ApiAnswer * ApiManager::ProcessGlobalApiCall(Account const& account,
 		stats += "<ztamps>" + QString::number(ztamps) + "</ztamps>";
 		stats += "<plugins>" + QString::number(plugins) + "</plugins>";
 		stats += "<enabled_plugins>" + QString::number(enabledPlugins) + "</enabled_plugins>";
+		ResponseCache::Instance().Insert(ResponseCache::StatsKey, stats.toAscii());
 		return new ApiManager::ApiXml(stats);
 	}
 
@@ -143,6 +156,8 @@ ApiManager::ApiAnswer * ApiManager::ProcessBunnyApiCall(Account const& account,
 		return new ApiManager::ApiError("Access denied to this bunny");
 
 	Bunny * b = BunnyManager::GetBunny(bunnyID);
+	if(!b)
+		return new ApiManager::ApiError(QString("Unknown bunny : %1").arg(QString(bunnyID)));
 
 	if(list.size() == 2)
 	{
@@ -177,6 +192,8 @@ ApiManager::ApiAnswer * ApiManager::ProcessBunnyVioletApiCall(QString const& req
 	QString serial = hRequest.GetArg("sn");
 
 	Bunny * b = BunnyManager::GetBunny(serial.toAscii());
+	if(!b)
+		return new ApiManager::ApiError(QString("Unknown bunny : %1").arg(serial));
 
 	if(list.size() == 3)
 	{
@@ -4,15 +4,22 @@
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
+#include <QMetaObject>
+#include <QStringList>
+#include <QThread>
 #include "ambientpacket.h"
 #include "messagepacket.h"
 #include "choregraphy.h"
 #include "bunny.h"
+#include "configwriter.h"
 #include "log.h"
 #include "httprequest.h"
 #include "netdump.h"
 #include "plugininterface.h"
 #include "pluginmanager.h"
+#include "recordstore.h"
+#include "responsecache.h"
+#include "sessionstore.h"
 #include "sleeppacket.h"
 #include "xmpphandler.h"
 #include "account.h"
@@ -21,7 +28,9 @@
 #define SINGLE_CLICK_PLUGIN_SETTINGNAME "singleClickPlugin"
 #define DOUBLE_CLICK_PLUGIN_SETTINGNAME "doubleClickPlugin"
 
-Bunny::Bunny(QByteArray const& bunnyID)
+QAtomicInt Bunny::initPacketsGeneration;
+
+Bunny::Bunny(QByteArray const& bunnyID, RecordStore const * store)
 {
 	// Init click plugins
 	singleClickPlugin = NULL;
@@ -38,18 +47,31 @@ Bunny::Bunny(QByteArray const& bunnyID)
 		}
 		bunniesDir.cd("bunnies");
 	}
-	id = bunnyID;
+	id = bunnyID.toHex();
 	state = State_Disconnected;
-	configFileName = bunniesDir.absoluteFilePath(bunnyID.toHex()+".dat");
+	configFileName = bunniesDir.absoluteFilePath(id+".dat");
 	xmppHandler = 0;
+	initPacketGeneration = initPacketsGeneration;
+	initPacketChanges = 0;
+	journal.SetOwner(this);
 
 	// Check if config file exists and load it
-	if (QFile::exists(configFileName))
-		LoadConfig();
-
-	saveTimer = new QTimer(this);
-	connect(saveTimer, SIGNAL(timeout()), this, SLOT(SaveConfig()));
-	saveTimer->start(5*60*1000); // 5min
+	if (store && store->Contains(id))
+	{
+		QByteArray changes = store->GetJournal(id);
+		journal.SetFileName(configFileName, changes.size());
+		LoadConfig(store->GetSnapshot(id), journal.Load(changes));
+	}
+	else
+	{
+		// An evicted bunny can still be being saved
+		ConfigWriter::Wait(configFileName);
+		journal.SetFileName(configFileName);
+		if (QFile::exists(configFileName))
+			LoadConfig();
+	}
+	// Saved with its session ticket at the last stop
+	SessionStore::Instance().TakeInitPacket(id, initPacket, initPacketExpiry);
 }
 
 ApiManager::ApiAnswer * Bunny::ProcessVioletApiCall(HTTPRequest const& hRequest)
@@ -158,7 +180,7 @@ ApiManager::ApiAnswer * Bunny::ProcessVioletApiCall(HTTPRequest const& hRequest)
 						}
 		                                if(hRequest.HasArg("tts"))
 		                                {
-							SendPacket(MessagePacket("MU "+TTSManager::CreateNewSound(hRequest.GetArg("tts"), voice)+"\nPL 3\nMW\n"));
+							SendTTSMessage(hRequest.GetArg("tts"), voice, "MU %1\nPL 3\nMW\n");
                 		                        answer->AddMessage("TTSSENT", "Your text has been sent");
 		                                }
                 		                if(hRequest.HasArg("ears"))
@@ -226,6 +248,7 @@ ApiManager::ApiAnswer * Bunny::ProcessVioletApiCall(HTTPRequest const& hRequest)
 
 Bunny::~Bunny()
 {
+	PersistenceScheduler::Unschedule(this);
 	SaveConfig();
 }
 
@@ -255,15 +278,30 @@ void Bunny::LoadConfig()
 		LogError(QString("Cannot open config file for reading : %1").arg(configFileName));
 		return;
 	}
+	LoadConfig(file.readAll(), journal.Load());
+}
 
-	QDataStream in(&file);
+void Bunny::LoadConfig(QByteArray const& snapshot, QList<ConfigJournal::Record> const& changes)
+{
+	QDataStream in(snapshot);
 	in.setVersion(QDataStream::Qt_4_3);
 	in >> GlobalSettings >> PluginsSettings >> listOfPlugins;
 	if (in.status() != QDataStream::Ok)
 	{
-		LogWarning(QString("Problem when loading config file for bunny : %1").arg(QString(id.toHex())));
+		LogWarning(QString("Problem when loading config file for bunny : %1").arg(QString(id)));
 	}
 
+	// Added to config file, listOfRFIDTags
+	if(!in.atEnd())
+	{
+		// Load Known RFID Tags
+		in >> knownRFIDTags;
+	}
+
+	// Changes made since the config file was written
+	foreach(ConfigJournal::Record r, changes)
+		ReplayRecord(r);
+
 	// "Load" associated bunny plugins
 	foreach(QString s, listOfPlugins)
 	{
@@ -313,35 +351,67 @@ void Bunny::LoadConfig()
 	{
 		doubleClickPlugin = NULL;
 	}
+}
 
-	// Added to config file, listOfRFIDTags
-	if(!in.atEnd())
+void Bunny::ReplayRecord(ConfigJournal::Record const& r)
+{
+	switch(r.operation)
 	{
-		// Load Known RFID Tags
-		in >> knownRFIDTags;
+		case ConfigJournal::SetGlobal:
+			GlobalSettings.insert(r.key, r.value);
+			break;
+		case ConfigJournal::RemoveGlobal:
+			GlobalSettings.remove(r.key);
+			break;
+		case ConfigJournal::SetPlugin:
+			PluginsSettings[r.plugin].insert(r.key, r.value);
+			break;
+		case ConfigJournal::RemovePlugin:
+			PluginsSettings[r.plugin].remove(r.key);
+			break;
+		case ConfigJournal::SetPluginList:
+			listOfPlugins = r.value.toStringList();
+			break;
+		case ConfigJournal::SetRFIDTag:
+			knownRFIDTags.insert(r.key.toLatin1(), r.value.toString());
+			break;
 	}
 }
 
+// Nothing is written if nothing changed, the config file is only rewritten when the journal is too big
 void Bunny::SaveConfig()
 {
-	QFile file(configFileName);
-	if (!file.open(QIODevice::WriteOnly))
+	QWriteLocker locker(&settingsLock);
+	if(!journal.NeedsCompaction())
 	{
-		LogError(QString("Cannot open config file for writing : %1").arg(configFileName));
+		journal.Flush();
 		return;
 	}
-	QDataStream out(&file);
+	QByteArray data;
+	QDataStream out(&data, QIODevice::WriteOnly);
 	out.setVersion(QDataStream::Qt_4_3);
 	out << GlobalSettings << PluginsSettings << listOfPlugins << knownRFIDTags;
+	journal.Compact(data);
 }
 
+// The XMPP session calls below come from the handler's reactor thread, bunny state and plugins stay on the main thread
 void Bunny::SetXmppHandler(XmppHandler * x)
 {
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "SetXmppHandler", Qt::QueuedConnection, Q_ARG(XmppHandler*, x));
+		return;
+	}
 	xmppHandler = x;
 }
 
 void Bunny::RemoveXmppHandler(XmppHandler * x)
 {
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "RemoveXmppHandler", Qt::QueuedConnection, Q_ARG(XmppHandler*, x));
+		return;
+	}
 	if (xmppHandler == x)
 	{
 		xmppHandler = 0;
@@ -353,17 +423,29 @@ void Bunny::RemoveXmppHandler(XmppHandler * x)
 // Called when the bunny start an authenticating process
 void Bunny::Authenticating()
 {
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "Authenticating", Qt::QueuedConnection);
+		return;
+	}
 	if(xmppHandler)
 	{
 		xmppHandler->Disconnect();
 		xmppHandler = 0;
 	}
+	if(state == State_Ready)
+		ResponseCache::Instance().ServerStatsChanged();
 	state = State_Authenticating;
 }
 
 // Called when the bunny succeed an auth
 void Bunny::Authenticated()
 {
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "Authenticated", Qt::QueuedConnection);
+		return;
+	}
 	state = State_Authenticated;
 	SetGlobalSetting("Last JabberConnection", QDateTime::currentDateTime());
 }
@@ -371,13 +453,31 @@ void Bunny::Authenticated()
 // Called when the bunny is ready (auth/boot finished)
 void Bunny::Ready()
 {
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "Ready", Qt::QueuedConnection);
+		return;
+	}
 	state = State_Ready;
 	OnConnect();
 }
 
 // Called when the bunny is requesting init packet (during boot)
-QByteArray Bunny::GetInitPacket() const
+QByteArray Bunny::GetInitPacket(QDateTime * expiry) const
 {
+	int generation = initPacketsGeneration;
+	int changes;
+	{
+		QReadLocker locker(&settingsLock);
+		if(!initPacket.isNull() && initPacketGeneration == generation && (initPacketExpiry.isNull() || QDateTime::currentDateTime() < initPacketExpiry))
+		{
+			if(expiry)
+				*expiry = initPacketExpiry;
+			return initPacket;
+		}
+		changes = initPacketChanges;
+	}
+
 	// Create minimal packet
 	AmbientPacket a(AmbientPacket::Service_Nose, AmbientPacket::Nose_No);
 	a.SetEarsPosition(0,0);
@@ -385,10 +485,16 @@ QByteArray Bunny::GetInitPacket() const
 	SleepPacket s(SleepPacket::Wake_Up);
 
 	// Pass AmbientPacket to all bunny's plugins
+	QDateTime validUntil;
 	foreach(PluginInterface * p, listOfPluginsPtr)
 	{
 		if(p->GetEnable())
+		{
 			p->OnInitPacket(this, a, s);
+			QDateTime pluginExpiry = p->GetInitPacketExpiry(this);
+			if(!pluginExpiry.isNull() && (validUntil.isNull() || pluginExpiry < validUntil))
+				validUntil = pluginExpiry;
+		}
 	}
 
 	// Create packetList and return packet's data
@@ -396,29 +502,120 @@ QByteArray Bunny::GetInitPacket() const
 	l.append(&a);
 	l.append(&s);
 
-	return Packet::GetData(l);
+	QByteArray data = Packet::GetData(l);
+	if(expiry)
+		*expiry = validUntil;
+	QWriteLocker locker(&settingsLock);
+	// Not cached if a setting changed meanwhile
+	if(changes == initPacketChanges)
+	{
+		initPacket = data;
+		initPacketExpiry = validUntil;
+		initPacketGeneration = generation;
+	}
+	return data;
+}
+
+void Bunny::DropInitPackets()
+{
+	initPacketsGeneration.ref();
+	SessionStore::Instance().DropInitPackets();
+}
+
+// Built by the plugins on the main thread, answered by the handler in its own thread
+void Bunny::RequestInitPacket(XmppHandler * x, QByteArray const& request)
+{
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "RequestInitPacket", Qt::QueuedConnection, Q_ARG(XmppHandler*, x), Q_ARG(QByteArray, request));
+		return;
+	}
+	QMetaObject::invokeMethod(x, "AnswerSources", Q_ARG(QByteArray, request), Q_ARG(QByteArray, GetInitPacket()));
+}
+
+// settingsLock is held for writing
+void Bunny::InvalidateInitPacket()
+{
+	initPacket.clear();
+	initPacketChanges++;
+}
+
+// Messages aren't sent to sleeping bunnies, unless they are insomniac
+bool Bunny::AcceptsPacket(Packet::Packet_Types type) const
+{
+	return xmppHandler && (type != Packet::Packet_Message || (!IsSleeping() || GetGlobalSetting("Insomniac",false).toBool()));
 }
 
 void Bunny::SendPacket(Packet const& p)
 {
-	if (xmppHandler && (p.GetType() != Packet::Packet_Message || (!IsSleeping() || GetGlobalSetting("Insomniac",false).toBool())))
+	if (AcceptsPacket(p.GetType()))
 	{
 		NetworkDump::Log("XMPP SendPacketToBunny", p.GetPrintableData());
-		xmppHandler->WriteDataToBunny(p.GetData());
+		WriteDataToBunny(p.GetData());
 	}
 }
 
+void Bunny::SendEncodedPacket(Packet::Packet_Types type, QByteArray const& encoded)
+{
+	if (AcceptsPacket(type))
+		WriteEncodedDataToBunny(encoded);
+}
+
 void Bunny::SendData(QByteArray const& b)
 {
 	if (xmppHandler)
 	{
 		NetworkDump::Log("XMPP SendDataToBunny", b.toHex());
-		xmppHandler->WriteDataToBunny(b);
+		WriteDataToBunny(b);
 	}
 }
 
+void Bunny::SendTTSMessage(QString const& text, QString const& voice, QByteArray const& messageFormat)
+{
+	TTSManager::CreateNewSoundAsync(text, voice, this, SLOT(TTSMessageReady()), messageFormat);
+}
+
+void Bunny::TTSMessageReady()
+{
+	TTSReply * reply = qobject_cast<TTSReply *>(sender());
+	if(!reply)
+		return;
+	if(reply->GetFileName().isEmpty())
+	{
+		LogError(QString("Bunny %1 : TTS sound could not be created").arg(QString(GetID())));
+		return;
+	}
+	QByteArray message = reply->GetUserData();
+	message.replace("%1", reply->GetFileName());
+	SendPacket(MessagePacket(message));
+}
+
+// Only the main thread knows the current XmppHandler, which writes in its own reactor thread
+void Bunny::WriteDataToBunny(QByteArray const& b)
+{
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "WriteDataToBunny", Qt::QueuedConnection, Q_ARG(QByteArray, b));
+		return;
+	}
+	if (xmppHandler)
+		QMetaObject::invokeMethod(xmppHandler, "WriteDataToBunny", Q_ARG(QByteArray, b));
+}
+
+void Bunny::WriteEncodedDataToBunny(QByteArray const& b)
+{
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "WriteEncodedDataToBunny", Qt::QueuedConnection, Q_ARG(QByteArray, b));
+		return;
+	}
+	if (xmppHandler)
+		QMetaObject::invokeMethod(xmppHandler, "WriteEncodedDataToBunny", Q_ARG(QByteArray, b));
+}
+
 QVariant Bunny::GetGlobalSetting(QString const& key, QVariant const& defaultValue) const
 {
+	QReadLocker locker(&settingsLock);
 	if (GlobalSettings.contains(key))
 		return GlobalSettings.value(key);
 	else
@@ -427,16 +624,42 @@ QVariant Bunny::GetGlobalSetting(QString const& key, QVariant const& defaultValu
 
 void Bunny::SetGlobalSetting(QString const& key, QVariant const& value)
 {
+	QWriteLocker locker(&settingsLock);
 	GlobalSettings.insert(key, value);
+	journal.Append(ConfigJournal::SetGlobal, QString(), key, value);
+	if(key == "BunnyPassword")
+		credentialDigest.clear();
+	// LastIP, LastLocate ... are written on each boot by the server, they don't change the init packet
+	if(!key.startsWith("Last"))
+		InvalidateInitPacket();
 }
 
 void Bunny::RemoveGlobalSetting(QString const& key)
 {
+	QWriteLocker locker(&settingsLock);
 	GlobalSettings.remove(key);
+	journal.Append(ConfigJournal::RemoveGlobal, QString(), key);
+	if(key == "BunnyPassword")
+		credentialDigest.clear();
+	if(!key.startsWith("Last"))
+		InvalidateInitPacket();
+}
+
+QByteArray Bunny::GetCredentialDigest() const
+{
+	{
+		QReadLocker locker(&settingsLock);
+		if(!credentialDigest.isNull())
+			return credentialDigest;
+	}
+	QWriteLocker locker(&settingsLock);
+	credentialDigest = QCryptographicHash::hash(id + "::" + GlobalSettings.value("BunnyPassword").toByteArray(), QCryptographicHash::Md5);
+	return credentialDigest;
 }
 
 QVariant Bunny::GetPluginSetting(QString const& pluginName, QString const& key, QVariant const& defaultValue) const
 {
+	QReadLocker locker(&settingsLock);
 	if (PluginsSettings[pluginName].contains(key))
 		return PluginsSettings[pluginName].value(key);
 	else
@@ -446,28 +669,57 @@ QVariant Bunny::GetPluginSetting(QString const& pluginName, QString const& key,
 
 void Bunny::SetPluginSetting(QString const& pluginName, QString const& key, QVariant const& value)
 {
+	QWriteLocker locker(&settingsLock);
 	PluginsSettings[pluginName].insert(key, value);
+	journal.Append(ConfigJournal::SetPlugin, pluginName, key, value);
+	InvalidateInitPacket();
 }
 
 void Bunny::RemovePluginSetting(QString const& pluginName, QString const& key)
 {
+	QWriteLocker locker(&settingsLock);
 	PluginsSettings[pluginName].remove(key);
+	journal.Append(ConfigJournal::RemovePlugin, pluginName, key);
+	InvalidateInitPacket();
+}
+
+// settingsLock is held for writing
+void Bunny::JournalPluginList()
+{
+	journal.Append(ConfigJournal::SetPluginList, QString(), QString(), QStringList(listOfPlugins));
+}
+
+void Bunny::SetRFIDTagName(QByteArray const& tag, QString const& name)
+{
+	QWriteLocker locker(&settingsLock);
+	knownRFIDTags.insert(tag, name);
+	journal.Append(ConfigJournal::SetRFIDTag, QString(), QString::fromLatin1(tag), name);
 }
 
 // API Add plugin to this bunny
 void Bunny::AddPlugin(PluginInterface * p)
 {
-	if(!listOfPlugins.contains(p->GetName()))
+	bool added = false;
+	{
+		QWriteLocker locker(&settingsLock);
+		if(!listOfPlugins.contains(p->GetName()))
+		{
+			listOfPlugins.append(p->GetName());
+			listOfPluginsPtr.append(p);
+			JournalPluginList();
+			InvalidateInitPacket();
+			added = true;
+		}
+	}
+	if(added)
 	{
-		listOfPlugins.append(p->GetName());
-		listOfPluginsPtr.append(p);
 		if(IsConnected())
 			p->OnBunnyConnect(this);
 		SaveConfig();
 	}
-	if(GlobalSettings.contains(SINGLE_CLICK_PLUGIN_SETTINGNAME))
+	QString pluginName = GetGlobalSetting(SINGLE_CLICK_PLUGIN_SETTINGNAME).toString();
+	if(!pluginName.isNull())
 	{
-		QString pluginName = GlobalSettings.value(SINGLE_CLICK_PLUGIN_SETTINGNAME).toString();
 		if(p->GetName() == pluginName)
 		{
 			QString error = CheckPlugin(p, true);
@@ -484,9 +736,9 @@ void Bunny::AddPlugin(PluginInterface * p)
 	{
 		singleClickPlugin = NULL;
 	}
-	if(GlobalSettings.contains(DOUBLE_CLICK_PLUGIN_SETTINGNAME))
+	pluginName = GetGlobalSetting(DOUBLE_CLICK_PLUGIN_SETTINGNAME).toString();
+	if(!pluginName.isNull())
 	{
-		QString pluginName = GlobalSettings.value(DOUBLE_CLICK_PLUGIN_SETTINGNAME).toString();
 		if(p->GetName() == pluginName)
 		{
 			QString error = CheckPlugin(p, true);
@@ -508,7 +760,19 @@ void Bunny::AddPlugin(PluginInterface * p)
 // API Remove plugin to this bunny
 void Bunny::RemovePlugin(PluginInterface * p)
 {
-	if(listOfPlugins.contains(p->GetName()))
+	bool removed = false;
+	{
+		QWriteLocker locker(&settingsLock);
+		if(listOfPlugins.contains(p->GetName()))
+		{
+			listOfPlugins.removeAll(p->GetName());
+			listOfPluginsPtr.removeAll(p);
+			JournalPluginList();
+			InvalidateInitPacket();
+			removed = true;
+		}
+	}
+	if(removed)
 	{
 		if(p == singleClickPlugin)
 		{
@@ -518,8 +782,6 @@ void Bunny::RemovePlugin(PluginInterface * p)
 		{
 			doubleClickPlugin = NULL;
 		}
-		listOfPlugins.removeAll(p->GetName());
-		listOfPluginsPtr.removeAll(p);
 		if(IsConnected())
 			p->OnBunnyDisconnect(this);
 		SaveConfig();
@@ -541,9 +803,15 @@ void Bunny::PluginStateChanged(PluginInterface * p)
 // New plugin loaded
 void Bunny::PluginLoaded(PluginInterface * p)
 {
-	if(listOfPlugins.contains(p->GetName()))
+	bool associated;
+	{
+		QWriteLocker locker(&settingsLock);
+		associated = listOfPlugins.contains(p->GetName());
+		if(associated)
+			listOfPluginsPtr.append(p);
+	}
+	if(associated)
 	{
-		listOfPluginsPtr.append(p);
 		if(p->GetEnable())
 			p->OnBunnyConnect(this);
 	}
@@ -552,9 +820,13 @@ void Bunny::PluginLoaded(PluginInterface * p)
 // Plugin unloaded
 void Bunny::PluginUnloaded(PluginInterface * p)
 {
-	if(listOfPluginsPtr.contains(p))
+	bool associated;
+	{
+		QWriteLocker locker(&settingsLock);
+		associated = (listOfPluginsPtr.removeAll(p) > 0);
+	}
+	if(associated)
 	{
-		listOfPluginsPtr.removeAll(p);
 		if(p->GetEnable())
 			p->OnBunnyDisconnect(this);
 	}
@@ -563,6 +835,8 @@ void Bunny::PluginUnloaded(PluginInterface * p)
 // Bunny is connected
 void Bunny::OnConnect()
 {
+	ResponseCache::Instance().ServerStatsChanged();
+
 	// Send to all 'system' plugins
 	PluginManager::Instance().OnBunnyConnect(this);
 
@@ -577,6 +851,8 @@ void Bunny::OnConnect()
 // Bunny is gone away
 void Bunny::OnDisconnect()
 {
+	ResponseCache::Instance().ServerStatsChanged();
+
 	// Send to all 'system' plugins
 	PluginManager::Instance().OnBunnyDisconnect(this);
 
@@ -592,6 +868,11 @@ void Bunny::OnDisconnect()
 // Received XMPP Message
 void Bunny::XmppBunnyMessage(QByteArray const& data)
 {
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "XmppBunnyMessage", Qt::QueuedConnection, Q_ARG(QByteArray, data));
+		return;
+	}
 	// Send to all 'system' plugins
 	PluginManager::Instance().XmppBunnyMessage(this, data);
 
@@ -603,9 +884,31 @@ void Bunny::XmppBunnyMessage(QByteArray const& data)
 	}
 }
 
+// Only for the plugins which asked for them, pings are the most frequent messages
+void Bunny::XmppBunnyPing(QByteArray const& data)
+{
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "XmppBunnyPing", Qt::QueuedConnection, Q_ARG(QByteArray, data));
+		return;
+	}
+	PluginManager::Instance().XmppBunnyPing(this, data);
+
+	foreach(PluginInterface * p, listOfPluginsPtr)
+	{
+		if(p->GetEnable() && p->WantsXmppPings())
+			p->XmppBunnyMessage(this, data);
+	}
+}
+
 // Called when top button is pushed
 bool Bunny::OnClick(PluginInterface::ClickType type)
 {
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "OnClick", Qt::QueuedConnection, Q_ARG(PluginInterface::ClickType, type));
+		return true;
+	}
 	if(PluginManager::Instance().OnClick(this, type))
 		return true;
 
@@ -624,6 +927,11 @@ bool Bunny::OnClick(PluginInterface::ClickType type)
 // Called when ears was moded
 bool Bunny::OnEarsMove(int left, int right)
 {
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "OnEarsMove", Qt::QueuedConnection, Q_ARG(int, left), Q_ARG(int, right));
+		return true;
+	}
 	if(PluginManager::Instance().OnEarsMove(this, left, right))
 		return true;
 
@@ -643,7 +951,7 @@ bool Bunny::OnEarsMove(int left, int right)
 bool Bunny::OnRFID(QByteArray const& tag)
 {
 	if(!knownRFIDTags.contains(tag))
-		knownRFIDTags.insert(tag, QString());
+		SetRFIDTagName(tag, QString());
 
 	if(PluginManager::Instance().OnRFID(this, tag))
 		return true;
@@ -828,7 +1136,7 @@ API_CALL(Bunny::Api_SetRFIDTagName)
 	if(!knownRFIDTags.contains(tagName))
 		return new ApiManager::ApiError(QString("Tag '%1' is unkown").arg(hRequest.GetArg("tag")));
 
-	knownRFIDTags[tagName] = hRequest.GetArg("name");
+	SetRFIDTagName(tagName, hRequest.GetArg("name"));
 
 	return new ApiManager::ApiOk(QString("Name '%1' associated to tag '%2'").arg(hRequest.GetArg("name"), hRequest.GetArg("tag")));
 }
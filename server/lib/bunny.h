@@ -1,19 +1,25 @@
 #ifndef _BUNNY_H_
 #define _BUNNY_H_
 
+#include <QAtomicInt>
 #include <QByteArray>
+#include <QDateTime>
 #include <QHash>
+#include <QReadWriteLock>
 #include <QString>
 #include <QTimer>
 #include <QVariant>
 #include "apihandler.h"
 #include "apimanager.h"
+#include "configjournal.h"
 #include "global.h"
 #include "packet.h"
+#include "persistencescheduler.h"
 #include "plugininterface.h"
 
+class RecordStore;
 class XmppHandler;
-class OJN_EXPORT Bunny : QObject, public ApiHandler<Bunny>
+class OJN_EXPORT Bunny : QObject, public ApiHandler<Bunny>, public Persistent
 {
 	friend class BunnyManager;
 	Q_OBJECT
@@ -23,17 +29,21 @@ public:
 
 	static void Init() { InitApiCalls(); }
 
-	QByteArray GetID() const;
-	void SetXmppHandler (XmppHandler *);
-	void RemoveXmppHandler (XmppHandler *);
+	QByteArray const& GetID() const;
 	void SendPacket(Packet const&);
+	// Packet already obfuscated and base64 encoded (see BunnyManager::Broadcast)
+	void SendEncodedPacket(Packet::Packet_Types, QByteArray const& encoded);
 	void SendData(QByteArray const&);
+	// The sound is created by a TTS thread, then the message is sent ("%1" is replaced by the sound's url)
+	void SendTTSMessage(QString const& text, QString const& voice, QByteArray const& messageFormat);
 
 	QString GetBunnyName() const;
 	void SetBunnyName(QString const& bunnyName);
 	QByteArray GetBunnyPassword() const;
 	bool SetBunnyPassword(QByteArray const& bunnyName);
 	bool ClearBunnyPassword();
+	// MD5(id + "::" + password), the part of the DIGEST-MD5 HA1 which doesn't change between logins
+	QByteArray GetCredentialDigest() const;
 
 	QByteArray GetXmppResource() const;
 	void SetXmppResource(QByteArray const&);
@@ -49,22 +59,17 @@ public:
 	bool HasPlugin(PluginInterface * p) const;
 	QList<QString> GetListOfPlugins();
 
-	void XmppBunnyMessage(QByteArray const&);
-
-	void Authenticating();
-	void Authenticated();
-	void Ready();
-
 	bool IsAuthenticated() const;
 	bool IsConnected() const;
 
 	bool IsIdle() const;
 	bool IsSleeping() const;
 
-	QByteArray GetInitPacket() const;
+	// Cached until a setting or a plugin changes, or until a plugin's part of it expires
+	QByteArray GetInitPacket(QDateTime * expiry = 0) const;
+	// A plugin was loaded, unloaded, enabled or disabled : every cached init packet is outdated
+	static void DropInitPackets();
 
-	bool OnClick(PluginInterface::ClickType);
-	bool OnEarsMove(int, int);
 	bool OnRFID(QByteArray const&);
 
 	void PluginStateChanged(PluginInterface * p);
@@ -78,12 +83,36 @@ public:
 	static void InitApiCalls();
 	ApiManager::ApiAnswer * ProcessVioletApiCall(HTTPRequest const&);
 
+public slots:
+	// XMPP session, called by the XmppHandler's reactor thread and queued to the main thread
+	void SetXmppHandler (XmppHandler *);
+	void RemoveXmppHandler (XmppHandler *);
+	void Authenticating();
+	void Authenticated();
+	void Ready();
+	void XmppBunnyMessage(QByteArray const&);
+	void XmppBunnyPing(QByteArray const&);
+	// True if a plugin handled it, or if it was queued
+	bool OnClick(PluginInterface::ClickType);
+	bool OnEarsMove(int, int);
+	// The init packet is built by the main thread, then answered by the handler (XmppHandler::AnswerSources)
+	void RequestInitPacket(XmppHandler *, QByteArray const& request);
+
 private slots:
 	void SaveConfig();
+	void WriteDataToBunny(QByteArray const&);
+	void WriteEncodedDataToBunny(QByteArray const&);
+	void TTSMessageReady();
 
 private:
-	Bunny(QByteArray const&);
+	Bunny(QByteArray const&, RecordStore const * store = 0);
 	void LoadConfig();
+	void LoadConfig(QByteArray const& snapshot, QList<ConfigJournal::Record> const& changes);
+	void ReplayRecord(ConfigJournal::Record const&);
+	void JournalPluginList();
+	void InvalidateInitPacket();
+	void SetRFIDTagName(QByteArray const& tag, QString const& name);
+	bool AcceptsPacket(Packet::Packet_Types) const;
 	void AddPlugin(PluginInterface * p);
 	void RemovePlugin(PluginInterface * p);
 	void OnConnect();
@@ -121,15 +150,26 @@ private:
 
 	enum State state;
 
-	QByteArray id;
+	QByteArray id; // Hex MAC address
 	QByteArray xmppResource;
 	QString configFileName;
+	// Settings and xmppResource can be used by Api worker threads
+	mutable QReadWriteLock settingsLock;
 	QHash<QString, QVariant> GlobalSettings;
+	mutable QByteArray credentialDigest; // Null until computed, reset when the password changes
+	// Null until built, reset by the settings and plugin changes, guarded by settingsLock
+	mutable QByteArray initPacket;
+	mutable QDateTime initPacketExpiry;
+	mutable int initPacketGeneration;
+	int initPacketChanges;
+	static QAtomicInt initPacketsGeneration;
 	QHash<QString, QHash<QString, QVariant> > PluginsSettings;
+	// Both plugin lists are changed by the main thread under settingsLock, other threads read them under it
 	QList<QString> listOfPlugins;
+	ConfigJournal journal; // Changes not yet in the config file, guarded by settingsLock
 	QList<PluginInterface*> listOfPluginsPtr;
-	QTimer * saveTimer;
 	XmppHandler * xmppHandler;
+	QAtomicInt lastAccess; // Set by BunnyManager::GetBunny, idle bunnies are evicted
 
 	PluginInterface * singleClickPlugin;
 	PluginInterface * doubleClickPlugin;
@@ -141,17 +181,18 @@ private:
 
 inline QList<QString> Bunny::GetListOfPlugins()
 {
+	QReadLocker locker(&settingsLock);
 	return listOfPlugins;
 }
 
 inline bool Bunny::IsIdle() const
 {
-	return IsConnected() && ((bool)(xmppResource == "idle"));
+	return IsConnected() && ((bool)(GetXmppResource() == "idle"));
 }
 
 inline bool Bunny::IsSleeping() const
 {
-	return IsConnected() && ((bool)(xmppResource == "asleep"));
+	return IsConnected() && ((bool)(GetXmppResource() == "asleep"));
 }
 
 inline bool Bunny::IsConnected() const
@@ -164,18 +205,20 @@ inline bool Bunny::IsAuthenticated() const
 	return (state == State_Ready) || (state == State_Authenticated);
 }
 
-inline QByteArray Bunny::GetID() const
+inline QByteArray const& Bunny::GetID() const
 {
-	return id.toHex();
+	return id;
 }
 
 inline QByteArray Bunny::GetXmppResource() const
 {
+	QReadLocker locker(&settingsLock);
 	return xmppResource;
 }
 
 inline void Bunny::SetXmppResource(QByteArray const& r)
 {
+	QWriteLocker locker(&settingsLock);
 	xmppResource = r;
 }
 
@@ -215,6 +258,7 @@ inline QString Bunny::GetTTSVoice(void) const {
 
 inline bool Bunny::HasPlugin(PluginInterface * p) const
 {
+	QReadLocker locker(&settingsLock);
 	return listOfPluginsPtr.contains(p);
 }
 
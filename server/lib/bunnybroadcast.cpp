@@ -0,0 +1,34 @@
+#include <QTimer>
+#include "bunny.h"
+#include "bunnybroadcast.h"
+#include "bunnymanager.h"
+#include "netdump.h"
+#include "settings.h"
+
+BunnyBroadcast::BunnyBroadcast(Packet const& p, QList<QByteArray> const& r, int f):type(p.GetType()),recipients(r),filters(f),next(0)
+{
+	NetworkDump::Log("XMPP BroadcastPacket", p.GetPrintableData());
+	encoded = p.GetData().toBase64();
+	batchSize = qMax(1, GlobalSettings::GetInt("Config/BroadcastBatchSize", 500));
+}
+
+void BunnyBroadcast::Continue()
+{
+	int end = qMin(next + batchSize, recipients.size());
+	for(; next < end; next++)
+	{
+		// The bunny may have gone away since the broadcast started
+		Bunny * b = BunnyManager::GetConnectedBunny(recipients.at(next));
+		if(!b)
+			continue;
+		if((filters & BunnyManager::Broadcast_Idle) && !b->IsIdle())
+			continue;
+		if((filters & BunnyManager::Broadcast_Awake) && b->IsSleeping())
+			continue;
+		b->SendEncodedPacket(type, encoded);
+	}
+	if(next < recipients.size())
+		QTimer::singleShot(0, this, SLOT(Continue()));
+	else
+		deleteLater();
+}
@@ -0,0 +1,32 @@
+#ifndef _BUNNYBROADCAST_H_
+#define _BUNNYBROADCAST_H_
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include "global.h"
+#include "packet.h"
+
+// One BunnyManager::Broadcast in progress
+// The packet is encoded once, recipients are served Config/BroadcastBatchSize at a time
+// so that the event loop keeps running during large fan-outs
+class OJN_EXPORT BunnyBroadcast : public QObject
+{
+	Q_OBJECT
+
+public:
+	BunnyBroadcast(Packet const&, QList<QByteArray> const& recipients, int filters);
+
+public slots:
+	void Continue();
+
+private:
+	Packet::Packet_Types type;
+	QByteArray encoded;
+	QList<QByteArray> recipients;
+	int filters;
+	int next;
+	int batchSize;
+};
+
+#endif
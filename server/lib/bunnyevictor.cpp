@@ -0,0 +1,13 @@
+#include "bunnyevictor.h"
+#include "bunnymanager.h"
+
+BunnyEvictor::BunnyEvictor(uint t):idleTimeout(t)
+{
+	connect(&timer, SIGNAL(timeout()), this, SLOT(Sweep()));
+	timer.start(qMin(idleTimeout, 60u) * 1000);
+}
+
+void BunnyEvictor::Sweep()
+{
+	BunnyManager::EvictIdleBunnies(idleTimeout);
+}
@@ -0,0 +1,25 @@
+#ifndef _BUNNYEVICTOR_H_
+#define _BUNNYEVICTOR_H_
+
+#include <QObject>
+#include <QTimer>
+#include "global.h"
+
+// Bunnies unused for Config/BunnyIdleTimeout seconds are saved and deleted,
+// BunnyManager::GetBunny loads them again when they are needed
+class OJN_EXPORT BunnyEvictor : public QObject
+{
+	Q_OBJECT
+
+public:
+	BunnyEvictor(uint idleTimeout);
+
+private slots:
+	void Sweep();
+
+private:
+	uint idleTimeout;
+	QTimer timer;
+};
+
+#endif
@@ -1,9 +1,20 @@
+#include <QDateTime>
 #include "account.h"
+#include "apiexecutor.h"
 #include "bunny.h"
+#include "bunnybroadcast.h"
+#include "bunnyevictor.h"
 #include "bunnymanager.h"
+#include "configwriter.h"
+#include "cron.h"
 #include "httprequest.h"
+#include "log.h"
+#include "pluginmanager.h"
+#include "responsecache.h"
+#include "settings.h"
+#include "xmppreactor.h"
 
-BunnyManager::BunnyManager()
+BunnyManager::BunnyManager():evictor(0)
 {
 	bunniesDir = QCoreApplication::applicationDirPath();
 	bunniesDir.cd("bunnies");
@@ -17,19 +28,37 @@ BunnyManager & BunnyManager::Instance()
 
 void BunnyManager::LoadAllBunnies()
 {
-	LogInfo(QString("Finding bunnies in : %1").arg(bunniesDir.path()));
-	QStringList filters;
-	filters << "*.dat";
-	bunniesDir.setNameFilters(filters);
-	foreach (QFileInfo file, bunniesDir.entryInfoList(QDir::Files))
+	// Only the IDs are read, bunnies are loaded by GetBunny
+	QWriteLocker locker(&listOfBunniesLock);
+	if(RecordStore::IsEnabled() && store.Open(RecordStore::FileName(bunniesDir)))
 	{
-		GetBunny(file.baseName().toAscii());
+		foreach(QByteArray hexID, store.Keys())
+			knownBunnies.insert(QByteArray::fromHex(hexID), true);
 	}
+	else
+	{
+		LogInfo(QString("Finding bunnies in : %1").arg(bunniesDir.path()));
+		QStringList filters;
+		filters << "*.dat";
+		bunniesDir.setNameFilters(filters);
+		foreach (QFileInfo file, bunniesDir.entryInfoList(QDir::Files))
+		{
+			QByteArray bunnyID = QByteArray::fromHex(file.baseName().toAscii());
+			if(!bunnyID.isEmpty())
+				knownBunnies.insert(bunnyID, false);
+		}
+	}
+	ResponseCache::Instance().ServerStatsChanged();
+
+	int idleTimeout = GlobalSettings::GetInt("Config/BunnyIdleTimeout", 3600);
+	if(idleTimeout > 0)
+		evictor = new BunnyEvictor(idleTimeout);
 }
 
 QList<QByteArray> BunnyManager::GetConnectedBunniesList(void)
 {
 	QList<QByteArray> list;
+	QReadLocker locker(&listOfBunniesLock);
 	foreach(Bunny *b,Instance().listOfBunnies)
 	{
 		if(b->IsConnected()) {
@@ -40,6 +69,26 @@ QList<QByteArray> BunnyManager::GetConnectedBunniesList(void)
 	return list;
 }
 
+void BunnyManager::Broadcast(Packet const& p, int filters, PluginInterface * plugin)
+{
+	QList<QByteArray> recipients;
+	{
+		QReadLocker locker(&listOfBunniesLock);
+		foreach(Bunny * b, listOfBunnies)
+			if(b->IsConnected() && (!plugin || b->HasPlugin(plugin)))
+				recipients.append(b->GetID());
+	}
+	Broadcast(p, recipients, filters);
+}
+
+void BunnyManager::Broadcast(Packet const& p, QList<QByteArray> const& recipients, int filters)
+{
+	if(recipients.isEmpty())
+		return;
+	BunnyBroadcast * broadcast = new BunnyBroadcast(p, recipients, filters);
+	broadcast->Continue();
+}
+
 void BunnyManager::InitApiCalls()
 {
 	DECLARE_API_CALL("getListOfConnectedBunnies()", &BunnyManager::Api_GetListOfConnectedBunnies);
@@ -60,12 +109,10 @@ API_CALL(BunnyManager::Api_RemoveBunny)
 
 	QString serial = hRequest.GetArg("serial");
 	QByteArray hexSerial = QByteArray::fromHex(serial.toAscii());
-	if(!listOfBunnies.contains(hexSerial))
+	if(!knownBunnies.contains(hexSerial))
 		return new ApiManager::ApiError(QString("Bunny '%1' does not exist").arg(serial));
 
-	listOfBunnies.remove(hexSerial);
-	QFile bunnyFile(bunniesDir.absoluteFilePath(QString("%1.dat").arg(serial)));
-	if(bunnyFile.remove())
+	if(DeleteBunny(hexSerial.toHex()))
 		return new ApiManager::ApiOk(QString("Bunny %1 removed").arg(serial));
 	return new ApiManager::ApiError(QString("Error when removing bunny %1").arg(serial));
 }
@@ -77,7 +124,8 @@ int BunnyManager::GetConnectedBunnyCount()
 
 int BunnyManager::GetBunnyCount()
 {
-	return listOfBunnies.count();
+	QReadLocker locker(&listOfBunniesLock);
+	return knownBunnies.count();
 }
 
 Bunny * BunnyManager::GetBunny(QByteArray const& bunnyHexID)
@@ -86,11 +134,47 @@ Bunny * BunnyManager::GetBunny(QByteArray const& bunnyHexID)
 	if(bunnyID.isEmpty())
 		return NULL;
 
-	if(listOfBunnies.contains(bunnyID))
-		return listOfBunnies.value(bunnyID);
+	{
+		QReadLocker locker(&listOfBunniesLock);
+		Bunny * b = listOfBunnies.value(bunnyID);
+		if(b)
+		{
+			// Only a read lock here, several threads may set it at once
+			b->lastAccess.fetchAndStoreOrdered(QDateTime::currentDateTime().toTime_t());
+			return b;
+		}
+	}
+	return LoadBunny(bunnyID);
+}
+
+Bunny * BunnyManager::LoadBunny(QByteArray const& bunnyID)
+{
+	QWriteLocker locker(&listOfBunniesLock);
+	// Loaded by another thread meanwhile
+	Bunny * b = listOfBunnies.value(bunnyID);
+	if(!b)
+	{
+		QHash<QByteArray, bool>::iterator it = knownBunnies.find(bunnyID);
+		bool known = (it != knownBunnies.end());
+		// New bunnies are created by their XMPP authentication, not by the Api worker threads
+		if(!known && !ApiExecutor::IsMainThread() && !XmppReactor::IsReactorThread())
+		{
+			LogError(QString("Bunny %1 can't be created outside of the main and XMPP threads").arg(QString(bunnyID.toHex())));
+			return NULL;
+		}
 
-	Bunny * b = new Bunny(bunnyID);
-	listOfBunnies.insert(bunnyID, b);
+		b = new Bunny(bunnyID, (known && it.value()) ? &Instance().store : 0);
+		// Timers and queued calls of the bunny are handled by the main thread
+		if(!ApiExecutor::IsMainThread())
+			b->moveToThread(QCoreApplication::instance()->thread());
+		listOfBunnies.insert(bunnyID, b);
+		if(!known)
+		{
+			knownBunnies.insert(bunnyID, false);
+			ResponseCache::Instance().ServerStatsChanged();
+		}
+	}
+	b->lastAccess.fetchAndStoreOrdered(QDateTime::currentDateTime().toTime_t());
 	return b;
 }
 
@@ -111,26 +195,102 @@ Bunny * BunnyManager::GetConnectedBunny(QByteArray const& bunnyHexID)
 {
 	QByteArray bunnyID = QByteArray::fromHex(bunnyHexID);
 
-	if(listOfBunnies.contains(bunnyID))
+	QReadLocker locker(&listOfBunniesLock);
+	Bunny * b = listOfBunnies.value(bunnyID);
+	if(b && b->IsConnected())
+		return b;
+
+	return NULL;
+}
+
+// Doesn't create the bunny if it isn't known
+Bunny * BunnyManager::GetKnownBunny(QByteArray const& bunnyHexID)
+{
 	{
-		Bunny * b = listOfBunnies.value(bunnyID);
-		if(b->IsConnected())
-			return b;
+		QReadLocker locker(&listOfBunniesLock);
+		if(!knownBunnies.contains(QByteArray::fromHex(bunnyHexID)))
+			return NULL;
 	}
+	return GetBunny(bunnyHexID);
+}
 
-	return NULL;
+// Loads every bunny, they are evicted again once idle
+QList<Bunny *> BunnyManager::GetAllBunnies()
+{
+	QList<QByteArray> ids;
+	{
+		QReadLocker locker(&listOfBunniesLock);
+		ids = knownBunnies.keys();
+	}
+	QList<Bunny *> list;
+	foreach(QByteArray id, ids)
+	{
+		Bunny * b = GetBunny(id.toHex());
+		if(b)
+			list.append(b);
+	}
+	return list;
+}
+
+// Bunnies being used (connected, Api task, cron...) are kept
+bool BunnyManager::IsEvictable(Bunny * b, uint now, uint idleTimeout)
+{
+	if(b->state != Bunny::State_Disconnected || b->xmppHandler)
+		return false;
+	if(now - (uint)(int)b->lastAccess < idleTimeout)
+		return false;
+	if(Cron::HasBunny(b))
+		return false;
+	return !ApiExecutor::Instance().HasPendingTasks("bunny/" + b->GetID());
+}
+
+void BunnyManager::EvictIdleBunnies(uint idleTimeout)
+{
+	uint now = QDateTime::currentDateTime().toTime_t();
+	int count = 0;
+	// The config is saved before the bunny can be loaded again
+	QWriteLocker locker(&listOfBunniesLock);
+	QMutableHashIterator<QByteArray, Bunny *> it(listOfBunnies);
+	while(it.hasNext())
+	{
+		it.next();
+		if(!IsEvictable(it.value(), now, idleTimeout))
+			continue;
+		// Saved in its own file, the record store is outdated
+		knownBunnies[it.key()] = false;
+		PluginManager::Instance().OnBunnyEvicted(it.value());
+		delete it.value();
+		it.remove();
+		count++;
+	}
+	if(count)
+		LogDebug(QString("%1 idle bunnies evicted, %2 loaded").arg(count).arg(listOfBunnies.count()));
 }
 
 void BunnyManager::Close()
 {
+	BunnyManager & m = Instance();
+	delete m.evictor;
+	m.evictor = 0;
+
+	QWriteLocker locker(&listOfBunniesLock);
 	foreach(Bunny * b, listOfBunnies)
 		delete b;
 	listOfBunnies.clear();
+	knownBunnies.clear();
+
+	// Every config file is saved, the store is written for the next start
+	// Trade-off : files changed since the last start are read again here, which lengthens the stop
+	// and the hot upgrade window (see bench_recordstore)
+	if(RecordStore::IsEnabled())
+		RecordStore::Import(m.bunniesDir, RecordStore::FileName(m.bunniesDir), &m.store);
+	m.store.Close();
 }
 
 QVector<Bunny *> BunnyManager::GetConnectedBunnies()
 {
 	QVector<Bunny *> list;
+	QReadLocker locker(&listOfBunniesLock);
 	foreach(Bunny * b, listOfBunnies)
 		if (b->IsConnected())
 			list.append(b);
@@ -139,36 +299,48 @@ QVector<Bunny *> BunnyManager::GetConnectedBunnies()
 
 void BunnyManager::PluginStateChanged(PluginInterface * p)
 {
-	foreach(Bunny * b, listOfBunnies)
-		if (b->IsConnected())
-			b->PluginStateChanged(p);
+	Bunny::DropInitPackets();
+	// Plugins may load other bunnies, the lock isn't held during the calls
+	foreach(Bunny * b, GetConnectedBunnies())
+		b->PluginStateChanged(p);
 }
 
 void BunnyManager::PluginLoaded(PluginInterface * p)
 {
-	foreach(Bunny * b, listOfBunnies)
-		if (b->IsConnected())
-			b->PluginLoaded(p);
+	Bunny::DropInitPackets();
+	foreach(Bunny * b, GetConnectedBunnies())
+		b->PluginLoaded(p);
 }
 
 void BunnyManager::PluginUnloaded(PluginInterface * p)
 {
-	foreach(Bunny * b, listOfBunnies)
-		if (b->IsConnected())
-			b->PluginUnloaded(p);
+	Bunny::DropInitPackets();
+	foreach(Bunny * b, GetConnectedBunnies())
+		b->PluginUnloaded(p);
 }
 
-void BunnyManager::DeleteBunny(QByteArray const& ID) {
+// Main thread only, returns false if the config file can't be removed
+bool BunnyManager::DeleteBunny(QByteArray const& ID) {
 	Bunny *b = GetBunny(ID);
-	if(b != NULL) {
-		LogInfo(QString("Deleted Bunny: %1").arg(QString(b->GetID())));
-		b->Disconnect();
-		listOfBunnies.remove(QByteArray::fromHex(b->GetID()));
-		QFile bunnyFile(bunniesDir.absoluteFilePath(QString("%1.dat").arg(QString(b->GetID()))));
-		delete b;
-		if(bunnyFile.exists())
-			bunnyFile.remove();
-	}
+	if(b == NULL)
+		return false;
+	LogInfo(QString("Deleted Bunny: %1").arg(QString(b->GetID())));
+	b->Disconnect();
+	listOfBunniesLock.lockForWrite();
+	listOfBunnies.remove(QByteArray::fromHex(b->GetID()));
+	knownBunnies.remove(QByteArray::fromHex(b->GetID()));
+	listOfBunniesLock.unlock();
+	ResponseCache::Instance().RemoveBunny(b->GetID());
+	ResponseCache::Instance().ServerStatsChanged();
+	// Api worker threads can't find it anymore, the calls already running on it have to end
+	ApiExecutor::Instance().WaitForStrand("bunny/" + b->GetID());
+	QFile bunnyFile(bunniesDir.absoluteFilePath(QString("%1.dat").arg(QString(b->GetID()))));
+	PluginManager::Instance().OnBunnyEvicted(b);
+	delete b;
+	// Saved by the destructor
+	ConfigWriter::Wait(bunnyFile.fileName());
+	QFile::remove(bunnyFile.fileName() + ".journal");
+	return !bunnyFile.exists() || bunnyFile.remove();
 }
 
 
@@ -180,8 +352,8 @@ API_CALL(BunnyManager::Api_GetListOfConnectedBunnies)
 		return new ApiManager::ApiError("Access denied");
 
 	QMap<QString, QVariant> list;
-	foreach(Bunny * b, listOfBunnies)
-		if(b->IsConnected() && account.GetBunniesList().contains(b->GetID()))
+	foreach(Bunny * b, GetConnectedBunnies())
+		if(account.GetBunniesList().contains(b->GetID()))
 					list.insert(b->GetID(), b->GetBunnyName());
 
 	return new ApiManager::ApiMappedList(list);
@@ -194,9 +366,12 @@ API_CALL(BunnyManager::Api_GetListOfBunnies) {
 		return new ApiManager::ApiError("Access denied");
 
 	QMap<QString, QVariant> list;
-	foreach(Bunny * b, listOfBunnies)
-		if(account.GetBunniesList().contains(b->GetID()))
+	foreach(QByteArray id, account.GetBunniesList())
+	{
+		Bunny * b = GetKnownBunny(id);
+		if(b)
 			list.insert(b->GetID(), b->GetBunnyName());
+	}
 
 	return new ApiManager::ApiMappedList(list);
 }
@@ -208,7 +383,7 @@ API_CALL(BunnyManager::Api_GetListOfAllBunnies) {
 		return new ApiManager::ApiError("Access denied");
 
 	QMap<QString, QVariant> list;
-	foreach(Bunny * b, listOfBunnies)
+	foreach(Bunny * b, GetAllBunnies())
 		list.insert(b->GetID(), b->GetBunnyName());
 
 	return new ApiManager::ApiMappedList(list);
@@ -221,9 +396,8 @@ API_CALL(BunnyManager::Api_GetListOfAllConnectedBunnies) {
 		return new ApiManager::ApiError("Access denied");
 
 	QMap<QString, QVariant> list;
-	foreach(Bunny * b, listOfBunnies)
-		if(b->IsConnected())
-			list.insert(b->GetID(), b->GetBunnyName());
+	foreach(Bunny * b, GetConnectedBunnies())
+		list.insert(b->GetID(), b->GetBunnyName());
 
 	return new ApiManager::ApiMappedList(list);
 }
@@ -235,7 +409,7 @@ API_CALL(BunnyManager::Api_GetListOfAllBunniesOwners) {
 		return new ApiManager::ApiError("Access denied");
 
 	QMap<QString, QVariant> list;
-	foreach(Bunny * b, listOfBunnies)
+	foreach(Bunny * b, GetAllBunnies())
 		list.insert(b->GetID(), b->GetGlobalSetting("OwnerAccount",""));
 
 	return new ApiManager::ApiMappedList(list);
@@ -248,7 +422,7 @@ API_CALL(BunnyManager::Api_ResetAllBunniesPassword) {
 		return new ApiManager::ApiError("Access denied");
 
 	QMap<QString, QVariant> list;
-	foreach(Bunny * b, listOfBunnies)
+	foreach(Bunny * b, GetAllBunnies())
 		b->ClearBunnyPassword();
 
 	return new ApiManager::ApiMappedList(list);
@@ -259,7 +433,7 @@ API_CALL(BunnyManager::Api_AddBunny) {
 		return new ApiManager::ApiError("Access denied");
 
 	QByteArray bunnyID = hRequest.GetArg("serial").toAscii();
-	if(listOfBunnies.contains(bunnyID))
+	if(GetKnownBunny(bunnyID))
 		return new ApiManager::ApiError("Bunny already exists");
 
 	GetBunny(bunnyID);
@@ -267,3 +441,5 @@ API_CALL(BunnyManager::Api_AddBunny) {
 }
 
 QHash<QByteArray, Bunny *> BunnyManager::listOfBunnies;
+QHash<QByteArray, bool> BunnyManager::knownBunnies;
+QReadWriteLock BunnyManager::listOfBunniesLock;
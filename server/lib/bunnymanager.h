@@ -2,23 +2,30 @@
 #define _BUNNYMANAGER_H_
 
 #include <QHash>
+#include <QReadWriteLock>
 #include <QVector>
 #include "global.h"
 #include "apihandler.h"
 #include "apimanager.h"
+#include "recordstore.h"
 
 class Account;
 class Bunny;
+class BunnyEvictor;
 class HTTPRequest;
+class Packet;
 class PluginInterface;
 class OJN_EXPORT BunnyManager : public ApiHandler<BunnyManager>
 {
 	friend class PluginAuth;
 	friend class ApiManager;
 	friend class PluginManager;
+	friend class BunnyBroadcast;
+	friend class BunnyEvictor;
 public:
 	static BunnyManager & Instance();
 
+	// Bunnies are loaded when first needed (auth, Api call, plugin...)
 	static Bunny * GetBunny(PluginInterface *, QByteArray const&);
 	static Bunny * GetBunny(QByteArray const&);
 	static void PluginStateChanged(PluginInterface *);
@@ -28,6 +35,13 @@ public:
 
 	static QList<QByteArray> GetConnectedBunniesList(void);
 
+	// Broadcast filters, combined with |
+	enum BroadcastFilter { Broadcast_Connected = 0, Broadcast_Idle = 1, Broadcast_Awake = 2 };
+	// Sends the packet to the connected bunnies (having 'plugin' if set), encoding it only once
+	// Main thread only, large fan-outs are spread over several event loop iterations
+	static void Broadcast(Packet const&, int filters = Broadcast_Connected, PluginInterface * plugin = 0);
+	static void Broadcast(Packet const&, QList<QByteArray> const& recipients, int filters = Broadcast_Connected);
+
 	// API
 	static void InitApiCalls();
 	int GetConnectedBunnyCount();
@@ -52,10 +66,22 @@ protected:
 private:
 	BunnyManager();
 	void LoadAllBunnies();
-	void DeleteBunny(QByteArray const&);
+	bool DeleteBunny(QByteArray const&);
+	static Bunny * LoadBunny(QByteArray const& bunnyID);
+	static Bunny * GetKnownBunny(QByteArray const&);
+	static QList<Bunny *> GetAllBunnies();
+	static bool IsEvictable(Bunny *, uint now, uint idleTimeout);
+	static void EvictIdleBunnies(uint idleTimeout);
 
 	QDir bunniesDir;
+	RecordStore store; // Config/UseRecordStore
+	BunnyEvictor * evictor;
+	// Loaded bunnies
 	static QHash<QByteArray, Bunny *> listOfBunnies;
+	// Every known bunny, true while its config has to be read from the record store
+	static QHash<QByteArray, bool> knownBunnies;
+	// Api worker threads load known bunnies too, new bunnies are only created by the main thread
+	static QReadWriteLock listOfBunniesLock;
 };
 
 inline void BunnyManager::Init()
@@ -0,0 +1,96 @@
+#include <QDataStream>
+#include <QFile>
+#include "configjournal.h"
+#include "configwriter.h"
+#include "log.h"
+#include "persistencescheduler.h"
+#include "settings.h"
+
+ConfigJournal::ConfigJournal():owner(0),journalSize(0),compactionNeeded(false) {}
+
+void ConfigJournal::SetOwner(Persistent * p)
+{
+	owner = p;
+}
+
+qint64 ConfigJournal::MaxSize()
+{
+	static qint64 maxSize = GlobalSettings::GetInt("Config/ConfigJournalMaxSize", 65536);
+	return maxSize;
+}
+
+void ConfigJournal::SetFileName(QString const& snapshot)
+{
+	snapshotFileName = snapshot;
+	journalFileName = snapshot + ".journal";
+	journalSize = QFile(journalFileName).size();
+	compactionNeeded = !QFile::exists(snapshotFileName);
+}
+
+void ConfigJournal::SetFileName(QString const& snapshot, qint64 size)
+{
+	snapshotFileName = snapshot;
+	journalFileName = snapshot + ".journal";
+	journalSize = size;
+	compactionNeeded = false;
+}
+
+QList<ConfigJournal::Record> ConfigJournal::Load()
+{
+	QFile file(journalFileName);
+	if(!file.open(QIODevice::ReadOnly))
+		return QList<Record>();
+	return Load(file.readAll());
+}
+
+QList<ConfigJournal::Record> ConfigJournal::Load(QByteArray const& journal)
+{
+	QList<Record> records;
+	if(journal.isEmpty())
+		return records;
+
+	QDataStream in(journal);
+	in.setVersion(QDataStream::Qt_4_3);
+	while(!in.atEnd())
+	{
+		Record r;
+		in >> r.operation >> r.plugin >> r.key >> r.value;
+		if(in.status() != QDataStream::Ok)
+		{
+			LogWarning(QString("Truncated config journal : %1").arg(journalFileName));
+			// The snapshot will be rewritten without the broken record
+			compactionNeeded = true;
+			break;
+		}
+		records.append(r);
+	}
+	return records;
+}
+
+void ConfigJournal::Append(Operation operation, QString const& plugin, QString const& key, QVariant const& value)
+{
+	bool wasClean = buffer.isEmpty();
+	QDataStream out(&buffer, QIODevice::WriteOnly | QIODevice::Append);
+	out.setVersion(QDataStream::Qt_4_3);
+	out << (quint8)operation << plugin << key << value;
+	if(wasClean && owner)
+		PersistenceScheduler::Schedule(owner);
+}
+
+void ConfigJournal::Flush()
+{
+	if(buffer.isEmpty())
+		return;
+	ConfigWriter::AppendJournal(snapshotFileName, buffer);
+	journalSize += buffer.size();
+	buffer.clear();
+}
+
+void ConfigJournal::Compact(QByteArray const& snapshot)
+{
+	// The snapshot contains the buffered changes too
+	ConfigWriter::Write(snapshotFileName, snapshot, true);
+	buffer.clear();
+	journalSize = 0;
+	compactionNeeded = false;
+}
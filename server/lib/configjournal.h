@@ -0,0 +1,68 @@
+#ifndef _CONFIGJOURNAL_H_
+#define _CONFIGJOURNAL_H_
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVariant>
+#include "global.h"
+
+class Persistent;
+// Changes made to a config file (the snapshot) are appended to "<snapshot>.journal"
+// and replayed after the snapshot is loaded. The snapshot is only rewritten when the
+// journal gets bigger than Config/ConfigJournalMaxSize bytes
+// Files are written by the ConfigWriter thread, ConfigWriter::Wait(snapshot) before reading them
+class OJN_EXPORT ConfigJournal
+{
+public:
+	enum Operation { SetGlobal = 1, RemoveGlobal, SetPlugin, RemovePlugin, SetPluginList, SetRFIDTag };
+	struct Record
+	{
+		quint8 operation;
+		QString plugin;
+		QString key;
+		QVariant value;
+	};
+
+	ConfigJournal();
+	// Scheduled for saving (PersistenceScheduler) when it gets dirty
+	void SetOwner(Persistent *);
+	void SetFileName(QString const& snapshot);
+	// The snapshot exists and the journal size is already known (RecordStore)
+	void SetFileName(QString const& snapshot, qint64 journalSize);
+
+	// Records of the journal file, a truncated last record (crash) is ignored
+	QList<Record> Load();
+	QList<Record> Load(QByteArray const& journal);
+	// Buffered until the next Flush
+	void Append(Operation, QString const& plugin, QString const& key, QVariant const& value = QVariant());
+
+	bool IsDirty() const;
+	bool NeedsCompaction() const;
+	// Hands the buffered records over to the ConfigWriter, appended to the journal
+	void Flush();
+	// Replaces the snapshot (crash safe) and empties the journal, by the ConfigWriter
+	void Compact(QByteArray const& snapshot);
+
+private:
+	static qint64 MaxSize();
+
+	QString snapshotFileName;
+	QString journalFileName;
+	Persistent * owner;
+	QByteArray buffer;
+	qint64 journalSize;
+	bool compactionNeeded; // No snapshot yet, or a broken journal
+};
+
+inline bool ConfigJournal::IsDirty() const
+{
+	return !buffer.isEmpty();
+}
+
+inline bool ConfigJournal::NeedsCompaction() const
+{
+	return compactionNeeded || journalSize + buffer.size() > MaxSize();
+}
+
+#endif
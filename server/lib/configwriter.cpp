@@ -0,0 +1,184 @@
+#include <QFile>
+#include <QMutexLocker>
+#include <cstdio>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "configwriter.h"
+#include "log.h"
+
+ConfigWriter * ConfigWriter::instance = 0;
+
+ConfigWriter::ConfigWriter():stopping(false) {}
+
+void ConfigWriter::Init()
+{
+	instance = new ConfigWriter();
+	instance->start();
+}
+
+void ConfigWriter::Close()
+{
+	if(!instance)
+		return;
+	{
+		QMutexLocker locker(&instance->lock);
+		instance->stopping = true;
+		instance->jobAdded.wakeAll();
+	}
+	instance->wait();
+	delete instance;
+	instance = 0;
+}
+
+ConfigWriter::Job & ConfigWriter::GetJob(QString const& fileName)
+{
+	QHash<QString, Job>::iterator it = pending.find(fileName);
+	if(it != pending.end())
+		return it.value();
+	queue.enqueue(fileName);
+	jobAdded.wakeOne();
+	return pending[fileName];
+}
+
+void ConfigWriter::Write(QString const& fileName, QByteArray const& data, bool dropJournal)
+{
+	if(!instance)
+	{
+		if(WriteFile(fileName, data) && dropJournal)
+			QFile::remove(fileName + ".journal");
+		return;
+	}
+	QMutexLocker locker(&instance->lock);
+	Job & job = instance->GetJob(fileName);
+	job.hasSnapshot = true;
+	job.snapshot = data;
+	if(dropJournal)
+	{
+		// Already in the snapshot
+		job.journal.clear();
+		job.dropJournal = true;
+	}
+}
+
+void ConfigWriter::AppendJournal(QString const& fileName, QByteArray const& data)
+{
+	if(!instance)
+	{
+		AppendFile(fileName + ".journal", data);
+		return;
+	}
+	QMutexLocker locker(&instance->lock);
+	instance->GetJob(fileName).journal.append(data);
+}
+
+void ConfigWriter::Wait(QString const& fileName)
+{
+	if(!instance)
+		return;
+	QMutexLocker locker(&instance->lock);
+	while(instance->pending.contains(fileName) || instance->current == fileName)
+		instance->jobDone.wait(&instance->lock);
+}
+
+void ConfigWriter::Sync()
+{
+	if(!instance)
+		return;
+	QMutexLocker locker(&instance->lock);
+	while(!instance->queue.isEmpty() || !instance->current.isNull())
+		instance->jobDone.wait(&instance->lock);
+}
+
+void ConfigWriter::run()
+{
+	QMutexLocker locker(&lock);
+	forever
+	{
+		while(queue.isEmpty() && !stopping)
+			jobAdded.wait(&lock);
+		if(queue.isEmpty())
+			break;
+		current = queue.dequeue();
+		Job job = pending.take(current);
+		// Written without the lock, the same file can be queued again meanwhile
+		locker.unlock();
+		Execute(current, job);
+		locker.relock();
+		current = QString();
+		jobDone.wakeAll();
+	}
+}
+
+void ConfigWriter::Execute(QString const& fileName, Job const& job)
+{
+	if(job.hasSnapshot)
+	{
+		// The old snapshot and journal are kept together if it fails
+		if(!WriteFile(fileName, job.snapshot))
+			return;
+		if(job.dropJournal)
+			QFile::remove(fileName + ".journal");
+	}
+	if(!job.journal.isEmpty())
+		AppendFile(fileName + ".journal", job.journal);
+}
+
+bool ConfigWriter::SyncFile(QFile & file)
+{
+	if(!file.flush())
+		return false;
+#ifdef Q_OS_WIN
+	return _commit(file.handle()) == 0;
+#else
+	return fsync(file.handle()) == 0;
+#endif
+}
+
+bool ConfigWriter::AppendFile(QString const& fileName, QByteArray const& data)
+{
+	QFile file(fileName);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Append))
+	{
+		LogError(QString("Cannot open config journal for writing : %1").arg(fileName));
+		return false;
+	}
+	// A partial record is ignored when loading, the next compaction removes it
+	if(file.write(data) != data.size() || !SyncFile(file))
+	{
+		LogError(QString("Cannot write config journal : %1").arg(fileName));
+		return false;
+	}
+	return true;
+}
+
+bool ConfigWriter::WriteFile(QString const& fileName, QByteArray const& data)
+{
+	QString tmpFileName = fileName + ".tmp";
+	QFile file(tmpFileName);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		LogError(QString("Cannot open config file for writing : %1").arg(tmpFileName));
+		return false;
+	}
+	if(file.write(data) != data.size() || !SyncFile(file))
+	{
+		LogError(QString("Cannot write config file : %1").arg(tmpFileName));
+		file.close();
+		file.remove();
+		return false;
+	}
+	file.close();
+#ifdef Q_OS_WIN
+	// rename doesn't replace an existing file
+	QFile::remove(fileName);
+#endif
+	if(::rename(QFile::encodeName(tmpFileName).constData(), QFile::encodeName(fileName).constData()) != 0)
+	{
+		LogError(QString("Cannot replace config file : %1").arg(fileName));
+		return false;
+	}
+	return true;
+}
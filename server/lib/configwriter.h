@@ -0,0 +1,65 @@
+#ifndef _CONFIGWRITER_H_
+#define _CONFIGWRITER_H_
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+#include "global.h"
+
+// Config files are written by one background thread, the callers only hand over the data
+// Writes to the same file are coalesced : only the last snapshot is written, journal appends are concatenated
+// A snapshot is written to a temporary file, synced, then renamed over the old one
+class OJN_EXPORT ConfigWriter : public QThread
+{
+public:
+	static void Init();
+	// Writes everything still pending
+	static void Close();
+
+	// Replaces fileName, and removes its journal once done if dropJournal
+	static void Write(QString const& fileName, QByteArray const& data, bool dropJournal = false);
+	// Appended to "<fileName>.journal"
+	static void AppendJournal(QString const& fileName, QByteArray const& data);
+	// Blocks until the writes of fileName are done, before reading or removing it
+	static void Wait(QString const& fileName);
+	// Blocks until every write is done
+	static void Sync();
+
+	// Synchronous crash safe write
+	static bool WriteFile(QString const& fileName, QByteArray const& data);
+
+protected:
+	void run();
+
+private:
+	struct Job
+	{
+		Job():hasSnapshot(false),dropJournal(false) {}
+		bool hasSnapshot;
+		bool dropJournal;
+		QByteArray snapshot;
+		QByteArray journal;
+	};
+
+	ConfigWriter();
+	static void Execute(QString const& fileName, Job const&);
+	static bool AppendFile(QString const& fileName, QByteArray const& data);
+	static bool SyncFile(QFile &);
+	Job & GetJob(QString const& fileName);
+
+	static ConfigWriter * instance;
+	QMutex lock;
+	QWaitCondition jobAdded;
+	QWaitCondition jobDone;
+	QHash<QString, Job> pending;
+	QQueue<QString> queue;
+	QString current;
+	bool stopping;
+};
+
+#endif
@@ -254,6 +254,16 @@ void Cron::UnregisterAll(PluginInterface * p)
 	}
 }
 
+bool Cron::HasBunny(Bunny * b)
+{
+	foreach(CronElement const& e, Instance().CronElements)
+	{
+		if(e.bunny == b)
+			return true;
+	}
+	return false;
+}
+
 Cron& Cron::Instance() {
   static Cron theCron;
   return theCron;
@@ -35,6 +35,7 @@ public:
 	static void Unregister(PluginInterface *, unsigned int id);
 	static void UnregisterAllForBunny(PluginInterface *, Bunny *);
 	static void UnregisterAll(PluginInterface *);
+	static bool HasBunny(Bunny *);
 
 private slots:
 	void OnTimer();
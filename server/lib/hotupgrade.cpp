@@ -0,0 +1,270 @@
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QVector>
+#include <QtGlobal>
+#ifndef Q_OS_WIN
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+#include "hotupgrade.h"
+#include "log.h"
+
+QList<HotUpgrade::Listener> HotUpgrade::listeners;
+QList<HotUpgrade::Session> HotUpgrade::sessions;
+QString HotUpgrade::program;
+QStringList HotUpgrade::arguments;
+bool HotUpgrade::pending = false;
+
+static char const argumentName[] = "--hot-upgrade";
+
+#ifndef Q_OS_WIN
+// Close-on-exec flag : only the descriptors handed over are inherited by the new binary
+static void SetInherited(int descriptor, bool inherited)
+{
+	int flags = ::fcntl(descriptor, F_GETFD);
+	if(flags != -1)
+		::fcntl(descriptor, F_SETFD, inherited ? (flags & ~FD_CLOEXEC) : (flags | FD_CLOEXEC));
+}
+
+static int Duplicate(int descriptor)
+{
+	int d = ::dup(descriptor);
+	if(d != -1)
+		SetInherited(d, false);
+	return d;
+}
+
+static bool WriteAll(int descriptor, char const * data, int size)
+{
+	while(size > 0)
+	{
+		ssize_t n = ::write(descriptor, data, size);
+		if(n <= 0)
+			return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool ReadAll(int descriptor, char * data, int size)
+{
+	while(size > 0)
+	{
+		ssize_t n = ::read(descriptor, data, size);
+		if(n <= 0)
+			return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+#endif
+
+void HotUpgrade::AddListener(QString const& name, int descriptor)
+{
+#ifndef Q_OS_WIN
+	Listener l;
+	l.name = name;
+	l.descriptor = Duplicate(descriptor);
+	if(l.descriptor != -1)
+		listeners.append(l);
+#else
+	Q_UNUSED(name);
+	Q_UNUSED(descriptor);
+#endif
+}
+
+void HotUpgrade::AddSession(Session const& s)
+{
+	sessions.append(s);
+}
+
+bool HotUpgrade::Prepare(QString const& p, QStringList const& a)
+{
+#ifndef Q_OS_WIN
+	// Checked while the server still runs, exec can't be undone
+	if(::access(QFile::encodeName(p).constData(), X_OK) != 0)
+	{
+		LogError(QString("Hot upgrade : %1 can't be executed, the server keeps running").arg(p));
+		return false;
+	}
+	program = p;
+	// Drop the arguments given by a previous upgrade
+	arguments = a.mid(1);
+	int i = arguments.indexOf(argumentName);
+	if(i != -1)
+	{
+		arguments.removeAt(i);
+		if(i < arguments.size())
+			arguments.removeAt(i);
+	}
+	pending = true;
+	return true;
+#else
+	Q_UNUSED(p);
+	Q_UNUSED(a);
+	LogError("Hot upgrade isn't available on this platform");
+	return false;
+#endif
+}
+
+int HotUpgrade::Exec()
+{
+#ifndef Q_OS_WIN
+	// exec keeps the descriptors, their numbers are given as they are
+	QByteArray state;
+	QDataStream out(&state, QIODevice::WriteOnly);
+	out.setVersion(QDataStream::Qt_4_3);
+	out << (quint32)listeners.size();
+	foreach(Listener const& l, listeners)
+		out << l.name << (qint32)l.descriptor;
+	out << (quint32)sessions.size();
+	foreach(Session const& s, sessions)
+		out << (qint32)s.descriptor << s.bunnyID << s.resource << s.ready << s.pending;
+
+	char path[] = "/tmp/openjabnab-upgrade-XXXXXX";
+	int stateFile = ::mkstemp(path);
+	bool ok = (stateFile != -1);
+	if(ok)
+	{
+		::unlink(path);
+		QByteArray header;
+		QDataStream(&header, QIODevice::WriteOnly) << (quint32)state.size();
+		ok = WriteAll(stateFile, header.constData(), header.size()) && WriteAll(stateFile, state.constData(), state.size()) && ::lseek(stateFile, 0, SEEK_SET) == 0;
+	}
+	if(ok)
+	{
+		// Descriptors opened without close-on-exec (log file ...) would stay open in every new binary
+		QDir openDescriptors("/proc/self/fd");
+		foreach(QString d, openDescriptors.entryList(QDir::NoDotAndDotDot | QDir::AllEntries | QDir::System))
+		{
+			if(d.toInt() > 2)
+				SetInherited(d.toInt(), false);
+		}
+		SetInherited(stateFile, true);
+		foreach(Listener const& l, listeners)
+			SetInherited(l.descriptor, true);
+		foreach(Session const& s, sessions)
+			SetInherited(s.descriptor, true);
+
+		QList<QByteArray> args;
+		args.append(program.toLocal8Bit());
+		foreach(QString a, arguments)
+			args.append(a.toLocal8Bit());
+		args.append(argumentName);
+		args.append(QByteArray::number(stateFile));
+		QVector<char *> argv;
+		for(int i = 0; i < args.size(); i++)
+			argv.append(args[i].data());
+		argv.append(0);
+
+		LogInfo(QString("Hot upgrade : handing %1 listener(s) and %2 session(s) over to %3").arg(listeners.size()).arg(sessions.size()).arg(program));
+		::execv(argv[0], argv.data());
+		LogError(QString("Hot upgrade : unable to execute %1").arg(program));
+	}
+	else
+		LogError("Hot upgrade : unable to write the state");
+
+	if(stateFile != -1)
+		::close(stateFile);
+	foreach(Listener const& l, listeners)
+		::close(l.descriptor);
+	foreach(Session const& s, sessions)
+		::close(s.descriptor);
+	return 1;
+#else
+	return 1;
+#endif
+}
+
+bool HotUpgrade::Receive(QStringList const& a)
+{
+	int i = a.indexOf(argumentName);
+	if(i == -1 || i + 1 >= a.size())
+		return false;
+#ifndef Q_OS_WIN
+	int stateFile = a.at(i + 1).toInt();
+	quint32 size = 0;
+	char header[4];
+	bool ok = ReadAll(stateFile, header, 4);
+	QByteArray state;
+	if(ok)
+	{
+		QDataStream(QByteArray::fromRawData(header, 4)) >> size;
+		state.resize(size);
+		ok = ReadAll(stateFile, state.data(), size);
+	}
+	::close(stateFile);
+	if(!ok)
+	{
+		LogError("Hot upgrade : unable to read the state");
+		return false;
+	}
+
+	QDataStream in(state);
+	in.setVersion(QDataStream::Qt_4_3);
+	quint32 count;
+	in >> count;
+	for(quint32 j = 0; j < count && in.status() == QDataStream::Ok; j++)
+	{
+		Listener l;
+		qint32 descriptor;
+		in >> l.name >> descriptor;
+		l.descriptor = descriptor;
+		listeners.append(l);
+	}
+	in >> count;
+	for(quint32 j = 0; j < count && in.status() == QDataStream::Ok; j++)
+	{
+		Session s;
+		qint32 descriptor;
+		in >> descriptor >> s.bunnyID >> s.resource >> s.ready >> s.pending;
+		s.descriptor = descriptor;
+		sessions.append(s);
+	}
+
+	ok = (in.status() == QDataStream::Ok);
+	// Not given to a later upgrade unless handed over again
+	foreach(Listener const& l, listeners)
+		SetInherited(l.descriptor, false);
+	foreach(Session const& s, sessions)
+		SetInherited(s.descriptor, false);
+	if(!ok)
+	{
+		// The listeners must be closed before they are bound again
+		LogError("Hot upgrade : invalid state, the sessions are dropped");
+		foreach(Listener const& l, listeners)
+			::close(l.descriptor);
+		foreach(Session const& s, sessions)
+			::close(s.descriptor);
+		listeners.clear();
+		sessions.clear();
+		return false;
+	}
+	LogInfo(QString("Hot upgrade : %1 listener(s) and %2 session(s) received").arg(listeners.size()).arg(sessions.size()));
+	return true;
+#else
+	return false;
+#endif
+}
+
+int HotUpgrade::TakeListener(QString const& name)
+{
+	for(int i = 0; i < listeners.size(); i++)
+	{
+		if(listeners.at(i).name == name)
+			return listeners.takeAt(i).descriptor;
+	}
+	return -1;
+}
+
+QList<HotUpgrade::Session> HotUpgrade::TakeSessions()
+{
+	QList<Session> s = sessions;
+	sessions.clear();
+	return s;
+}
@@ -0,0 +1,60 @@
+#ifndef _HOTUPGRADE_H_
+#define _HOTUPGRADE_H_
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include "global.h"
+
+// Zero downtime upgrade (Unix only)
+// On SIGUSR2 the server stops, then execs its binary again in place : the PID doesn't change and
+// the new binary inherits the listening sockets and the bunnies' XMPP connections, their state is
+// given in an unlinked temporary file
+class OJN_EXPORT HotUpgrade
+{
+public:
+	struct Session
+	{
+		int descriptor;
+		QByteArray bunnyID;
+		QByteArray resource;
+		bool ready;
+		QByteArray pending; // Received but not yet handled
+	};
+
+	// Old process, descriptors are duplicated so that they survive the shutdown
+	static void AddListener(QString const& name, int descriptor);
+	static void AddSession(Session const&);
+	// Called before anything is handed over, returns false if the binary can't be executed
+	static bool Prepare(QString const& program, QStringList const& arguments);
+	static bool IsPending();
+	// Called once the server is stopped, only returns if exec failed
+	static int Exec();
+
+	// New process, returns false if it wasn't started by a hot upgrade
+	static bool Receive(QStringList const& arguments);
+	// -1 if the listener wasn't handed over
+	static int TakeListener(QString const& name);
+	static QList<Session> TakeSessions();
+
+private:
+	struct Listener
+	{
+		QString name;
+		int descriptor;
+	};
+
+	static QList<Listener> listeners;
+	static QList<Session> sessions;
+	static QString program;
+	static QStringList arguments;
+	static bool pending;
+};
+
+inline bool HotUpgrade::IsPending()
+{
+	return pending;
+}
+
+#endif
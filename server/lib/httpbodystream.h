@@ -0,0 +1,21 @@
+#ifndef _HTTPBODYSTREAM_H_
+#define _HTTPBODYSTREAM_H_
+
+#include <QByteArray>
+#include "global.h"
+
+class HTTPRequest;
+// Receives the body of a request chunk by chunk, see PluginInterface::HttpRequestStream
+// Owned and deleted by the HttpHandler, even if the connection is lost before the end
+class OJN_EXPORT HttpBodyStream
+{
+public:
+	virtual ~HttpBodyStream() {}
+
+	// Called for each received chunk, return false to abort the request
+	virtual bool Write(QByteArray const&) = 0;
+	// Called once the whole body was received, the answer goes in request.reply
+	virtual void Finish(HTTPRequest &) = 0;
+};
+
+#endif
@@ -0,0 +1,267 @@
+#include <QDateTime>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QList>
+#include "httpfileserver.h"
+#include "log.h"
+#include "settings.h"
+
+HttpFileServer::HttpFileServer()
+{
+	root = QDir(GlobalSettings::GetString("Config/RealHttpRoot"));
+	QString httpRoot = GlobalSettings::GetString("Config/HttpRoot");
+	broadcastPrefix = "/broadcast/" + httpRoot + "/";
+	localPrefix = "/" + httpRoot + "/";
+	// Small files (chor, clock sounds ...) are kept in memory
+	cache.setMaxCost(GlobalSettings::GetInt("Config/HttpFileCacheSize", 4096) * 1024);
+	maxCachedFileSize = GlobalSettings::GetInt("Config/HttpFileCacheMaxFileSize", 64) * 1024;
+}
+
+HttpFileServer & HttpFileServer::Instance()
+{
+	static HttpFileServer f;
+	return f;
+}
+
+// Returns the path relative to RealHttpRoot, or a null string
+QString HttpFileServer::MapUri(QString const& uri) const
+{
+	QString path;
+	if(uri.startsWith(broadcastPrefix))
+		path = uri.mid(broadcastPrefix.length());
+	else if(uri.startsWith(localPrefix))
+		path = uri.mid(localPrefix.length());
+	else if(uri == "/vl/bc.jsp")
+		path = "bootcode/bootcode.default"; // Same as .htaccess
+	else
+		return QString();
+
+	// Never go outside of RealHttpRoot
+	path = QDir::cleanPath(path);
+	if(path.isEmpty() || path == "." || path == ".." || path.startsWith("../") || path.startsWith('/') || path.contains('\\') || path.contains(':') || path.contains(QChar(0)) || path.split('/').contains(".svn"))
+	{
+		LogWarning(QString("Refused to serve static file : %1").arg(uri));
+		return QString();
+	}
+	return path;
+}
+
+bool HttpFileServer::Serve(QString const& uri, QByteArray const& rawHeaders, bool headOnly, Reply & reply)
+{
+	QString path = MapUri(uri);
+	if(path.isNull())
+		return false;
+
+	uint now = QDateTime::currentDateTime().toTime_t();
+	QString fullPath = root.absoluteFilePath(path);
+	CachedFile * cached = cache.object(path);
+	QByteArray etag;
+	qint64 size;
+	if(cached && cached->lastCheck + 1 >= now)
+	{
+		// Checked less than a second ago, don't touch the filesystem
+		etag = cached->etag;
+		size = cached->data.size();
+	}
+	else
+	{
+		QFileInfo info(fullPath);
+		if(!info.isFile() || !info.isReadable())
+		{
+			cache.remove(path);
+			return false;
+		}
+		size = info.size();
+		etag = ETag(info);
+		if(cached)
+		{
+			if(cached->etag == etag)
+				cached->lastCheck = now;
+			else
+			{
+				cache.remove(path);
+				cached = 0;
+			}
+		}
+	}
+
+	reply.status = 200;
+	reply.contentType = ContentType(path);
+	reply.headers = "ETag: " + etag + "\r\nAccept-Ranges: bytes\r\n";
+	reply.body.clear();
+	reply.transfer = 0;
+
+	QByteArray ifNoneMatch = GetHeader(rawHeaders, "if-none-match");
+	if(!ifNoneMatch.isEmpty())
+	{
+		foreach(QByteArray tag, ifNoneMatch.split(','))
+		{
+			tag = tag.trimmed();
+			if(tag == etag || tag == "*")
+			{
+				reply.status = 304;
+				reply.contentLength = -1;
+				return true;
+			}
+		}
+	}
+
+	qint64 offset = 0;
+	qint64 length = size;
+	QByteArray range = GetHeader(rawHeaders, "range");
+	if(!range.isEmpty())
+	{
+		int r = ParseRange(range, size, offset, length);
+		if(r < 0)
+		{
+			reply.status = 416;
+			reply.headers += "Content-Range: bytes */" + QByteArray::number(size) + "\r\n";
+			reply.contentLength = 0;
+			return true;
+		}
+		if(r > 0)
+		{
+			reply.status = 206;
+			reply.headers += "Content-Range: bytes " + QByteArray::number(offset) + "-" + QByteArray::number(offset + length - 1) + "/" + QByteArray::number(size) + "\r\n";
+		}
+	}
+	reply.contentLength = length;
+	if(headOnly)
+		return true;
+
+	if(size <= maxCachedFileSize)
+	{
+		QByteArray data;
+		if(cached)
+			data = cached->data;
+		else
+		{
+			QFile file(fullPath);
+			if(!file.open(QIODevice::ReadOnly))
+				return false;
+			data = file.readAll();
+			// The file is being written, it is only cached once complete
+			QFileInfo info(fullPath);
+			if(data.size() != size || ETag(info) != etag)
+				return false;
+			cached = new CachedFile;
+			cached->data = data;
+			cached->etag = etag;
+			cached->lastCheck = now;
+			cache.insert(path, cached, qMax(1, data.size()));
+		}
+		reply.body = (offset == 0 && length == size) ? data : data.mid(offset, length);
+	}
+	else
+	{
+		QFile * file = new QFile(fullPath);
+		if(!file->open(QIODevice::ReadOnly))
+		{
+			delete file;
+			return false;
+		}
+		reply.transfer = new Transfer(file, offset, length);
+	}
+	return true;
+}
+
+QByteArray HttpFileServer::ETag(QFileInfo const& info)
+{
+	return QString("\"%1-%2\"").arg(info.size(), 0, 16).arg(info.lastModified().toTime_t(), 0, 16).toAscii();
+}
+
+// Case insensitive lookup of a header value
+QByteArray HttpFileServer::GetHeader(QByteArray const& rawHeaders, QByteArray const& name)
+{
+	foreach(QByteArray line, rawHeaders.split('\n'))
+	{
+		int i = line.indexOf(':');
+		if(i != -1 && line.left(i).trimmed().toLower() == name)
+			return line.mid(i + 1).trimmed();
+	}
+	return QByteArray();
+}
+
+QByteArray HttpFileServer::ContentType(QString const& path)
+{
+	QString suffix = QFileInfo(path).suffix().toLower();
+	if(suffix == "mp3")
+		return "audio/mpeg";
+	if(suffix == "wav")
+		return "audio/x-wav";
+	if(suffix == "html" || suffix == "htm")
+		return "text/html";
+	if(suffix == "txt")
+		return "text/plain";
+	return "application/octet-stream";
+}
+
+// "bytes=first-last", "bytes=first-" or "bytes=-suffix"
+// Returns 1 for a valid range, 0 if it should be ignored (whole file sent), -1 if it can't be satisfied
+int HttpFileServer::ParseRange(QByteArray const& range, qint64 size, qint64 & offset, qint64 & length)
+{
+	if(!range.startsWith("bytes=") || range.contains(','))
+		return 0; // Multiple ranges aren't supported
+	QByteArray spec = range.mid(6).trimmed();
+	int dash = spec.indexOf('-');
+	if(dash == -1)
+		return 0;
+	bool ok;
+	qint64 first, last;
+	if(dash == 0)
+	{
+		qint64 suffix = spec.mid(1).toLongLong(&ok);
+		if(!ok)
+			return 0;
+		if(suffix <= 0 || size == 0)
+			return -1;
+		first = qMax((qint64)0, size - suffix);
+		last = size - 1;
+	}
+	else
+	{
+		first = spec.left(dash).toLongLong(&ok);
+		if(!ok)
+			return 0;
+		if(dash == spec.size() - 1)
+			last = size - 1;
+		else
+		{
+			last = spec.mid(dash + 1).toLongLong(&ok);
+			if(!ok || last < first)
+				return 0;
+			last = qMin(last, size - 1);
+		}
+		if(first >= size)
+			return -1;
+	}
+	offset = first;
+	length = last - first + 1;
+	return 1;
+}
+
+/************/
+/* Transfer */
+/************/
+HttpFileServer::Transfer::Transfer(QFile * f, qint64 offset, qint64 length):file(f),remaining(length)
+{
+	file->seek(offset);
+}
+
+HttpFileServer::Transfer::~Transfer()
+{
+	delete file;
+}
+
+bool HttpFileServer::Transfer::Send(QIODevice * out, qint64 max)
+{
+	qint64 size = qMin(max, remaining);
+	if(size <= 0)
+		return true;
+	// Shorter if the file was truncated meanwhile, the transfer fails
+	QByteArray data = file->read(size);
+	if(data.size() != size || out->write(data) != size)
+		return false;
+	remaining -= size;
+	return true;
+}
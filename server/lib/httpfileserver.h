@@ -0,0 +1,75 @@
+#ifndef _HTTPFILESERVER_H_
+#define _HTTPFILESERVER_H_
+
+#include <QByteArray>
+#include <QCache>
+#include <QDir>
+#include <QFile>
+#include <QString>
+#include "global.h"
+
+class QFileInfo;
+class QIODevice;
+// Serves Config/RealHttpRoot (broadcast files, bootcode) on the native HTTP listener
+class OJN_EXPORT HttpFileServer
+{
+public:
+	// Big file sent chunk by chunk by the HttpHandler
+	// Read through QFile, not mapped : TTS sounds and others may be rewritten in place while being sent
+	class Transfer
+	{
+	public:
+		Transfer(QFile *, qint64 offset, qint64 length);
+		~Transfer();
+		// Write at most 'max' bytes to the device, returns false on error
+		bool Send(QIODevice *, qint64 max);
+		bool AtEnd() const;
+
+	private:
+		QFile * file;
+		qint64 remaining;
+	};
+
+	struct Reply
+	{
+		int status;
+		QByteArray contentType;
+		QByteArray headers; // ETag, Content-Range ...
+		qint64 contentLength;
+		QByteArray body; // Whole content when the file is small, else 'transfer' is set
+		Transfer * transfer;
+	};
+
+	static HttpFileServer & Instance();
+
+	// Returns false if the uri isn't an existing static file
+	bool Serve(QString const& uri, QByteArray const& rawHeaders, bool headOnly, Reply &);
+
+private:
+	struct CachedFile
+	{
+		QByteArray data;
+		QByteArray etag;
+		uint lastCheck;
+	};
+
+	HttpFileServer();
+	QString MapUri(QString const& uri) const;
+	static QByteArray ETag(QFileInfo const&);
+	static QByteArray GetHeader(QByteArray const& rawHeaders, QByteArray const& name);
+	static QByteArray ContentType(QString const& path);
+	static int ParseRange(QByteArray const& range, qint64 size, qint64 & offset, qint64 & length);
+
+	QDir root;
+	QString broadcastPrefix;
+	QString localPrefix;
+	QCache<QString, CachedFile> cache;
+	qint64 maxCachedFileSize;
+};
+
+inline bool HttpFileServer::Transfer::AtEnd() const
+{
+	return remaining <= 0;
+}
+
+#endif
@@ -1,8 +1,13 @@
 #include <QByteArray>
+#include <QHostAddress>
+#include <QList>
+#include <cstring>
 #include <memory>
+#include "apiexecutor.h"
 #include "apimanager.h"
 #include "bunny.h"
 #include "bunnymanager.h"
+#include "httpbodystream.h"
 #include "httphandler.h"
 #include "httprequest.h"
 #include "log.h"
@@ -10,78 +15,704 @@
 #include "openjabnab.h"
 #include "settings.h"
 
-HttpHandler::HttpHandler(QTcpSocket * s, bool api, bool violetapi):pluginManager(PluginManager::Instance())
+#define HTTP_MAX_HEADER_SIZE (64*1024)
+#define HTTP_MAX_BODY_SIZE (16*1024*1024)
+// Chunk size lines and trailers
+#define HTTP_MAX_CHUNKED_OVERHEAD (1024*1024)
+#define HTTP_TRANSFER_CHUNK_SIZE (64*1024)
+// Api calls a v2 connection may have in the ApiExecutor, the next frames are left in the socket
+#define HTTP_MAX_PENDING_API_CALLS 32
+// What Qt buffers for a connection that is not read
+#define HTTP_READ_BUFFER_SIZE (256*1024)
+
+HttpHandler::HttpHandler(QTcpSocket * s, bool api, bool violetapi, Protocol p):pluginManager(PluginManager::Instance())
 {
 	incomingHttpSocket = s;
 	httpApi = api;
 	httpVioletApi = violetapi;
-	bytesToReceive = 0;
+	protocol = p;
+	headerScanPos = 0;
+	continueSent = false;
+	chunkedPos = 0;
+	chunkedTrailers = false;
+	streamChecked = false;
+	bodyStream = 0;
+	bodyStreamRequest = 0;
+	bodyStreamRemaining = 0;
+	bodyStreamId = 0;
+	bodyStreamV2 = false;
+	bodyStreamKeepAlive = false;
+	fileTransfer = 0;
+	transferKeepAlive = false;
+	s->setReadBufferSize(HTTP_READ_BUFFER_SIZE);
 	connect(s, SIGNAL(readyRead()), this, SLOT(ReceiveData()));
+	// Keep-alive and v2 connections are closed by the client, and a peer may
+	// go away before its request is complete : the handler must not stay behind
+	connect(s, SIGNAL(disconnected()), this, SLOT(Disconnect()));
 }
 
-HttpHandler::~HttpHandler() {}
+HttpHandler::~HttpHandler()
+{
+	// Connection lost before the end of a streamed body
+	delete bodyStream;
+	delete bodyStreamRequest;
+	delete fileTransfer;
+}
 
 void HttpHandler::ReceiveData()
 {
+	if(protocol == Protocol_Http)
+		ReceiveHttpData();
+	else
+		ReceiveWrapperData();
+}
+
+/********************/
+/* Wrapper protocol */
+/********************/
+void HttpHandler::ReceiveWrapperData()
+{
+	if(pendingApiCalls.size() >= HTTP_MAX_PENDING_API_CALLS)
+		return; // Read again by ApiCallFinished
+	receivedData += incomingHttpSocket->readAll();
+	if(bodyStream && !FeedBodyStream())
+		return;
+	// A v2 connection may carry several frames, v1 only one
+	// Frames are read in place, the requests share receivedData instead of copying their frame
+	int pos = 0;
+	while(incomingHttpSocket && pendingApiCalls.size() < HTTP_MAX_PENDING_API_CALLS && receivedData.size() - pos >= 5)
+	{
+		char const * frame = receivedData.constData() + pos;
+		int frameSize = *(int *)frame;
+		if(frameSize < 5 || frameSize > HTTP_MAX_BODY_SIZE)
+		{
+			LogError(QString("Invalid wrapper frame size : %1").arg(frameSize));
+			Disconnect();
+			return;
+		}
+		bool v2 = ((unsigned char)frame[4] & HTTPRequest::WrapperV2Flag);
+		if(v2 && frameSize < HTTPRequest::WrapperV2HeaderSize)
+		{
+			LogError("Invalid v2 wrapper frame");
+			Disconnect();
+			return;
+		}
+		if(receivedData.size() - pos < frameSize)
+		{
+			// The incomplete frame is moved to the beginning, once
+			receivedData.remove(0, pos);
+			pos = 0;
+			if(StartWrapperBodyStream(frameSize, v2))
+			{
+				if(!FeedBodyStream())
+					return;
+				continue;
+			}
+			// Avoid reallocations while the rest of the frame comes in
+			receivedData.reserve(frameSize);
+			return;
+		}
+		streamChecked = false;
+
+		HTTPRequest request(receivedData, pos, frameSize);
+		PendingApiCall context;
+		context.v2 = v2;
+		context.requestId = v2 ? *(quint32 *)(frame + 5) : 0;
+		context.keepAlive = v2;
+		context.headOnly = false;
+		pos += frameSize;
+		if(HandleBunnyHTTPRequest(request, context))
+			WriteWrapperAnswer(v2, context.requestId, request.reply);
+	}
+	// Drop the frames read, requests still running keep their own reference on the data
+	if(pos == receivedData.size())
+		receivedData.clear();
+	else
+		receivedData.remove(0, pos);
+}
+
+void HttpHandler::WriteWrapperAnswer(bool v2, quint32 requestId, QByteArray const& reply)
+{
+	if(v2)
+		WriteWrapperReply(requestId, reply);
+	else
+	{
+		incomingHttpSocket->write(reply);
+		Disconnect();
+	}
+}
+
+// Called while a POSTRAW frame is incomplete, once headers and URI are there
+// the body can be sent to a plugin stream instead of being buffered
+bool HttpHandler::StartWrapperBodyStream(int frameSize, bool v2)
+{
+	if(streamChecked)
+		return false;
+	HTTPRequest::RequestType type = (HTTPRequest::RequestType)((unsigned char)receivedData.at(4) & ~HTTPRequest::WrapperV2Flag);
+	if(type != HTTPRequest::POSTRAW)
+	{
+		streamChecked = true;
+		return false;
+	}
+	int begin = v2 ? HTTPRequest::WrapperV2HeaderSize : 5;
+	if(receivedData.size() < begin)
+		return false;
+	int headersEnd = receivedData.indexOf('\0', begin);
+	if(headersEnd == -1)
+		return false;
+	int uriEnd = receivedData.indexOf('\0', headersEnd + 1);
+	if(uriEnd == -1)
+		return false;
+	streamChecked = true;
+
+	HTTPRequest * request = new HTTPRequest(type, receivedData.mid(begin, headersEnd - begin), receivedData.mid(headersEnd + 1, uriEnd - headersEnd - 1));
+	HttpBodyStream * stream = pluginManager.HttpRequestStream(*request);
+	if(!stream)
+	{
+		delete request;
+		return false;
+	}
+	NetworkDump::Log("HTTP Stream Request", request->GetRawURI());
+	bodyStream = stream;
+	bodyStreamRequest = request;
+	bodyStreamRemaining = frameSize - (uriEnd + 1);
+	bodyStreamId = v2 ? *(quint32 *)(receivedData.constData() + 5) : 0;
+	bodyStreamV2 = v2;
+	receivedData.remove(0, uriEnd + 1);
+	return true;
+}
+
+// v2 answer : [int32 frame length][uint32 request id][reply]
+// Replies may be sent in any order, the proxy matches them by id
+void HttpHandler::WriteWrapperReply(quint32 requestId, QByteArray const& reply)
+{
+	int frameSize = 8 + reply.size();
+	QByteArray header(8, 0);
+	memcpy(header.data(), &frameSize, 4);
+	memcpy(header.data() + 4, &requestId, 4);
+	incomingHttpSocket->write(header);
+	incomingHttpSocket->write(reply);
+}
+
+/****************/
+/* Body streams */
+/****************/
+// Send what was received to the stream, returns true when the body is complete
+bool HttpHandler::FeedBodyStream()
+{
+	int size = qMin(bodyStreamRemaining, receivedData.size());
+	if(size > 0)
+	{
+		bool ok = bodyStream->Write(receivedData.left(size));
+		receivedData.remove(0, size);
+		bodyStreamRemaining -= size;
+		if(!ok)
+		{
+			LogError(QString("HTTP Stream aborted : ") + bodyStreamRequest->GetURI());
+			if(protocol == Protocol_Http)
+				RejectHttpRequest(400);
+			else
+				Disconnect(); // The rest of the frame can't be skipped safely
+			return false;
+		}
+	}
+	if(bodyStreamRemaining > 0)
+		return false;
+
+	HttpBodyStream * stream = bodyStream;
+	HTTPRequest * request = bodyStreamRequest;
+	bodyStream = 0;
+	bodyStreamRequest = 0;
+	streamChecked = false;
+	stream->Finish(*request);
+	delete stream;
+	if(protocol == Protocol_Http)
+	{
+		WriteHttpResponse(200, "text/html", request->reply, bodyStreamKeepAlive);
+		if(!bodyStreamKeepAlive)
+			Disconnect();
+	}
+	else
+		WriteWrapperAnswer(bodyStreamV2, bodyStreamId, request->reply);
+	delete request;
+	return incomingHttpSocket != 0;
+}
+
+/****************************/
+/* Native HTTP/1.1 protocol */
+/****************************/
+void HttpHandler::ReceiveHttpData()
+{
+	// Next requests are left in the socket until the file is sent or the Api call is done
+	if(fileTransfer || !pendingApiCalls.isEmpty())
+		return;
 	receivedData += incomingHttpSocket->readAll();
-	if(bytesToReceive == 0 && (receivedData.size() >= 4))
-		bytesToReceive = *(int *)receivedData.left(4).constData();
+	if(bodyStream && !FeedBodyStream())
+		return;
+	// Pipelined requests are answered in order
+	while(incomingHttpSocket && ParseHttpRequest()) {}
+}
 
-	if(bytesToReceive != 0 && (receivedData.size() == bytesToReceive))
-		HandleBunnyHTTPRequest();
+// Decodes the chunks received since the last call into chunkedBody
+// Returns -1 if more data is needed, 0 if the body is malformed, else the end of the request
+int HttpHandler::DecodeChunkedBody(int bodyStart)
+{
+	int pos = chunkedPos ? chunkedPos : bodyStart;
+	forever
+	{
+		int lineEnd = receivedData.indexOf("\r\n", pos);
+		if(lineEnd == -1)
+			return -1;
+		if(chunkedTrailers)
+		{
+			// Skip trailers until the empty line
+			bool lastLine = (lineEnd == pos);
+			chunkedPos = pos = lineEnd + 2;
+			if(lastLine)
+				return pos;
+			continue;
+		}
+		QByteArray sizeLine = receivedData.mid(pos, lineEnd - pos);
+		int extension = sizeLine.indexOf(';');
+		if(extension != -1)
+			sizeLine.truncate(extension);
+		bool ok;
+		int size = sizeLine.trimmed().toInt(&ok, 16);
+		if(!ok || size < 0 || chunkedBody.size() + size > HTTP_MAX_BODY_SIZE)
+			return 0;
+		int dataStart = lineEnd + 2;
+		if(size == 0)
+		{
+			chunkedTrailers = true;
+			chunkedPos = pos = dataStart;
+			continue;
+		}
+		if(receivedData.size() < dataStart + size + 2)
+			return -1; // The size line is parsed again with the rest of the chunk
+		if(receivedData.at(dataStart + size) != '\r' || receivedData.at(dataStart + size + 1) != '\n')
+			return 0;
+		chunkedBody.append(receivedData.constData() + dataStart, size);
+		chunkedPos = pos = dataStart + size + 2;
+	}
 }
 
-void HttpHandler::HandleBunnyHTTPRequest()
+// Forget the state of the request being parsed
+void HttpHandler::ResetHttpRequest()
+{
+	headerScanPos = 0;
+	continueSent = false;
+	streamChecked = false;
+	chunkedBody.clear();
+	chunkedPos = 0;
+	chunkedTrailers = false;
+}
+
+// Parse one request from receivedData, returns true if another request may follow
+bool HttpHandler::ParseHttpRequest()
+{
+	// Empty lines before the request line are ignored (RFC 7230 3.5), e.g. a CRLF after a POST body
+	int skip = 0;
+	while(receivedData.size() >= skip + 2 && receivedData.at(skip) == '\r' && receivedData.at(skip + 1) == '\n')
+		skip += 2;
+	if(skip)
+	{
+		receivedData.remove(0, skip);
+		headerScanPos = qMax(0, headerScanPos - skip);
+	}
+
+	int headerEnd = receivedData.indexOf("\r\n\r\n", headerScanPos);
+	if(headerEnd == -1)
+	{
+		if(receivedData.size() > HTTP_MAX_HEADER_SIZE)
+			RejectHttpRequest(431);
+		else
+			headerScanPos = qMax(0, receivedData.size() - 3); // Don't scan the same bytes again
+		return false;
+	}
+
+	// Request line : METHOD URI HTTP/1.x
+	int lineEnd = receivedData.indexOf("\r\n");
+	QList<QByteArray> requestLine = receivedData.left(lineEnd).split(' ');
+	if(requestLine.count() != 3 || !requestLine.at(2).startsWith("HTTP/1."))
+	{
+		RejectHttpRequest(400);
+		return false;
+	}
+	QByteArray const& method = requestLine.at(0);
+	QByteArray uri = requestLine.at(1);
+	bool http10 = (requestLine.at(2) == "HTTP/1.0");
+
+	// Headers
+	QByteArray rawHeaders = receivedData.mid(lineEnd + 2, headerEnd - lineEnd);
+	int contentLength = 0;
+	bool chunked = false;
+	bool keepAlive = !http10;
+	bool expectContinue = false;
+	QByteArray contentType;
+	foreach(QByteArray line, rawHeaders.split('\n'))
+	{
+		int i = line.indexOf(':');
+		if(i == -1)
+			continue;
+		QByteArray key = line.left(i).trimmed().toLower();
+		QByteArray value = line.mid(i + 1).trimmed();
+		if(key == "content-length")
+		{
+			bool ok;
+			contentLength = value.toInt(&ok);
+			if(!ok || contentLength < 0 || contentLength > HTTP_MAX_BODY_SIZE)
+			{
+				RejectHttpRequest(413);
+				return false;
+			}
+		}
+		else if(key == "transfer-encoding")
+			chunked = value.toLower().contains("chunked");
+		else if(key == "connection")
+		{
+			value = value.toLower();
+			if(value.contains("close"))
+				keepAlive = false;
+			else if(value.contains("keep-alive"))
+				keepAlive = true;
+		}
+		else if(key == "expect")
+			expectContinue = (value.toLower() == "100-continue");
+		else if(key == "content-type")
+			contentType = value.toLower();
+	}
+
+	// Body
+	int bodyStart = headerEnd + 4;
+	int requestEnd = bodyStart;
+	QByteArray body;
+	if(chunked)
+	{
+		int result = DecodeChunkedBody(bodyStart);
+		if(result == 0)
+		{
+			RejectHttpRequest(400);
+			return false;
+		}
+		if(result == -1)
+		{
+			// A size line without its end or endless trailers
+			if(receivedData.size() - bodyStart > HTTP_MAX_BODY_SIZE + HTTP_MAX_CHUNKED_OVERHEAD)
+			{
+				RejectHttpRequest(413);
+				return false;
+			}
+			if(expectContinue && !continueSent)
+			{
+				incomingHttpSocket->write("HTTP/1.1 100 Continue\r\n\r\n");
+				continueSent = true;
+			}
+			headerScanPos = headerEnd; // Headers are complete, wait for the body
+			return false;
+		}
+		requestEnd = result;
+		body = chunkedBody;
+	}
+	else if(contentLength > 0)
+	{
+		if(receivedData.size() < bodyStart + contentLength)
+		{
+			if(method == "POST" && StartHttpBodyStream(uri, rawHeaders, bodyStart, contentLength, keepAlive))
+			{
+				if(expectContinue)
+					incomingHttpSocket->write("HTTP/1.1 100 Continue\r\n\r\n");
+				headerScanPos = 0;
+				continueSent = false;
+				return FeedBodyStream() && !receivedData.isEmpty();
+			}
+			if(expectContinue && !continueSent)
+			{
+				incomingHttpSocket->write("HTTP/1.1 100 Continue\r\n\r\n");
+				continueSent = true;
+			}
+			headerScanPos = headerEnd;
+			return false;
+		}
+		body = receivedData.mid(bodyStart, contentLength);
+		requestEnd = bodyStart + contentLength;
+	}
+	receivedData.remove(0, requestEnd);
+	ResetHttpRequest();
+
+	// Map the HTTP message on the same request types as the wrapper
+	HTTPRequest::RequestType type;
+	bool headOnly = false;
+	if(method == "GET" || method == "HEAD")
+	{
+		type = HTTPRequest::GET;
+		headOnly = (method == "HEAD");
+		uri.replace('+', ' '); // Same as openjabnab.php
+	}
+	else if(method == "POST")
+	{
+		if(body.isEmpty() || contentType.startsWith("application/x-www-form-urlencoded"))
+			type = HTTPRequest::POST;
+		else
+			type = HTTPRequest::POSTRAW;
+	}
+	else
+	{
+		RejectHttpRequest(501);
+		return false;
+	}
+
+	HTTPRequest request(type, rawHeaders, uri, body);
+	if(type == HTTPRequest::GET && ServeStaticFile(request, rawHeaders, headOnly, keepAlive))
+		return incomingHttpSocket && !fileTransfer && !receivedData.isEmpty();
+	PendingApiCall context;
+	context.v2 = false;
+	context.requestId = 0;
+	context.keepAlive = keepAlive;
+	context.headOnly = headOnly;
+	int status = HandleBunnyHTTPRequest(request, context);
+	if(status == 0)
+		return false; // ApiCallFinished will go on with the pipelined requests
+	bool isApi = request.GetURI().startsWith("/ojn_api/") || request.GetURI().startsWith("/ojn/FR/api");
+	WriteHttpResponse(status, isApi ? "text/xml; charset=utf-8" : "text/html", request.reply, keepAlive, headOnly);
+	if(!keepAlive)
+	{
+		Disconnect();
+		return false;
+	}
+	return !receivedData.isEmpty();
+}
+
+// Same as StartWrapperBodyStream for an incomplete HTTP/1.1 body of known length
+bool HttpHandler::StartHttpBodyStream(QByteArray const& uri, QByteArray const& rawHeaders, int bodyStart, int contentLength, bool keepAlive)
+{
+	if(streamChecked)
+		return false;
+	streamChecked = true;
+	HTTPRequest * request = new HTTPRequest(HTTPRequest::POSTRAW, rawHeaders, uri);
+	HttpBodyStream * stream = pluginManager.HttpRequestStream(*request);
+	if(!stream)
+	{
+		delete request;
+		return false;
+	}
+	NetworkDump::Log("HTTP Stream Request", request->GetRawURI());
+	bodyStream = stream;
+	bodyStreamRequest = request;
+	bodyStreamRemaining = contentLength;
+	bodyStreamKeepAlive = keepAlive;
+	receivedData.remove(0, bodyStart);
+	return true;
+}
+
+static QByteArray HttpStatusText(int status)
+{
+	switch(status)
+	{
+		case 100: return "Continue";
+		case 200: return "OK";
+		case 206: return "Partial Content";
+		case 304: return "Not Modified";
+		case 400: return "Bad Request";
+		case 404: return "Not Found";
+		case 413: return "Payload Too Large";
+		case 416: return "Range Not Satisfiable";
+		case 431: return "Request Header Fields Too Large";
+		case 501: return "Not Implemented";
+		default: return "Unknown";
+	}
+}
+
+void HttpHandler::WriteHttpHeader(int status, QByteArray const& contentType, qint64 contentLength, bool keepAlive, QByteArray const& extraHeaders)
+{
+	QByteArray header;
+	header.reserve(160 + extraHeaders.size());
+	header.append("HTTP/1.1 ").append(QByteArray::number(status)).append(' ').append(HttpStatusText(status)).append("\r\n");
+	if(contentLength >= 0)
+	{
+		header.append("Content-Type: ").append(contentType).append("\r\n");
+		header.append("Content-Length: ").append(QByteArray::number(contentLength)).append("\r\n");
+	}
+	header.append(extraHeaders);
+	header.append(keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+	header.append("\r\n");
+	incomingHttpSocket->write(header);
+}
+
+void HttpHandler::WriteHttpResponse(int status, QByteArray const& contentType, QByteArray const& body, bool keepAlive, bool headOnly)
+{
+	WriteHttpHeader(status, contentType, body.size(), keepAlive);
+	if(!headOnly)
+		incomingHttpSocket->write(body);
+}
+
+/****************/
+/* Static files */
+/****************/
+bool HttpHandler::ServeStaticFile(HTTPRequest const& request, QByteArray const& rawHeaders, bool headOnly, bool keepAlive)
+{
+	HttpFileServer::Reply file;
+	if(!HttpFileServer::Instance().Serve(request.GetURI(), rawHeaders, headOnly, file))
+		return false;
+	WriteHttpHeader(file.status, file.contentType, file.contentLength, keepAlive, file.headers);
+	if(file.transfer)
+	{
+		fileTransfer = file.transfer;
+		transferKeepAlive = keepAlive;
+		connect(incomingHttpSocket, SIGNAL(bytesWritten(qint64)), this, SLOT(ContinueFileTransfer()));
+		SendFileChunks();
+	}
+	else
+	{
+		if(!headOnly)
+			incomingHttpSocket->write(file.body);
+		if(!keepAlive)
+			Disconnect();
+	}
+	return true;
+}
+
+// Only a few chunks are queued in the socket, the rest is sent as they are written
+// Returns true when the whole file was queued
+bool HttpHandler::SendFileChunks()
+{
+	while(!fileTransfer->AtEnd() && incomingHttpSocket->bytesToWrite() < HTTP_TRANSFER_CHUNK_SIZE)
+	{
+		if(!fileTransfer->Send(incomingHttpSocket, HTTP_TRANSFER_CHUNK_SIZE))
+		{
+			LogError("Static file transfer failed");
+			Disconnect();
+			return false;
+		}
+	}
+	if(!fileTransfer->AtEnd())
+		return false;
+	delete fileTransfer;
+	fileTransfer = 0;
+	disconnect(incomingHttpSocket, SIGNAL(bytesWritten(qint64)), this, SLOT(ContinueFileTransfer()));
+	if(!transferKeepAlive)
+		Disconnect();
+	return true;
+}
+
+void HttpHandler::ContinueFileTransfer()
+{
+	// Requests received during the transfer were kept for later
+	if(fileTransfer && SendFileChunks() && incomingHttpSocket)
+		ReceiveHttpData();
+}
+
+void HttpHandler::RejectHttpRequest(int status)
+{
+	LogWarning(QString("Invalid HTTP request from %1, answering %2").arg(incomingHttpSocket->peerAddress().toString(), QString::number(status)));
+	WriteHttpResponse(status, "text/html", HttpStatusText(status), false);
+	Disconnect();
+}
+
+/************/
+/* Dispatch */
+/************/
+// Fill request.reply and return the matching HTTP status
+int HttpHandler::HandleBunnyHTTPRequest(HTTPRequest & request, PendingApiCall const& context)
 {
-	HTTPRequest request(receivedData);
 	QString uri = request.GetURI();
 	if (uri.startsWith("/ojn_api/"))
 	{
 		NetworkDump::Log("Api Call", request.GetRawURI());
 		if(httpApi)
 		{
+			if(SubmitApiCall(uri.mid(9), request, context))
+				return 0;
 			std::auto_ptr<ApiManager::ApiAnswer> apianswer(ApiManager::Instance().ProcessApiCall(uri.mid(9), request));
-			QByteArray answer = apianswer->GetData();
-			incomingHttpSocket->write(answer);
-			NetworkDump::Log("Api Answer", answer);
+			request.reply = apianswer->GetData();
+			NetworkDump::Log("Api Answer", request.reply);
 		}
 		else
-			incomingHttpSocket->write("Api is disabled");
+			request.reply = "Api is disabled";
 	}
 	else if (uri.startsWith("/ojn/FR/api"))
 	{
 		NetworkDump::Log("Violet Api Call", request.GetRawURI());
 		if(httpVioletApi)
 		{
+			if(SubmitApiCall(uri, request, context))
+				return 0;
 			std::auto_ptr<ApiManager::ApiAnswer> apianswer(ApiManager::Instance().ProcessApiCall(uri, request));
-			QByteArray answer = apianswer->GetData();
-			incomingHttpSocket->write(answer);
-			NetworkDump::Log("Violet Api Answer", answer);
+			request.reply = apianswer->GetData();
+			NetworkDump::Log("Violet Api Answer", request.reply);
 		}
 		else
-			incomingHttpSocket->write("Violet Api is disabled");
+			request.reply = "Violet Api is disabled";
 	}
 	else
 	{
 		NetworkDump::Log("HTTP Request", request.GetRawURI());
 		pluginManager.HttpRequestBefore(request);
-		if (!pluginManager.HttpRequestHandle(request))
+		bool handled = pluginManager.HttpRequestHandle(request);
+		if (!handled)
 		{
 			LogError(QString("Unable to handle HTTP Request : ") + request.toString());
 			request.reply = "404 Not Found";
 		}
 		pluginManager.HttpRequestAfter(request);
-		incomingHttpSocket->write(request.reply);
 		if(!uri.contains("itmode.jsp") && !uri.contains(".mp3") && !uri.contains(".chor") && !uri.contains("bc.jsp") && request.reply.size() < 256) // Don't dump too big answers
 			NetworkDump::Log("HTTP Answer", request.reply);
+		if(!handled)
+			return 404;
 	}
-	Disconnect();
+	return 200;
+}
+
+bool HttpHandler::SubmitApiCall(QString const& call, HTTPRequest const& request, PendingApiCall const& context)
+{
+	ApiTask * task = ApiExecutor::Instance().Submit(call, request, this, SLOT(ApiCallFinished()));
+	if(!task)
+		return false;
+	PendingApiCall & pending = pendingApiCalls[task];
+	pending = context;
+	pending.violet = call.startsWith("/ojn/FR/api");
+	return true;
+}
+
+void HttpHandler::ApiCallFinished()
+{
+	ApiTask * task = qobject_cast<ApiTask *>(sender());
+	if(!task || !pendingApiCalls.contains(task))
+		return;
+	PendingApiCall pending = pendingApiCalls.take(task);
+	QByteArray const& answer = task->GetAnswer();
+	NetworkDump::Log(pending.violet ? "Violet Api Answer" : "Api Answer", answer);
+	if(!incomingHttpSocket)
+		return; // Connection closed during the call
+
+	if(protocol == Protocol_Wrapper)
+	{
+		WriteWrapperAnswer(pending.v2, pending.requestId, answer);
+		// Frames left behind once the limit of pending calls was reached
+		if(incomingHttpSocket)
+			ReceiveWrapperData();
+		return;
+	}
+	WriteHttpResponse(200, "text/xml; charset=utf-8", answer, pending.keepAlive, pending.headOnly);
+	if(!pending.keepAlive)
+	{
+		Disconnect();
+		return;
+	}
+	// Requests received during the call were kept for later
+	ReceiveHttpData();
 }
 
 void HttpHandler::Disconnect()
 {
+	if(!incomingHttpSocket)
+		return;
+	disconnect(incomingHttpSocket, 0, this, 0);
 	incomingHttpSocket->disconnectFromHost();
 	// Delete incomingHttpSocket when it will be disconnected
-	connect(incomingHttpSocket, SIGNAL(disconnected()), incomingHttpSocket, SLOT(deleteLater()));
+	if(incomingHttpSocket->state() == QAbstractSocket::UnconnectedState)
+		incomingHttpSocket->deleteLater();
+	else
+		connect(incomingHttpSocket, SIGNAL(disconnected()), incomingHttpSocket, SLOT(deleteLater()));
+	incomingHttpSocket = 0;
 	deleteLater();
 }
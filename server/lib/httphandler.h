@@ -1,10 +1,15 @@
 #ifndef _HTTPHANDLER_H_
 #define _HTTPHANDLER_H_
 
+#include <QHash>
 #include <QObject>
 #include <QTcpSocket>
 #include "global.h"
+#include "httpfileserver.h"
 
+class ApiTask;
+class HttpBodyStream;
+class HTTPRequest;
 class PluginManager;
 class ApiManager;
 class VioletApiManager;
@@ -13,7 +18,11 @@ class OJN_EXPORT HttpHandler : public QObject
 	Q_OBJECT
 
 public:
-	HttpHandler(QTcpSocket *, bool, bool);
+	// Wrapper : length-prefixed frames sent by openjabnab.php (v1 : one request per connection, v2 : persistent and multiplexed)
+	// Http : real HTTP/1.1 requests (keep-alive, pipelining, chunked bodies)
+	enum Protocol { Protocol_Wrapper, Protocol_Http };
+
+	HttpHandler(QTcpSocket *, bool, bool, Protocol protocol = Protocol_Wrapper);
 	virtual ~HttpHandler();
 
 public slots:
@@ -21,16 +30,69 @@ public slots:
 
 private slots:
 	void ReceiveData();
+	void ContinueFileTransfer();
+	void ApiCallFinished();
 
 private:
-	void HandleBunnyHTTPRequest();
+	// Where to send the answer of an Api call run by the ApiExecutor
+	struct PendingApiCall
+	{
+		bool v2;
+		quint32 requestId;
+		bool keepAlive;
+		bool headOnly;
+		bool violet;
+	};
+
+	// Returns 0 if the answer will be sent by ApiCallFinished
+	int HandleBunnyHTTPRequest(HTTPRequest &, PendingApiCall const&);
+	bool SubmitApiCall(QString const& call, HTTPRequest const&, PendingApiCall const&);
+
+	// Wrapper protocol
+	void ReceiveWrapperData();
+	void WriteWrapperReply(quint32 requestId, QByteArray const& reply);
+	void WriteWrapperAnswer(bool v2, quint32 requestId, QByteArray const& reply);
+	bool StartWrapperBodyStream(int frameSize, bool v2);
+
+	// Native HTTP/1.1 protocol
+	void ReceiveHttpData();
+	bool ParseHttpRequest();
+	int DecodeChunkedBody(int bodyStart);
+	void ResetHttpRequest();
+	void WriteHttpHeader(int status, QByteArray const& contentType, qint64 contentLength, bool keepAlive, QByteArray const& extraHeaders = QByteArray());
+	void WriteHttpResponse(int status, QByteArray const& contentType, QByteArray const& body, bool keepAlive, bool headOnly = false);
+	void RejectHttpRequest(int status);
+	bool StartHttpBodyStream(QByteArray const& uri, QByteArray const& rawHeaders, int bodyStart, int contentLength, bool keepAlive);
+
+	// Streamed bodies (see PluginManager::HttpStreamHook)
+	bool FeedBodyStream();
+
+	// Static files (see HttpFileServer)
+	bool ServeStaticFile(HTTPRequest const&, QByteArray const& rawHeaders, bool headOnly, bool keepAlive);
+	bool SendFileChunks();
 
 	QTcpSocket * incomingHttpSocket;
 	PluginManager & pluginManager;
 	bool httpApi;
 	bool httpVioletApi;
+	Protocol protocol;
 	QByteArray receivedData;
-	int bytesToReceive;
+	int headerScanPos;
+	bool continueSent;
+	// Chunked body decoded so far, decoding goes on from chunkedPos when more data comes in
+	QByteArray chunkedBody;
+	int chunkedPos;
+	bool chunkedTrailers;
+	bool streamChecked;
+	HttpBodyStream * bodyStream;
+	HTTPRequest * bodyStreamRequest;
+	int bodyStreamRemaining;
+	quint32 bodyStreamId;
+	bool bodyStreamV2;
+	bool bodyStreamKeepAlive;
+	HttpFileServer::Transfer * fileTransfer;
+	bool transferKeepAlive;
+	QHash<ApiTask *, PendingApiCall> pendingApiCalls;
 };
 
 #endif
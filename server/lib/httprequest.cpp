@@ -7,63 +7,211 @@
 #include "httprequest.h"
 #include "log.h"
 
-HTTPRequest::HTTPRequest(QByteArray const& data):type(INVALID)
+// Raw fields are views on the received frame, nothing is copied here
+// data is shared, not copied, as long as nobody modifies it
+HTTPRequest::HTTPRequest(QByteArray const& data, int offset, int size):argsParsed(false),postParsed(false),type(INVALID)
 {
-	if (data.size() < 4 || *(int*)data.left(4).constData() != data.size())
+	if(size == -1)
+		size = data.size() - offset;
+	if (size < 5 || offset + size > data.size() || *(int*)(data.constData() + offset) != size)
 	{
 		LogError("HTTP Request : Invalid data");
 		return;
 	}
-	RequestType t = (RequestType)data.at(4);
-	QByteArray content = data.mid(5);
+	buffer = data;
+	unsigned char typeByte = (unsigned char)buffer.at(offset + 4);
+	RequestType t = (RequestType)(typeByte & ~WrapperV2Flag);
+	int begin = offset + ((typeByte & WrapperV2Flag) ? WrapperV2HeaderSize : 5);
+	int end = offset + size;
+	int headersEnd = buffer.indexOf('\0', begin); // Headers stop at first \x00
+	if(headersEnd == -1 || headersEnd > end)
+		headersEnd = end;
 	switch (t)
 	{
 		case GET:
-			rawHeaders = content.left(content.indexOf('\0')); // Copy headers, stop at first \x00
-			rawUri = content.mid(rawHeaders.length()+1); // Copy URI
+			rawHeaders = View(begin, headersEnd);
+			rawUri = View(headersEnd + 1, end);
 			type = GET;
 			break;
-			
+
 		case POST:
+		case POSTRAW:
 		{
-			rawHeaders = content.left(content.indexOf('\0')); // Copy headers, stop at first \x00
-			content = content.mid(rawHeaders.length()+1);
-			rawUri = content.left(content.indexOf('\0')); // Copy URI
-			rawPostData = content.mid(rawUri.length()+1);
-			// Parse Post Data
-			QList<QByteArray> listOfParams = rawPostData.split('&');
-			foreach(QByteArray param, listOfParams)
-			{
-				QByteArray key = param.left(param.indexOf('='));
-				QByteArray value = param.mid(param.indexOf('=')+1);
-				formPostData[QUrl::fromPercentEncoding(key)] = QUrl::fromPercentEncoding(value);
-			}
-			type = POST;
+			rawHeaders = View(begin, headersEnd);
+			int uriEnd = buffer.indexOf('\0', headersEnd + 1);
+			if(uriEnd == -1 || uriEnd > end)
+				uriEnd = end;
+			rawUri = View(headersEnd + 1, uriEnd);
+			rawPostData = View(uriEnd + 1, end);
+			type = t;
 			break;
 		}
-		
-		case POSTRAW:
-			rawHeaders = content.left(content.indexOf('\0')); // Copy headers, stop at first \x00
-			content = content.mid(rawHeaders.length()+1);
-			rawUri = content.left(content.indexOf('\0')); // Copy URI
-			rawPostData = content.mid(rawUri.length()+1);
-			type = POSTRAW;
-			break;
-	
+
 		default:
 			LogError("HTTP Request : Invalid type");
 			return;
 	}
-	// Parse URI
-	QUrl url(rawUri);
-	uri = url.path();
-	if(url.hasQuery())
+	ParseUri();
+}
+
+// Build a request from an already parsed HTTP/1.1 message (native listener)
+HTTPRequest::HTTPRequest(RequestType t, QByteArray const& headers, QByteArray const& u, QByteArray const& postData):rawUri(u),rawHeaders(headers),rawPostData(postData),argsParsed(false),postParsed(false),type(t)
+{
+	ParseUri();
+}
+
+QByteArray HTTPRequest::View(int from, int to) const
+{
+	if(from >= to)
+		return QByteArray();
+	return QByteArray::fromRawData(buffer.constData() + from, to - from);
+}
+
+// Split path and query without QUrl, arguments are decoded on demand
+void HTTPRequest::ParseUri()
+{
+	char const * raw = rawUri.constData();
+	int size = rawUri.size();
+	int pathBegin = 0;
+	// Absolute URI (request sent through a proxy)
+	if(rawUri.startsWith("http://") || rawUri.startsWith("https://"))
+	{
+		int slash = rawUri.indexOf('/', rawUri.indexOf("://") + 3);
+		pathBegin = (slash == -1) ? size : slash;
+	}
+	int fragment = rawUri.indexOf('#', pathBegin);
+	if(fragment != -1)
+		size = fragment;
+	int query = rawUri.indexOf('?', pathBegin);
+	if(query == -1 || query > size)
+		query = size;
+	else
+		rawQuery = QByteArray::fromRawData(raw + query + 1, size - query - 1);
+	QByteArray path = QByteArray::fromRawData(raw + pathBegin, query - pathBegin);
+	if(path.contains('%'))
+		uri = QUrl::fromPercentEncoding(path);
+	else
+		uri = QString::fromUtf8(path.constData(), path.size());
+}
+
+// Look for key in a "k1=v1&k2=v2" list, only the matching value is decoded
+// Like the hash, the last occurrence of a key wins
+bool HTTPRequest::FindParam(QByteArray const& params, QString const& key, QString * value)
+{
+	if(params.isEmpty())
+		return false;
+	QByteArray rawKey = key.toUtf8();
+	char const * data = params.constData();
+	int size = params.size();
+	int found = -1;
+	int foundEnd = 0;
+	int pos = 0;
+	while(pos <= size)
+	{
+		int next = params.indexOf('&', pos);
+		if(next == -1)
+			next = size;
+		int equal = params.indexOf('=', pos);
+		int keyEnd = (equal == -1 || equal > next) ? next : equal;
+		QByteArray k = QByteArray::fromRawData(data + pos, keyEnd - pos);
+		bool match;
+		if(k.contains('%'))
+			match = (QUrl::fromPercentEncoding(k) == key);
+		else
+			match = (k == rawKey);
+		if(match)
+		{
+			found = (keyEnd == next) ? next : keyEnd + 1;
+			foundEnd = next;
+		}
+		pos = next + 1;
+	}
+	if(found == -1)
+		return false;
+	if(value)
+	{
+		QByteArray v = QByteArray::fromRawData(data + found, foundEnd - found);
+		*value = v.contains('%') ? QUrl::fromPercentEncoding(v) : QString::fromUtf8(v.constData(), v.size());
+	}
+	return true;
+}
+
+void HTTPRequest::ParseParams(QByteArray const& params, QHash<QString, QString> & hash)
+{
+	if(params.isEmpty())
+		return;
+	QList<QByteArray> listOfParams = params.split('&');
+	foreach(QByteArray param, listOfParams)
+	{
+		int equal = param.indexOf('=');
+		if(equal == -1)
+			hash[QUrl::fromPercentEncoding(param)] = QString();
+		else
+			hash[QUrl::fromPercentEncoding(param.left(equal))] = QUrl::fromPercentEncoding(param.mid(equal+1));
+	}
+}
+
+bool HTTPRequest::HasArg(QString const& s) const
+{
+	if(argsParsed)
+		return getData.contains(s);
+	return FindParam(rawQuery, s, 0);
+}
+
+QString HTTPRequest::GetArg(QString const& s) const
+{
+	if(argsParsed)
+		return getData.value(s, QString());
+	QString value;
+	FindParam(rawQuery, s, &value);
+	return value;
+}
+
+void HTTPRequest::RemoveArg(QString const& s)
+{
+	GetArgs();
+	getData.remove(s);
+}
+
+QString HTTPRequest::GetPostArg(QString const& s) const
+{
+	if(type != POST)
+		return QString();
+	if(postParsed)
+		return formPostData.value(s, QString());
+	QString value;
+	FindParam(rawPostData, s, &value);
+	return value;
+}
+
+bool HTTPRequest::HasPostArg(QString const& s) const
+{
+	if(type != POST)
+		return false;
+	if(postParsed)
+		return formPostData.contains(s);
+	return FindParam(rawPostData, s, 0);
+}
+
+QHash<QString, QString> const& HTTPRequest::GetArgs() const
+{
+	if(!argsParsed)
+	{
+		ParseParams(rawQuery, getData);
+		argsParsed = true;
+	}
+	return getData;
+}
+
+QHash<QString, QString> const& HTTPRequest::GetPost() const
+{
+	if(!postParsed)
 	{
-		QList<QPair<QString, QString> > items = url.queryItems();
-		typedef QPair<QString, QString> queryItemDef;
-		foreach(queryItemDef item, items)
-			getData[QUrl::fromPercentEncoding(item.first.toAscii())] = QUrl::fromPercentEncoding(item.second.toAscii());
+		if(type == POST)
+			ParseParams(rawPostData, formPostData);
+		postParsed = true;
 	}
+	return formPostData;
 }
 
 QByteArray HTTPRequest::ForwardTo(QString const& server)
@@ -117,14 +265,16 @@ QString HTTPRequest::toString() const
 	QString s;
 	s.append(QString("<ul><li>URL : %1</li>").arg(QString(uri)));
 	s.append("<li>Get Args : <br /><ul>");
-	foreach (QString str, getData.keys())
-		s.append(QString("<li>%1 => %2</li>").arg(str,getData.value(str)));
+	QHash<QString, QString> const& args = GetArgs();
+	foreach (QString str, args.keys())
+		s.append(QString("<li>%1 => %2</li>").arg(str,args.value(str)));
 	s.append("</ul></li>");
 	if(type == POST)
 	{
 		s.append("<li>Post Args : <br /><ul>");
-		foreach (QString str, formPostData.keys())
-			s.append(QString("<li>%1 => %2</li>").arg(str,formPostData.value(str)));
+		QHash<QString, QString> const& post = GetPost();
+		foreach (QString str, post.keys())
+			s.append(QString("<li>%1 => %2</li>").arg(str,post.value(str)));
 		s.append("</ul></li>");
 	}
 	s.append("</ul>");
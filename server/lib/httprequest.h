@@ -11,10 +11,15 @@ class OJN_EXPORT HTTPRequest
 
 public:
 	enum RequestType { INVALID, GET, POST, POSTRAW };
+	// Set in the type byte of a v2 wrapper frame, a 4-byte request id follows
+	enum { WrapperV2Flag = 0x80, WrapperV2HeaderSize = 9 };
 
-	HTTPRequest(QByteArray const&);
+	// Wrapper frame at 'offset' in data, the whole data if size is -1
+	HTTPRequest(QByteArray const& data, int offset = 0, int size = -1);
+	HTTPRequest(RequestType, QByteArray const& headers, QByteArray const& uri, QByteArray const& postData = QByteArray());
 	QByteArray ForwardTo(QString const& server);
 	QString const& GetURI() const;
+	// Raw accessors may return views on the received frame, deep copy them to keep them after the request
 	QByteArray const& GetRawURI() const;
 	QString GetArg(QString const& s) const;
 	bool HasArg(QString const& s) const;
@@ -32,12 +37,22 @@ public:
 	QByteArray reply;
 
 private:
+	QByteArray View(int from, int to) const;
+	void ParseUri();
+	static bool FindParam(QByteArray const& params, QString const& key, QString * value);
+	static void ParseParams(QByteArray const& params, QHash<QString, QString> & hash);
+
+	QByteArray buffer; // Received frame, raw fields below are views on it
 	QByteArray rawUri;
 	QByteArray rawHeaders;
 	QByteArray rawPostData;
+	QByteArray rawQuery;
 	QString uri;
-	QHash<QString, QString> getData;
-	QHash<QString, QString> formPostData;
+	// Filled on first GetArgs/GetPost/RemoveArg call
+	mutable QHash<QString, QString> getData;
+	mutable QHash<QString, QString> formPostData;
+	mutable bool argsParsed;
+	mutable bool postParsed;
 	RequestType type;
 };
 
@@ -51,22 +66,6 @@ inline QByteArray const& HTTPRequest::GetRawURI() const
 	return rawUri;
 }
 
-inline bool HTTPRequest::HasArg(QString const& s) const 
-{
-	return getData.contains(s);
-}
-
-inline QString HTTPRequest::GetArg(QString const& s) const
-{
-	return getData.value(s, QString());
-}
-
-
-inline void HTTPRequest::RemoveArg(QString const& s)
-{
-	getData.remove(s);
-}
-
 inline QByteArray HTTPRequest::GetPostRaw() const
 {
 	return rawPostData;
@@ -77,26 +76,6 @@ inline bool HTTPRequest::HasPostRaw() const
 	return rawPostData.length() > 0;
 }
 
-inline QString HTTPRequest::GetPostArg(QString const& s) const
-{
-	return formPostData.value(s, QString());
-}
-
-inline bool HTTPRequest::HasPostArg(QString const& s) const
-{
-	return formPostData.contains(s);
-}
-
-inline QHash<QString, QString> const& HTTPRequest::GetArgs() const
-{
-	return getData;
-}
-
-inline QHash<QString, QString> const& HTTPRequest::GetPost() const
-{
-	return formPostData;
-}
-
 inline QByteArray const& HTTPRequest::GetRawPost() const
 {
 	return rawPostData;
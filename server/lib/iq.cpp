@@ -1,19 +1,18 @@
-#include <QRegExp>
-#include <QList>
+#include <cstring>
 #include "iq.h"
 
-IQ::Iq_Types IQ::fromString(QByteArray const& type) const
+IQ::Iq_Types IQ::fromString(char const * type, int length)
 {
-	if(type == "get")
+	if(length == 3 && !memcmp(type, "get", 3))
 		return Iq_Get;
-	if(type == "set")
+	if(length == 3 && !memcmp(type, "set", 3))
 		return Iq_Set;
-	if(type == "result")
+	if(length == 6 && !memcmp(type, "result", 6))
 		return Iq_Result;
 	return Iq_Unknown;
 }
 
-QByteArray IQ::toString(IQ::Iq_Types type) const
+char const * IQ::toString(IQ::Iq_Types type)
 {
 	switch(type)
 	{
@@ -24,67 +23,116 @@ QByteArray IQ::toString(IQ::Iq_Types type) const
 		case Iq_Result:
 			return "result";
 		default:
-			return QByteArray();
+			return "";
 	}
 }
 
-IQ::IQ(QByteArray const& data)
+static bool IsName(char const * name, int length, char const * expected)
+{
+	return (int)strlen(expected) == length && !memcmp(name, expected, length);
+}
+
+IQ::IQ(QByteArray const& stanza):data(stanza),isValid(false),type(Iq_Unknown)
 {
 	// <iq from='...' to='...' type='...' id='...'>...</iq>
-	QRegExp rx("<iq ([^>]*)>(.*)</iq>");
-	if(rx.indexIn(data) != -1)
+	char const * p = data.constData();
+	int size = data.size();
+	int i = data.indexOf("<iq ");
+	if(i == -1)
+		return;
+	i += 4;
+
+	// Attributes
+	forever
 	{
-		isValid = true;
-		content = rx.cap(2).toAscii();
-		// Now split args
-		QList<QByteArray> args = rx.cap(1).toAscii().split(' ');
-		foreach(QByteArray arg, args)
-		{
-			int i = arg.indexOf('=');
-			if (i != -1)
-			{
-				QByteArray key = arg.left(i);
-				QByteArray value = arg.mid(i+2);
-				value.chop(1); // Last '
-				if(key == "type")
-					type = fromString(value);
-				else if (key == "id")
-					id = value;
-				else if (key == "from")
-					from = value;
-				else if (key == "to")
-					to = value;
-				else
-				{
-					isValid = false;
-					break;
-				}
-			}
-		}
+		while(i < size && p[i] == ' ')
+			i++;
+		if(i >= size)
+			return;
+		if(p[i] == '>')
+			break;
+		int nameStart = i;
+		while(i < size && p[i] != '=' && p[i] != ' ' && p[i] != '>')
+			i++;
+		if(i + 1 >= size || p[i] != '=' || (p[i + 1] != '\'' && p[i + 1] != '"'))
+			return;
+		int nameLength = i - nameStart;
+		int valueStart = i + 2;
+		char const * valueEnd = (char const *)memchr(p + valueStart, p[i + 1], size - valueStart);
+		if(!valueEnd)
+			return;
+		Range value(valueStart, valueEnd - p - valueStart);
+		i = valueEnd - p + 1;
+
+		if(IsName(p + nameStart, nameLength, "type"))
+			type = fromString(p + value.start, value.length);
+		else if(IsName(p + nameStart, nameLength, "id"))
+			id = value;
+		else if(IsName(p + nameStart, nameLength, "from"))
+			from = value;
+		else if(IsName(p + nameStart, nameLength, "to"))
+			to = value;
+		else
+			return;
 	}
-	else
-		isValid = false;
+
+	int contentStart = i + 1;
+	int contentEnd = data.lastIndexOf("</iq>");
+	if(contentEnd < contentStart)
+		return;
+	content = Range(contentStart, contentEnd - contentStart);
+	isValid = true;
+}
+
+void IQ::AppendAttribute(QByteArray & buffer, char const * name, Range const& value) const
+{
+	buffer.append(name).append("='").append(data.constData() + value.start, value.length).append('\'');
 }
 
 // %1 = id, %2 = from, %3 = to, %4 = result
-QByteArray IQ::Reply(Iq_Types newType, QByteArray const& format, QByteArray const& content)
+QByteArray IQ::Reply(Iq_Types newType, QByteArray const& format, QByteArray const& replyContent) const
 {
-	// IQ Parameters, from & to are swapped (reply)
-	QString sid = "id='" + id + "'";
-	QString stype = "type='" + toString(newType) + "'";
-	QString sfrom = "from='" + to + "'";
-	QString sto = "to='" + from + "'";
+	QByteArray reply;
+	reply.reserve(format.size() + replyContent.size() + id.length + from.length + to.length + 40);
+	reply.append("<iq ");
 
-	QByteArray reply = QString("<iq ").append(QString(format).replace("%1", sid).replace("%2", sfrom).replace("%3", sto).replace("%4", stype)).toAscii();
+	// IQ Parameters, from & to are swapped (reply)
+	char const * f = format.constData();
+	int size = format.size();
+	int literal = 0;
+	for(int i = 0; i + 1 < size; i++)
+	{
+		if(f[i] != '%' || f[i + 1] < '1' || f[i + 1] > '4')
+			continue;
+		reply.append(f + literal, i - literal);
+		switch(f[i + 1])
+		{
+			case '1':
+				AppendAttribute(reply, "id", id);
+				break;
+			case '2':
+				AppendAttribute(reply, "from", to);
+				break;
+			case '3':
+				AppendAttribute(reply, "to", from);
+				break;
+			default:
+				reply.append("type='").append(toString(newType)).append('\'');
+				break;
+		}
+		i++;
+		literal = i + 1;
+	}
+	reply.append(f + literal, size - literal);
 
-	if(content.isNull())
+	if(replyContent.isNull())
 	{
 		reply.append("/>");
 	}
 	else
 	{
 		reply.append(">");
-		reply.append(content);
+		reply.append(replyContent);
 		reply.append("</iq>");
 	}
 
@@ -4,6 +4,7 @@
 #include <QByteArray>
 #include "global.h"
 
+// Parsed once, the IQ only keeps offsets into the original stanza
 class OJN_EXPORT IQ
 {
 public:
@@ -13,22 +14,31 @@ public:
 
 	bool IsValid() const;
 	IQ::Iq_Types Type() const;
-	QByteArray const& Content() const;
-	QByteArray const& From() const;
+	QByteArray Content() const;
+	QByteArray From() const;
 	// %1 = id, %2 = from, %3 = to, %4 = result
-	QByteArray Reply(Iq_Types type, QByteArray const&, QByteArray const& content);
+	QByteArray Reply(Iq_Types type, QByteArray const&, QByteArray const& content) const;
 	
 protected:
+	struct Range
+	{
+		Range():start(0),length(0) {}
+		Range(int s, int l):start(s),length(l) {}
+		int start;
+		int length;
+	};
 
-	Iq_Types fromString(QByteArray const&) const;
-	QByteArray toString(IQ::Iq_Types type) const;
+	static Iq_Types fromString(char const *, int);
+	static char const * toString(IQ::Iq_Types type);
+	void AppendAttribute(QByteArray &, char const * name, Range const&) const;
 
+	QByteArray data;
 	bool isValid;
-	QByteArray from;
-	QByteArray to;
+	Range from;
+	Range to;
 	Iq_Types type;
-	QByteArray id;
-	QByteArray content;
+	Range id;
+	Range content;
 };
 
 inline bool IQ::IsValid() const
@@ -41,14 +51,14 @@ inline IQ::Iq_Types IQ::Type() const
 	return type;
 }
 
-inline QByteArray const& IQ::Content() const
+inline QByteArray IQ::Content() const
 {
-	return content;
+	return data.mid(content.start, content.length);
 }
 
-inline QByteArray const& IQ::From() const
+inline QByteArray IQ::From() const
 {
-	return from;
+	return data.mid(from.start, from.length);
 }
 
 #endif
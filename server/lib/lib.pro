@@ -22,7 +22,21 @@ unix {
 }
 # Input
 HEADERS +=	httphandler.h \
+			apiexecutor.h \
+			httpbodystream.h \
+			httpfileserver.h \
 			xmpphandler.h \
+			xmppstream.h \
+			xmppconnection.h \
+			xmppreactor.h \
+			sessionstore.h \
+			bunnybroadcast.h \
+			bunnyevictor.h \
+			hotupgrade.h \
+			configjournal.h \
+			configwriter.h \
+			recordstore.h \
+			persistencescheduler.h \
 			httprequest.h \
 			settings.h \
 			log.h \
@@ -49,10 +63,26 @@ HEADERS +=	httphandler.h \
 			account.h \
 			apihandler.h \
 			netdump.h \
-			iq.h
+			responsecache.h \
+			uritrie.h \
+			iq.h \
+			limitedtcpserver.h
 
 SOURCES +=	httphandler.cpp \
+			apiexecutor.cpp \
+			httpfileserver.cpp \
 			xmpphandler.cpp \
+			xmppstream.cpp \
+			xmppconnection.cpp \
+			xmppreactor.cpp \
+			sessionstore.cpp \
+			bunnybroadcast.cpp \
+			bunnyevictor.cpp \
+			hotupgrade.cpp \
+			configjournal.cpp \
+			configwriter.cpp \
+			recordstore.cpp \
+			persistencescheduler.cpp \
 			httprequest.cpp \
 			settings.cpp \
 			log.cpp \
@@ -72,4 +102,6 @@ SOURCES +=	httphandler.cpp \
 			accountmanager.cpp \
 			account.cpp \
 			netdump.cpp \
-			iq.cpp
+			responsecache.cpp \
+			iq.cpp \
+			limitedtcpserver.cpp
@@ -0,0 +1,77 @@
+#include <QTcpSocket>
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#else
+#include <unistd.h>
+#endif
+#include "limitedtcpserver.h"
+#include "log.h"
+
+LimitedTcpServer::LimitedTcpServer(QString const& n, int max, int rate, int burst, QObject * parent):QTcpServer(parent),name(n),handoff(false),maxConnections(max),connections(0),acceptRate(rate),acceptBurst(qMax(burst, 1)),tokens(qMax(burst, 1)),lastRefill(0),rejected(0),lastRejectLog(0)
+{
+	clock.start();
+	LogInfo(QString("%1 listener : max connections %2, accept rate %3/s (burst %4)").arg(name, max ? QString::number(max) : "unlimited", rate ? QString::number(rate) : "unlimited", QString::number(acceptBurst)));
+}
+
+void LimitedTcpServer::incomingConnection(int socketDescriptor)
+{
+	if((maxConnections && connections >= maxConnections) || !TakeToken())
+	{
+#ifdef Q_OS_WIN
+		::closesocket(socketDescriptor);
+#else
+		::close(socketDescriptor);
+#endif
+		rejected++;
+		// Don't flood the log during a reconnection storm
+		qint64 now = clock.elapsed();
+		if(now - lastRejectLog >= 1000)
+		{
+			LogWarning(QString("%1 listener : %2 connection(s) rejected (%3 open)").arg(name).arg(rejected).arg(connections));
+			rejected = 0;
+			lastRejectLog = now;
+		}
+		return;
+	}
+
+	if(handoff)
+	{
+		connections++;
+		emit NewDescriptor(socketDescriptor);
+		return;
+	}
+
+	QTcpSocket * socket = new QTcpSocket(this);
+	if(!socket->setSocketDescriptor(socketDescriptor))
+	{
+		delete socket;
+		return;
+	}
+	connections++;
+	// The socket is deleted by its handler when the connection is over
+	Track(socket);
+	addPendingConnection(socket);
+}
+
+void LimitedTcpServer::Track(QObject * o)
+{
+	connect(o, SIGNAL(destroyed()), this, SLOT(ConnectionClosed()));
+}
+
+void LimitedTcpServer::ConnectionClosed()
+{
+	connections--;
+}
+
+bool LimitedTcpServer::TakeToken()
+{
+	if(!acceptRate)
+		return true;
+	qint64 now = clock.elapsed();
+	tokens = qMin((double)acceptBurst, tokens + (now - lastRefill) * acceptRate / 1000.0);
+	lastRefill = now;
+	if(tokens < 1)
+		return false;
+	tokens -= 1;
+	return true;
+}
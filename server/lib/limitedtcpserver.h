@@ -0,0 +1,63 @@
+#ifndef _LIMITEDTCPSERVER_H_
+#define _LIMITEDTCPSERVER_H_
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QTcpServer>
+#include "global.h"
+
+// QTcpServer with admission control
+// Over the limits, the descriptor is closed right after accept() : no QTcpSocket nor handler is created
+class OJN_EXPORT LimitedTcpServer : public QTcpServer
+{
+	Q_OBJECT
+
+public:
+	// maxConnections : concurrent connections, acceptRate : new connections per second, 0 means no limit
+	LimitedTcpServer(QString const& name, int maxConnections, int acceptRate, int acceptBurst, QObject * parent = 0);
+
+	int GetConnectionCount() const;
+	// Accepted descriptors are sent by NewDescriptor() instead of being wrapped in QTcpSockets
+	// (the socket has to be created by the thread which will use it)
+	void SetDescriptorHandoff(bool);
+	// The connection is counted until the object is destroyed
+	void Track(QObject *);
+
+signals:
+	void NewDescriptor(int);
+
+protected:
+	void incomingConnection(int socketDescriptor);
+
+private slots:
+	void ConnectionClosed();
+
+private:
+	bool TakeToken();
+
+	QString name;
+	bool handoff;
+	int maxConnections;
+	int connections;
+	// Token bucket
+	int acceptRate;
+	int acceptBurst;
+	double tokens;
+	QElapsedTimer clock;
+	qint64 lastRefill;
+	// Rejections since the last log
+	int rejected;
+	qint64 lastRejectLog;
+};
+
+inline int LimitedTcpServer::GetConnectionCount() const
+{
+	return connections;
+}
+
+inline void LimitedTcpServer::SetDescriptorHandoff(bool h)
+{
+	handoff = h;
+}
+
+#endif
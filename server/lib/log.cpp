@@ -4,6 +4,8 @@
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
 #include <iostream>
 #include "log.h"
 #include "settings.h"
@@ -38,6 +40,9 @@ void Log::LogToFile(QString const& data, LogLevel level)
 void Log::LogToFile(QString const& data, LogLevel level, bool rotate)
 {	
 	static Log instance;
+	// Api calls may log from worker threads
+	static QMutex lock;
+	QMutexLocker locker(&lock);
 
 	if(rotate)
 	{
@@ -2,6 +2,8 @@
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
 #include <iostream>
 #include "log.h"
 #include "netdump.h"
@@ -33,6 +35,8 @@ void NetworkDump::Close()
 
 void NetworkDump::Log(QString const& what, QString const& txt)
 {
+	static QMutex lock;
+	QMutexLocker locker(&lock);
 	Instance().dumpStream << QDateTime::currentDateTime().toString("dd/MM/yyyy hh:mm:ss") << " - " << what << " - " << txt << endl;
 }
 
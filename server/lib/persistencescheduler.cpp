@@ -0,0 +1,92 @@
+#include "log.h"
+#include "persistencescheduler.h"
+#include "settings.h"
+
+PersistenceScheduler * PersistenceScheduler::instance = 0;
+
+PersistenceScheduler::PersistenceScheduler(int slots, int b):wheel(slots),current(0),budget(b)
+{
+	connect(&timer, SIGNAL(timeout()), this, SLOT(Tick()));
+	timer.start(1000);
+}
+
+void PersistenceScheduler::Init()
+{
+	int slots = qMax(2, GlobalSettings::GetInt("Config/FlushInterval", 300));
+	int budget = qMax(1, GlobalSettings::GetInt("Config/FlushBudget", 100));
+	instance = new PersistenceScheduler(slots, budget);
+	LogInfo(QString("Configs are saved every %1s, at most %2 per second").arg(slots).arg(budget));
+}
+
+void PersistenceScheduler::Close()
+{
+	if(!instance)
+		return;
+	QList<Persistent *> pending = instance->TakeAll();
+	delete instance;
+	instance = 0;
+	foreach(Persistent * p, pending)
+		p->SaveConfig();
+}
+
+void PersistenceScheduler::Schedule(Persistent * p)
+{
+	if(!instance)
+		return;
+	QMutexLocker locker(&instance->lock);
+	if(instance->slotOf.contains(p))
+		return;
+	int size = instance->wheel.size();
+	int slot = (instance->current + 1 + qHash(p) % size) % size;
+	instance->wheel[slot].append(p);
+	instance->slotOf.insert(p, slot);
+}
+
+void PersistenceScheduler::Unschedule(Persistent * p)
+{
+	if(!instance)
+		return;
+	QMutexLocker locker(&instance->lock);
+	QHash<Persistent *, int>::iterator it = instance->slotOf.find(p);
+	if(it == instance->slotOf.end())
+		return;
+	instance->wheel[it.value()].removeOne(p);
+	instance->slotOf.erase(it);
+}
+
+void PersistenceScheduler::Tick()
+{
+	QList<Persistent *> due;
+	{
+		QMutexLocker locker(&lock);
+		current = (current + 1) % wheel.size();
+		QList<Persistent *> & slot = wheel[current];
+		due = slot.mid(0, budget);
+		foreach(Persistent * p, due)
+			slotOf.remove(p);
+
+		// Over budget, saved first at the next tick
+		if(slot.size() > budget)
+		{
+			int next = (current + 1) % wheel.size();
+			QList<Persistent *> overflow = slot.mid(budget);
+			foreach(Persistent * p, overflow)
+				slotOf[p] = next;
+			wheel[next] = overflow + wheel[next];
+		}
+		slot.clear();
+	}
+	// Saved without the lock, objects are scheduled again by other threads meanwhile
+	foreach(Persistent * p, due)
+		p->SaveConfig();
+}
+
+QList<Persistent *> PersistenceScheduler::TakeAll()
+{
+	QMutexLocker locker(&lock);
+	QList<Persistent *> all = slotOf.keys();
+	for(int i = 0; i < wheel.size(); i++)
+		wheel[i].clear();
+	slotOf.clear();
+	return all;
+}
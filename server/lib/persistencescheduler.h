@@ -0,0 +1,54 @@
+#ifndef _PERSISTENCESCHEDULER_H_
+#define _PERSISTENCESCHEDULER_H_
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include "global.h"
+
+// Object whose config is saved by the PersistenceScheduler
+class OJN_EXPORT Persistent
+{
+public:
+	virtual ~Persistent() {}
+	// Writes the pending changes, called on the main thread
+	virtual void SaveConfig() = 0;
+};
+
+// One timer for the saves of every bunny and ztamp
+// Dirty objects are put on a timing wheel of Config/FlushInterval one second slots, spread by address
+// so that objects changed together aren't saved together. At most Config/FlushBudget objects are saved
+// per tick, the others wait for the next one
+class OJN_EXPORT PersistenceScheduler : public QObject
+{
+	Q_OBJECT
+
+public:
+	static void Init();
+	// Saves everything still pending
+	static void Close();
+
+	// Thread safe, does nothing if the object is already scheduled
+	static void Schedule(Persistent *);
+	static void Unschedule(Persistent *);
+
+private slots:
+	void Tick();
+
+private:
+	PersistenceScheduler(int slots, int budget);
+	QList<Persistent *> TakeAll();
+
+	static PersistenceScheduler * instance;
+	QMutex lock;
+	QVector<QList<Persistent *> > wheel;
+	QHash<Persistent *, int> slotOf;
+	int current;
+	int budget;
+	QTimer timer;
+};
+
+#endif
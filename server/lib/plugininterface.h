@@ -3,7 +3,10 @@
 
 #include <QByteArray>
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDir>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QSettings>
 #include <QString>
 #include <QtPlugin>
@@ -11,6 +14,7 @@
 #include "bunnymanager.h"
 #include "ztampmanager.h"
 #include "log.h"
+#include "persistencescheduler.h"
 #include "pluginapihandler.h"
 #include "settings.h"
 
@@ -18,10 +22,11 @@ class Account;
 class AmbientPacket;
 class Bunny;
 class HTTPRequest;
+class HttpBodyStream;
 class Packet;
 class SleepPacket;
 
-class PluginInterface : public QObject, public PluginApiHandler
+class PluginInterface : public QObject, public PluginApiHandler, public Persistent
 {
 	friend class PluginManager;
 public:
@@ -34,16 +39,24 @@ public:
 	// Called to init plugin, return false if something is wrong
 	virtual bool Init() { return true; };
 
+	// Http calls are only made for the URI prefixes registered with PluginManager::RegisterHttpRoute
 	virtual void HttpRequestBefore(HTTPRequest &) {}
 	// If the plugin returns true, the plugin should handle the request
 	virtual bool HttpRequestHandle(HTTPRequest &) { return false; }
 	virtual void HttpRequestAfter(HTTPRequest &) { }
+	// Called before the body is received (HttpStreamHook)
+	// Return 0 to let the request be buffered and sent to HttpRequestHandle as usual
+	virtual HttpBodyStream * HttpRequestStream(HTTPRequest &) { return 0; }
 	
 	// Raw XMPP Messages
 	virtual void XmppBunnyMessage(Bunny *, QByteArray const&) {}
+	// Keep-alive pings are only sent to XmppBunnyMessage if this returns true
+	virtual bool WantsXmppPings() const { return false; }
 
 	// Bunny's Messages
 	virtual void OnInitPacket(const Bunny *, AmbientPacket &, SleepPacket &) {}
+	// The init packet is cached : time at which the plugin's part of it changes without a setting change
+	virtual QDateTime GetInitPacketExpiry(const Bunny *) { return QDateTime(); }
 	virtual bool OnClick(Bunny *, ClickType) { return false; }
 	virtual bool OnEarsMove(Bunny *, int, int) { return false; }
 	virtual bool OnRFID(Bunny *, QByteArray const&) { return false; }
@@ -59,10 +72,15 @@ public:
 	// Bunny connect/disconnect
 	virtual void OnBunnyConnect(Bunny *) {}
 	virtual void OnBunnyDisconnect(Bunny *) {}
+	// Called before the Bunny object is deleted (idle eviction, deleted bunny) : pointers to it must be dropped
+	// The bunnies list may be locked, BunnyManager must not be called
+	virtual void OnBunnyEvicted(Bunny *) {}
 	
 	// Settings
 	QVariant GetSettings(QString const& key, QVariant const& defaultValue = QVariant()) const;
+	// The settings file is synced later by the PersistenceScheduler, changes made together are written once
 	void SetSettings(QString const& key, QVariant const& value);
+	void SaveConfig();
 
 	// Plugin's name
 	QString const& GetName() const;
@@ -74,6 +92,10 @@ public:
 	// Plugin type
 	int GetType() const;
 
+	// Return true if the plugin's api calls can be run by the Api worker threads
+	// Calls for the same bunny are still serialized
+	virtual bool IsApiThreadSafe() const { return false; }
+
 protected:
 	void SetEnable(bool);
 	QDir * GetLocalHTTPFolder() const;
@@ -82,6 +104,7 @@ protected:
 	QSettings * settings;
 
 private:
+	mutable QMutex settingsLock;
 	QString pluginName;
 	PluginType pluginType;
 	QString pluginVisualName;
@@ -17,18 +17,28 @@ inline PluginInterface::PluginInterface(QString name, QString visualName, Plugin
 
 inline PluginInterface::~PluginInterface()
 {
+	PersistenceScheduler::Unschedule(this);
+	// Synced by the QSettings destructor
 	delete settings;
 }
 
 // Settings
 inline QVariant PluginInterface::GetSettings(QString const& key, QVariant const& defaultValue) const
 {
+	QMutexLocker locker(&settingsLock);
 	return settings->value(key, defaultValue);
 }
 
 inline void PluginInterface::SetSettings(QString const& key, QVariant const& value)
 {
+	QMutexLocker locker(&settingsLock);
 	settings->setValue(key, value);
+	PersistenceScheduler::Schedule(this);
+}
+
+inline void PluginInterface::SaveConfig()
+{
+	QMutexLocker locker(&settingsLock);
 	settings->sync();
 }
 
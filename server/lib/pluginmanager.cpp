@@ -8,6 +8,7 @@
 #include "httprequest.h"
 #include "log.h"
 #include "pluginmanager.h"
+#include "responsecache.h"
 #include <iostream>
 
 PluginManager::PluginManager()
@@ -25,6 +26,10 @@ PluginManager & PluginManager::Instance()
 
 void PluginManager::UnloadPlugins()
 {
+	httpHandleRoutes.Clear();
+	httpBeforeRoutes.Clear();
+	httpAfterRoutes.Clear();
+	httpStreamRoutes.Clear();
 	foreach(PluginInterface * p, listOfPlugins)
 		delete p;
 
@@ -78,6 +83,7 @@ bool PluginManager::LoadPlugin(QString const& fileName)
 	{
 		if(plugin->Init() == false)
 		{
+			UnregisterHttpRoutes(plugin);
 			delete plugin;
 			loader->unload();
 			delete loader;
@@ -99,6 +105,7 @@ bool PluginManager::LoadPlugin(QString const& fileName)
 
 		// Init Api Calls
 		plugin->InitApiCalls();
+		ResponseCache::Instance().ServerStatsChanged();
 
 		status.append(QString("%1 OK, Enable : %2").arg(plugin->GetName(),plugin->GetEnable() ? "Yes" : "No"));
 		LogInfo(status);
@@ -126,7 +133,9 @@ bool PluginManager::UnloadPlugin(QString const& name)
 		listOfPluginsByName.remove(name);
 		listOfPlugins.removeAll(p);
 		listOfSystemPlugins.removeAll(p);
+		UnregisterHttpRoutes(p);
 		delete p;
+		ResponseCache::Instance().ServerStatsChanged();
 		loader->unload();
 		delete loader;
 		LogInfo(QString("Plugin %1 unloaded.").arg(name));
@@ -152,17 +161,19 @@ bool PluginManager::ReloadPlugin(QString const& name)
 /**************************************************/
 void PluginManager::HttpRequestBefore(HTTPRequest & request)
 {
-	// Call RequestBefore for all plugins
-	foreach(PluginInterface * plugin, listOfPlugins)
+	// Call RequestBefore for all plugins registered on this uri
+	foreach(PluginInterface * plugin, httpBeforeRoutes.Match(request.GetURI()))
 		if(plugin->GetEnable())
 			plugin->HttpRequestBefore(request);
 }
 
 bool PluginManager::HttpRequestHandle(HTTPRequest & request)
 {
-	// Call GetAnswer for all plugins until one returns true
-	foreach(PluginInterface * plugin, listOfPlugins)
+	// Call GetAnswer for matching plugins, longest prefix first, until one returns true
+	QList<PluginInterface *> plugins = httpHandleRoutes.Match(request.GetURI());
+	for(int i = plugins.count() - 1; i >= 0; i--)
 	{
+		PluginInterface * plugin = plugins.at(i);
 		if(plugin->GetEnable() && plugin->HttpRequestHandle(request))
 			return true;
 	}
@@ -171,12 +182,48 @@ bool PluginManager::HttpRequestHandle(HTTPRequest & request)
 
 void PluginManager::HttpRequestAfter(HTTPRequest & request)
 {
-	// Call RequestAfter for all plugins
-	foreach(PluginInterface * plugin, listOfPlugins)
+	// Call RequestAfter for all plugins registered on this uri
+	foreach(PluginInterface * plugin, httpAfterRoutes.Match(request.GetURI()))
 		if(plugin->GetEnable())
 			plugin->HttpRequestAfter(request);
 }
 
+HttpBodyStream * PluginManager::HttpRequestStream(HTTPRequest & request)
+{
+	QList<PluginInterface *> plugins = httpStreamRoutes.Match(request.GetURI());
+	for(int i = plugins.count() - 1; i >= 0; i--)
+	{
+		PluginInterface * plugin = plugins.at(i);
+		if(plugin->GetEnable())
+		{
+			HttpBodyStream * s = plugin->HttpRequestStream(request);
+			if(s)
+				return s;
+		}
+	}
+	return 0;
+}
+
+void PluginManager::RegisterHttpRoute(QString const& prefix, PluginInterface * p, int hooks)
+{
+	if(hooks & HttpHandleHook)
+		httpHandleRoutes.Insert(prefix, p);
+	if(hooks & HttpBeforeHook)
+		httpBeforeRoutes.Insert(prefix, p);
+	if(hooks & HttpAfterHook)
+		httpAfterRoutes.Insert(prefix, p);
+	if(hooks & HttpStreamHook)
+		httpStreamRoutes.Insert(prefix, p);
+}
+
+void PluginManager::UnregisterHttpRoutes(PluginInterface * p)
+{
+	httpHandleRoutes.RemoveAll(p);
+	httpBeforeRoutes.RemoveAll(p);
+	httpAfterRoutes.RemoveAll(p);
+	httpStreamRoutes.RemoveAll(p);
+}
+
 /*****************************************************/
 /* Others requests are sent only to "system" plugins */
 /*****************************************************/
@@ -188,6 +235,13 @@ void PluginManager::XmppBunnyMessage(Bunny * b, QByteArray const& data)
 			plugin->XmppBunnyMessage(b, data);
 }
 
+void PluginManager::XmppBunnyPing(Bunny * b, QByteArray const& data)
+{
+	foreach(PluginInterface * plugin, listOfSystemPlugins)
+		if(plugin->GetEnable() && plugin->WantsXmppPings())
+			plugin->XmppBunnyMessage(b, data);
+}
+
 // Bunny OnClick
 bool PluginManager::OnClick(Bunny * b, PluginInterface::ClickType type)
 {
@@ -261,6 +315,13 @@ void PluginManager::OnBunnyDisconnect(Bunny * b)
 			plugin->OnBunnyDisconnect(b);
 }
 
+// Bunny object deleted, every plugin may keep pointers to it
+void PluginManager::OnBunnyEvicted(Bunny * b)
+{
+	foreach(PluginInterface * plugin, listOfPlugins)
+		plugin->OnBunnyEvicted(b);
+}
+
 // Ztamp Connect
 void PluginManager::OnZtampConnect(Ztamp * b)
 {
@@ -452,6 +513,7 @@ API_CALL(PluginManager::Api_ActivatePlugin)
 		return new ApiManager::ApiError(QString("Plugin '%1' is already enabled!").arg(hRequest.GetArg("name")));
 
 	p->SetEnable(true);
+	ResponseCache::Instance().ServerStatsChanged();
 	return new ApiManager::ApiOk(QString("'%1' is now enabled").arg(p->GetName()));
 }
 
@@ -473,6 +535,7 @@ API_CALL(PluginManager::Api_DeactivatePlugin)
 		return new ApiManager::ApiError(QString("Plugin '%1' is already disabled!").arg(hRequest.GetArg("name")));
 
 	p->SetEnable(false);
+	ResponseCache::Instance().ServerStatsChanged();
 	return new ApiManager::ApiOk(QString("'%1' is now disabled").arg(p->GetName()));
 }
 
@@ -7,6 +7,7 @@
 #include "plugininterface.h"
 #include "apihandler.h"
 #include "apimanager.h"
+#include "uritrie.h"
 
 class Account;
 class PluginInterface;
@@ -22,12 +23,19 @@ public:
 	int GetEnabledPluginCount();
 	int GetPluginCount();
 
-	// HttpRequests are sent to all 'active' plugins
+	// HttpRequests are sent to the 'active' plugins registered on a prefix of the URI
 	void HttpRequestBefore(HTTPRequest &);
 	bool HttpRequestHandle(HTTPRequest &);
 	void HttpRequestAfter(HTTPRequest &);
+	HttpBodyStream * HttpRequestStream(HTTPRequest &);
+
+	// Plugins register the URI prefixes they want to receive, and for which calls
+	enum HttpHook { HttpHandleHook = 1, HttpBeforeHook = 2, HttpAfterHook = 4, HttpStreamHook = 8 };
+	void RegisterHttpRoute(QString const& prefix, PluginInterface *, int hooks = HttpHandleHook);
+	void UnregisterHttpRoutes(PluginInterface *);
 
 	void XmppBunnyMessage(Bunny *, QByteArray const&);
+	void XmppBunnyPing(Bunny *, QByteArray const&);
 
 	bool OnClick(Bunny *, PluginInterface::ClickType);
 	bool OnEarsMove(Bunny *, int, int);
@@ -36,6 +44,7 @@ public:
 
 	void OnBunnyConnect(Bunny *);
 	void OnBunnyDisconnect(Bunny *);
+	void OnBunnyEvicted(Bunny *);
 
 	void OnZtampConnect(Ztamp *);
 	void OnZtampDisconnect(Ztamp *);
@@ -66,6 +75,10 @@ private:
 	QMap<PluginInterface *, QPluginLoader *> listOfPluginsLoader;
 	QHash<QString, PluginInterface *> listOfPluginsByName;
 	QHash<QString, PluginInterface *> listOfPluginsByFileName;
+	UriTrie<PluginInterface *> httpHandleRoutes;
+	UriTrie<PluginInterface *> httpBeforeRoutes;
+	UriTrie<PluginInterface *> httpAfterRoutes;
+	UriTrie<PluginInterface *> httpStreamRoutes;
 
 	PluginAuthInterface * authPlugin;
 
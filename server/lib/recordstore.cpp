@@ -0,0 +1,198 @@
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QStringList>
+#include "configwriter.h"
+#include "log.h"
+#include "recordstore.h"
+#include "settings.h"
+
+#define RECORDSTORE_MAGIC 0x4F4A4E53 // "OJNS"
+#define RECORDSTORE_VERSION 1
+
+RecordStore::RecordStore():data(0),dataSize(0),created(0) {}
+
+RecordStore::~RecordStore()
+{
+	Close();
+}
+
+bool RecordStore::IsEnabled()
+{
+	return GlobalSettings::Get("Config/UseRecordStore", false).toBool();
+}
+
+QString RecordStore::FileName(QDir const& dir)
+{
+	return dir.absolutePath() + ".store";
+}
+
+bool RecordStore::Open(QString const& fileName)
+{
+	Close();
+	file.setFileName(fileName);
+	if(!file.open(QIODevice::ReadOnly))
+		return false;
+
+	qint64 size = file.size();
+	char const * mapped;
+#ifdef Q_OS_WIN
+	// A mapped file can't be removed
+	content = file.readAll();
+	file.close();
+	mapped = content.constData();
+#else
+	mapped = (char const *)file.map(0, size);
+#endif
+	// Written again at the next clean stop, a crash doesn't leave an old store behind
+	QFile::remove(fileName);
+	if(!mapped)
+	{
+		LogError(QString("Cannot map record store : %1").arg(fileName));
+		Close();
+		return false;
+	}
+
+	QByteArray raw = QByteArray::fromRawData(mapped, size);
+	QDataStream in(raw);
+	in.setVersion(QDataStream::Qt_4_3);
+	quint32 magic, version, count;
+	in >> magic >> version >> created >> count;
+	if(in.status() != QDataStream::Ok || magic != RECORDSTORE_MAGIC || version != RECORDSTORE_VERSION)
+	{
+		LogWarning(QString("Bad record store : %1").arg(fileName));
+		Close();
+		return false;
+	}
+
+	index.reserve(count);
+	for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+	{
+		QByteArray key;
+		Entry e;
+		in >> key >> e.offset >> e.snapshotLength >> e.journalLength;
+		index.insert(key, e);
+	}
+	qint64 start = in.device()->pos();
+	if(in.status() != QDataStream::Ok)
+	{
+		LogWarning(QString("Bad record store index : %1").arg(fileName));
+		Close();
+		return false;
+	}
+	data = mapped + start;
+	dataSize = size - start;
+
+	foreach(Entry e, index)
+	{
+		if(e.offset + e.snapshotLength + e.journalLength > (quint64)dataSize)
+		{
+			LogWarning(QString("Truncated record store : %1").arg(fileName));
+			Close();
+			return false;
+		}
+	}
+	LogInfo(QString("%1 record(s) in %2").arg(index.size()).arg(fileName));
+	return true;
+}
+
+void RecordStore::Close()
+{
+	index.clear();
+	data = 0;
+	dataSize = 0;
+	content.clear();
+	// Unmaps the file
+	file.close();
+}
+
+QByteArray RecordStore::GetSnapshot(QByteArray const& key) const
+{
+	QHash<QByteArray, Entry>::const_iterator it = index.find(key);
+	if(it == index.end())
+		return QByteArray();
+	return QByteArray::fromRawData(data + it->offset, it->snapshotLength);
+}
+
+QByteArray RecordStore::GetJournal(QByteArray const& key) const
+{
+	QHash<QByteArray, Entry>::const_iterator it = index.find(key);
+	if(it == index.end() || !it->journalLength)
+		return QByteArray();
+	return QByteArray::fromRawData(data + it->offset + it->snapshotLength, it->journalLength);
+}
+
+bool RecordStore::Import(QDir const& dir, QString const& fileName, RecordStore const * previous)
+{
+	// The files must be complete
+	ConfigWriter::Sync();
+	QStringList filters;
+	filters << "*.dat" << "*.dat.journal";
+	QFileInfoList files = dir.entryInfoList(filters, QDir::Files);
+
+	// "<key>.dat" => size of "<key>.dat.journal"
+	QHash<QString, qint64> journals;
+	foreach(QFileInfo f, files)
+	{
+		if(f.fileName().endsWith(".journal"))
+			journals.insert(f.completeBaseName(), f.size());
+	}
+
+	QByteArray indexData;
+	QDataStream indexOut(&indexData, QIODevice::WriteOnly);
+	indexOut.setVersion(QDataStream::Qt_4_3);
+	QByteArray records;
+	quint32 count = 0;
+	uint now = QDateTime::currentDateTime().toTime_t();
+	foreach(QFileInfo f, files)
+	{
+		QString name = f.fileName();
+		if(!name.endsWith(".dat"))
+			continue;
+		QByteArray key = name.left(name.size() - 4).toUtf8();
+		qint64 journalSize = journals.value(name, 0);
+
+		QByteArray snapshot;
+		QByteArray journal;
+		QHash<QByteArray, Entry>::const_iterator it;
+		// The journal is append only, and a new snapshot is always more recent than the store
+		if(previous && previous->IsOpen() && f.lastModified().toTime_t() < previous->created
+			&& (it = previous->index.find(key)) != previous->index.end()
+			&& it->snapshotLength == f.size() && it->journalLength == journalSize)
+		{
+			snapshot = previous->GetSnapshot(key);
+			journal = previous->GetJournal(key);
+		}
+		else
+		{
+			QFile in(f.absoluteFilePath());
+			if(!in.open(QIODevice::ReadOnly))
+			{
+				LogError(QString("Cannot open config file for reading : %1").arg(f.absoluteFilePath()));
+				continue;
+			}
+			snapshot = in.readAll();
+			if(journalSize)
+			{
+				QFile j(f.absoluteFilePath() + ".journal");
+				if(j.open(QIODevice::ReadOnly))
+					journal = j.readAll();
+			}
+		}
+		indexOut << key << (quint64)records.size() << (quint32)snapshot.size() << (quint32)journal.size();
+		records.append(snapshot);
+		records.append(journal);
+		count++;
+	}
+
+	QByteArray store;
+	QDataStream out(&store, QIODevice::WriteOnly);
+	out.setVersion(QDataStream::Qt_4_3);
+	out << (quint32)RECORDSTORE_MAGIC << (quint32)RECORDSTORE_VERSION << now << count;
+	store.append(indexData);
+	store.append(records);
+	if(!ConfigWriter::WriteFile(fileName, store))
+		return false;
+	LogInfo(QString("%1 record(s) written to %2").arg(count).arg(fileName));
+	return true;
+}
@@ -0,0 +1,72 @@
+#ifndef _RECORDSTORE_H_
+#define _RECORDSTORE_H_
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include "global.h"
+
+// The config files of a directory ("*.dat" and their journals) in one memory mapped file with an index,
+// so that the server starts without opening every file (Config/UseRecordStore)
+// The store is written when the server stops and removed as soon as it is opened : after a crash
+// the config files are read again
+// Writing it costs the files changed since the start, at the stop instead of the next start
+class OJN_EXPORT RecordStore
+{
+public:
+	RecordStore();
+	~RecordStore();
+
+	static bool IsEnabled();
+	// "bunnies/" => "bunnies.store"
+	static QString FileName(QDir const&);
+
+	bool Open(QString const& fileName);
+	void Close();
+	bool IsOpen() const;
+
+	// File names without ".dat"
+	QList<QByteArray> Keys() const;
+	bool Contains(QByteArray const& key) const;
+	// Point into the mapped file, valid until Close()
+	QByteArray GetSnapshot(QByteArray const& key) const;
+	QByteArray GetJournal(QByteArray const& key) const;
+
+	// Builds the store of a directory, the records unchanged since 'previous' was written are copied from it
+	static bool Import(QDir const& dir, QString const& fileName, RecordStore const * previous = 0);
+
+private:
+	struct Entry
+	{
+		quint64 offset; // From the end of the index
+		quint32 snapshotLength;
+		quint32 journalLength; // Journal follows the snapshot
+	};
+
+	QFile file;
+	QByteArray content; // Read instead of mapped on Windows
+	char const * data;
+	qint64 dataSize;
+	uint created;
+	QHash<QByteArray, Entry> index;
+};
+
+inline bool RecordStore::IsOpen() const
+{
+	return data != 0;
+}
+
+inline QList<QByteArray> RecordStore::Keys() const
+{
+	return index.keys();
+}
+
+inline bool RecordStore::Contains(QByteArray const& key) const
+{
+	return index.contains(key);
+}
+
+#endif
@@ -0,0 +1,47 @@
+#include <QMutexLocker>
+#include "responsecache.h"
+
+QString const ResponseCache::StatsKey("global/stats");
+QString const ResponseCache::PingKey("global/ping");
+
+ResponseCache & ResponseCache::Instance()
+{
+	static ResponseCache c;
+	return c;
+}
+
+bool ResponseCache::Get(QString const& key, QByteArray & value) const
+{
+	QMutexLocker locker(&lock);
+	QHash<QString, QByteArray>::const_iterator it = entries.find(key);
+	if(it == entries.end())
+		return false;
+	value = it.value(); // Implicitly shared, no copy
+	return true;
+}
+
+void ResponseCache::Insert(QString const& key, QByteArray const& value)
+{
+	QMutexLocker locker(&lock);
+	entries.insert(key, value);
+}
+
+void ResponseCache::Remove(QString const& key)
+{
+	QMutexLocker locker(&lock);
+	entries.remove(key);
+}
+
+void ResponseCache::RemoveBunny(QByteArray const& bunnyID)
+{
+	QString prefix = BunnyKey(bunnyID, QString());
+	QMutexLocker locker(&lock);
+	QHash<QString, QByteArray>::iterator it = entries.begin();
+	while(it != entries.end())
+	{
+		if(it.key().startsWith(prefix))
+			it = entries.erase(it);
+		else
+			++it;
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef _RESPONSECACHE_H_
+#define _RESPONSECACHE_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include "global.h"
+
+// Answers of hot idempotent requests (locate.jsp, global/stats ...)
+// A handler opts in by using a key, and must invalidate it when its inputs change
+class OJN_EXPORT ResponseCache
+{
+public:
+	static ResponseCache & Instance();
+
+	bool Get(QString const& key, QByteArray & value) const;
+	void Insert(QString const& key, QByteArray const& value);
+	void Remove(QString const& key);
+
+	// Keys owned by a bunny, removed with RemoveBunny when the bunny is deleted
+	static QString BunnyKey(QByteArray const& bunnyID, QString const& name);
+	void RemoveBunny(QByteArray const& bunnyID);
+
+	// Bunny/ztamp/plugin counters used by global/ping and global/stats
+	static QString const StatsKey;
+	static QString const PingKey;
+	void ServerStatsChanged();
+
+private:
+	ResponseCache() {}
+	mutable QMutex lock;
+	QHash<QString, QByteArray> entries;
+};
+
+inline QString ResponseCache::BunnyKey(QByteArray const& bunnyID, QString const& name)
+{
+	return QString("bunny/%1/%2").arg(QString(bunnyID), name);
+}
+
+inline void ResponseCache::ServerStatsChanged()
+{
+	QMutexLocker locker(&lock);
+	entries.remove(StatsKey);
+	entries.remove(PingKey);
+}
+
+#endif
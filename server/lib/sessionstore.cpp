@@ -0,0 +1,190 @@
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QStringList>
+#include "bunny.h"
+#include "bunnymanager.h"
+#include "configwriter.h"
+#include "log.h"
+#include "pluginmanager.h"
+#include "sessionstore.h"
+#include "settings.h"
+
+#define SESSIONS_FILE_VERSION 2
+
+SessionStore::SessionStore():lifetime(0),expectedCount(0) {}
+
+SessionStore & SessionStore::Instance()
+{
+	static SessionStore s;
+	return s;
+}
+
+void SessionStore::Init()
+{
+	SessionStore & s = Instance();
+	s.lifetime = GlobalSettings::GetInt("Config/SessionTicketLifetime", 600);
+	s.fileName = QDir(QCoreApplication::applicationDirPath()).absoluteFilePath("sessions.dat");
+	s.sinceStart.start();
+	if(s.lifetime)
+		s.Load();
+}
+
+void SessionStore::Close()
+{
+	SessionStore & s = Instance();
+	if(!s.expected.isEmpty())
+		LogInfo(QString("%1/%2 bunnies of the last stop did not connect again").arg(s.expected.size()).arg(s.expectedCount));
+	if(s.lifetime)
+		s.Save();
+	// Called again by ~OpenJabNab, nothing is issued or saved anymore
+	QMutexLocker locker(&s.lock);
+	s.lifetime = 0;
+	s.tickets.clear();
+	s.initPackets.clear();
+	s.expected.clear();
+}
+
+void SessionStore::Issue(QByteArray const& bunnyID, QString const& address)
+{
+	QMutexLocker locker(&lock);
+	if(!lifetime)
+		return;
+	Ticket t;
+	t.address = address;
+	t.validUntil = 0;
+	tickets.insert(bunnyID, t);
+	Returned(bunnyID);
+}
+
+bool SessionStore::IsValid(QByteArray const& bunnyID, QString const& address)
+{
+	QMutexLocker locker(&lock);
+	QHash<QByteArray, Ticket>::const_iterator it = tickets.find(bunnyID);
+	if(it == tickets.end() || it->address != address)
+		return false;
+	return it->validUntil && QDateTime::currentDateTime().toTime_t() <= it->validUntil;
+}
+
+void SessionStore::Revoke(QByteArray const& bunnyID)
+{
+	QMutexLocker locker(&lock);
+	tickets.remove(bunnyID);
+	initPackets.remove(bunnyID);
+	// Not waited for anymore, and not counted as connected again
+	if(!expected.remove(bunnyID))
+		return;
+	expectedCount--;
+	if(expected.isEmpty() && expectedCount)
+		LogInfo(QString("All %1 bunnies of the last stop connected again, %2 ms after the start").arg(expectedCount).arg(sinceStart.elapsed()));
+}
+
+// lock is held
+void SessionStore::Returned(QByteArray const& bunnyID)
+{
+	if(!expected.remove(bunnyID) || !expected.isEmpty())
+		return;
+	LogInfo(QString("All %1 bunnies of the last stop connected again, %2 ms after the start").arg(expectedCount).arg(sinceStart.elapsed()));
+}
+
+bool SessionStore::TakeInitPacket(QByteArray const& bunnyID, QByteArray & initPacket, QDateTime & expiry)
+{
+	QMutexLocker locker(&lock);
+	QHash<QByteArray, InitPacket>::iterator it = initPackets.find(bunnyID);
+	if(it == initPackets.end())
+		return false;
+	initPacket = it->data;
+	expiry = it->expiry ? QDateTime::fromTime_t(it->expiry) : QDateTime();
+	initPackets.erase(it);
+	return true;
+}
+
+void SessionStore::DropInitPackets()
+{
+	QMutexLocker locker(&lock);
+	initPackets.clear();
+}
+
+// The saved init packets were built by these plugins
+QByteArray SessionStore::PluginsFingerprint()
+{
+	QStringList plugins;
+	foreach(PluginInterface * p, PluginManager::Instance().GetListOfPlugins())
+		plugins.append(QString("%1=%2").arg(p->GetName()).arg(p->GetEnable()));
+	plugins.sort();
+	return plugins.join(",").toUtf8();
+}
+
+void SessionStore::Load()
+{
+	QFile file(fileName);
+	if(!file.open(QIODevice::ReadOnly))
+		return;
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_4_3);
+	quint32 version;
+	QByteArray fingerprint;
+	in >> version >> fingerprint;
+	if(in.status() != QDataStream::Ok || version != SESSIONS_FILE_VERSION)
+		LogWarning("Unknown session tickets file, ignored");
+	else
+	{
+		bool samePlugins = (fingerprint == PluginsFingerprint());
+		uint now = QDateTime::currentDateTime().toTime_t();
+		QMutexLocker locker(&lock);
+		while(!in.atEnd())
+		{
+			QByteArray id;
+			Ticket t;
+			uint stopped;
+			InitPacket p;
+			in >> id >> t.address >> stopped >> p.data >> p.expiry;
+			if(in.status() != QDataStream::Ok)
+			{
+				LogWarning("Problem when loading session tickets");
+				break;
+			}
+			if(now - stopped > lifetime)
+				continue;
+			t.validUntil = stopped + lifetime;
+			tickets.insert(id, t);
+			if(samePlugins && (!p.expiry || now < p.expiry))
+				initPackets.insert(id, p);
+		}
+		expected = QSet<QByteArray>::fromList(tickets.keys());
+		expectedCount = expected.size();
+		LogInfo(QString("%1 session ticket(s) loaded, %2 init packet(s)").arg(expectedCount).arg(initPackets.size()));
+	}
+	file.close();
+	// Written again at the next clean stop, a crash doesn't leave old tickets behind
+	file.remove();
+}
+
+// Only the bunnies still connected are saved, stamped with the stop time
+// Written by the ConfigWriter thread, flushed by ConfigWriter::Close
+void SessionStore::Save()
+{
+	QHash<QByteArray, Ticket> current;
+	{
+		QMutexLocker locker(&lock);
+		current = tickets;
+	}
+	QByteArray data;
+	QDataStream out(&data, QIODevice::WriteOnly);
+	out.setVersion(QDataStream::Qt_4_3);
+	out << (quint32)SESSIONS_FILE_VERSION << PluginsFingerprint();
+	uint now = QDateTime::currentDateTime().toTime_t();
+	foreach(QByteArray id, BunnyManager::GetConnectedBunniesList())
+	{
+		QHash<QByteArray, Ticket>::const_iterator it = current.find(id);
+		Bunny * b = BunnyManager::GetConnectedBunny(id);
+		if(it == current.end() || !b)
+			continue;
+		QDateTime expiry;
+		QByteArray initPacket = b->GetInitPacket(&expiry);
+		out << id << it->address << now << initPacket << (uint)(expiry.isNull() ? 0 : expiry.toTime_t());
+	}
+	ConfigWriter::Write(fileName, data);
+}
@@ -0,0 +1,66 @@
+#ifndef _SESSIONSTORE_H_
+#define _SESSIONSTORE_H_
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include "global.h"
+
+// Session tickets : the bunnies connected when the server stops, saved with their address, their init packet
+// and the stop time, and loaded when it starts if it is less than Config/SessionTicketLifetime seconds old
+// A bunny reconnecting from the same address gets its success without the rspauth round trip,
+// and its cached init packet (see Bunny::GetInitPacket) while no setting or plugin changed
+// The time until all of them are connected again is logged
+class OJN_EXPORT SessionStore
+{
+public:
+	static SessionStore & Instance();
+	static void Init();
+	// Saves the tickets, while the bunnies are still connected (see OpenJabNab::Close)
+	static void Close();
+
+	// Called when a bunny finished its boot
+	void Issue(QByteArray const& bunnyID, QString const& address);
+	// True for a ticket loaded at the start, from the same address
+	bool IsValid(QByteArray const& bunnyID, QString const& address);
+	void Revoke(QByteArray const& bunnyID);
+
+	// Init packet saved with the ticket, given once to the Bunny when it is loaded
+	bool TakeInitPacket(QByteArray const& bunnyID, QByteArray & initPacket, QDateTime & expiry);
+	// A plugin changed, the saved init packets are outdated
+	void DropInitPackets();
+
+private:
+	struct Ticket
+	{
+		QString address;
+		uint validUntil; // 0 for the tickets issued since the start
+	};
+	struct InitPacket
+	{
+		QByteArray data;
+		uint expiry; // 0 if it doesn't expire
+	};
+
+	SessionStore();
+	void Load();
+	void Save();
+	void Returned(QByteArray const& bunnyID);
+	static QByteArray PluginsFingerprint();
+
+	QMutex lock;
+	QString fileName;
+	uint lifetime;
+	QHash<QByteArray, Ticket> tickets;
+	QHash<QByteArray, InitPacket> initPackets;
+	// Restart measurement : bunnies of the tickets loaded, not connected again yet, revoked ones aren't counted
+	QSet<QByteArray> expected;
+	int expectedCount;
+	QElapsedTimer sinceStart;
+};
+
+#endif
@@ -7,7 +7,9 @@
 #include <QSettings>
 #include <QString>
 #include <QMap>
+#include <QTemporaryFile>
 #include <QtPlugin>
+#include <cstdio>
 #include "log.h"
 #include "settings.h"
 
@@ -45,6 +47,9 @@ public:
 
 protected:
 	void SetEnable(bool);
+	// Sounds are written to a temporary file then renamed : the same sound may be
+	// created by several threads, and is served while it is created
+	static bool WriteSoundFile(QString const& filePath, QByteArray const& data);
 	QMap<QString, QString> voiceList;
 	QDir ttsFolder;
 	QString ttsHTTPUrl;
@@ -85,6 +85,31 @@ inline void TTSInterface::SetEnable(bool newStatus)
 	}
 }
 
+inline bool TTSInterface::WriteSoundFile(QString const& filePath, QByteArray const& data)
+{
+	if(data.isEmpty())
+	{
+		LogError(QString("Empty sound for %1").arg(filePath));
+		return false;
+	}
+	QTemporaryFile file(filePath + ".XXXXXX");
+	if(!file.open() || file.write(data) != data.size() || !file.flush())
+	{
+		LogError(QString("Cannot write sound file %1").arg(filePath));
+		return false;
+	}
+	// Temporary files are only readable by their owner, sounds are served by the web server
+	file.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
+	// rename() replaces an existing sound atomically
+	if(::rename(QFile::encodeName(file.fileName()).constData(), QFile::encodeName(filePath).constData()) != 0)
+	{
+		LogError(QString("Cannot rename sound file to %1").arg(filePath));
+		return false;
+	}
+	file.setAutoRemove(false);
+	return true;
+}
+
 inline QList<QString> TTSInterface::getVoiceList(void) {
 	return voiceList;
 }
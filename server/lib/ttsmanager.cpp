@@ -7,6 +7,7 @@
 #include <QObject>
 #include <QPluginLoader>
 #include <QStringList>
+#include <QThreadPool>
 #include <QUrl>
 #include "log.h"
 #include "settings.h"
@@ -16,6 +17,8 @@
 TTSManager::TTSManager()
 {
 	ttsDir = QCoreApplication::applicationDirPath();
+	ttsPool = new QThreadPool();
+	ttsPool->setMaxThreadCount(GlobalSettings::GetInt("Config/TTSThreads", 2));
 
 	if (!ttsDir.cd("tts"))
 	{
@@ -33,6 +36,9 @@ TTSManager & TTSManager::Instance()
 
 void TTSManager::UnloadTTSs()
 {
+	// Pending sounds use the TTSs
+	ttsPool->waitForDone();
+
 	foreach(TTSInterface * p, listOfTTSs)
 		delete p;
 
@@ -99,6 +105,8 @@ bool TTSManager::UnloadTTS(QString const& name)
 {
 	if(listOfTTSsByName.contains(name))
 	{
+		// Pending sounds may use this TTS
+		ttsPool->waitForDone();
 		TTSInterface * p = listOfTTSsByName.value(name);
 		QString fileName = listOfTTSsFileName.value(p);
 		QPluginLoader * loader = listOfTTSsLoader.value(p);
@@ -141,6 +149,30 @@ QByteArray TTSManager::CreateNewSound(QString text, QString voice, bool forceOve
 	return tts->CreateNewSound(text, voice, forceOverwrite);
 }
 
+TTSReply * TTSManager::CreateNewSoundAsync(QString const& text, QString const& voice, QObject * receiver, char const * slot, QByteArray const& userData)
+{
+	TTSInterface * tts = Instance().GetTTSByName(GlobalSettings::Get("Config/TTS", "acapela").toString());
+	TTSReply * reply = new TTSReply(tts, text, voice, false, userData);
+	// May be called by an Api worker thread, which has no event loop for deleteLater
+	reply->moveToThread(QCoreApplication::instance()->thread());
+	QObject::connect(reply, SIGNAL(Finished()), receiver, slot, Qt::QueuedConnection);
+	Instance().ttsPool->start(reply);
+	return reply;
+}
+
+TTSReply::TTSReply(TTSInterface * t, QString const& tx, QString const& v, bool o, QByteArray const& u):tts(t),text(tx),voice(v),overwrite(o),userData(u)
+{
+	setAutoDelete(false);
+}
+
+void TTSReply::run()
+{
+	if(tts)
+		fileName = tts->CreateNewSound(text, voice, overwrite);
+	emit Finished();
+	deleteLater();
+}
+
 QList<QString> TTSManager::GetTTSVoices(void) {
 	return Instance().GetTTSByName(GlobalSettings::Get("Config/TTS", "acapela").toString())->getVoiceList();
 }
@@ -4,12 +4,41 @@
 #include <QHash>
 #include <QMap>
 #include <QList>
+#include <QObject>
+#include <QRunnable>
 #include "global.h"
 #include "ttsinterface.h"
 #include "apihandler.h"
 
 class TTSInterface;
 class QPluginLoader;
+class QThreadPool;
+
+// Sound created by a TTS thread, Finished() is received in the caller's thread
+class OJN_EXPORT TTSReply : public QObject, public QRunnable
+{
+	Q_OBJECT
+	friend class TTSManager;
+public:
+	void run();
+	// Empty if the sound couldn't be created
+	QByteArray const& GetFileName() const;
+	QByteArray const& GetUserData() const;
+
+signals:
+	// The reply is deleted once this signal is processed
+	void Finished();
+
+private:
+	TTSReply(TTSInterface *, QString const& text, QString const& voice, bool overwrite, QByteArray const& userData);
+	TTSInterface * tts;
+	QString text;
+	QString voice;
+	bool overwrite;
+	QByteArray userData;
+	QByteArray fileName;
+};
+
 class OJN_EXPORT TTSManager: public ApiHandler<TTSManager>
 {
 public:
@@ -18,6 +47,9 @@ public:
 	static void Close();
 	static QByteArray CreateNewSound(QString, QString, bool overwrite = false);
 	static QByteArray CreateNewSound(QString, QString, QString, bool overwrite = false);
+	// Same as CreateNewSound without blocking the event loop : the remote fetch is done by a TTS thread
+	// 'slot' is called when the sound is ready, sender() is the TTSReply
+	static TTSReply * CreateNewSoundAsync(QString const& text, QString const& voice, QObject * receiver, char const * slot, QByteArray const& userData = QByteArray());
 	TTSInterface * GetTTSByName(QString const& name) const;
 	static QList<QString> GetTTSVoices(QString const&name);
 	static QList<QString> GetTTSVoices(void);
@@ -42,6 +74,7 @@ private:
         QMap<TTSInterface *, QPluginLoader *> listOfTTSsLoader;
         QHash<QString, TTSInterface *> listOfTTSsByName;
         QHash<QString, TTSInterface *> listOfTTSsByFileName;
+	QThreadPool * ttsPool;
 
 	API_CALL(Api_getVoiceList);
 
@@ -57,6 +90,16 @@ inline void TTSManager::Close()
         Instance().UnloadTTSs();
 }
 
+inline QByteArray const& TTSReply::GetFileName() const
+{
+	return fileName;
+}
+
+inline QByteArray const& TTSReply::GetUserData() const
+{
+	return userData;
+}
+
 inline TTSInterface * TTSManager::GetTTSByName(QString const& name) const
 {
 	if(listOfTTSsByName.contains(name))
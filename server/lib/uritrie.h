@@ -0,0 +1,108 @@
+#ifndef _URITRIE_H_
+#define _URITRIE_H_
+
+#include <QChar>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include "global.h"
+
+// Prefix tree mapping URI prefixes to values, one character per level
+template <class T>
+class UriTrie
+{
+public:
+	UriTrie() {}
+	~UriTrie() { Clear(); }
+
+	void Insert(QString const& prefix, T const& value)
+	{
+		Node * node = &root;
+		foreach(QChar c, prefix)
+		{
+			Node * child = node->children.value(c);
+			if(!child)
+			{
+				child = new Node;
+				node->children.insert(c, child);
+			}
+			node = child;
+		}
+		if(!node->values.contains(value))
+			node->values.append(value);
+	}
+
+	void RemoveAll(T const& value)
+	{
+		RemoveAll(&root, value);
+	}
+
+	// Values registered on all prefixes of uri, shortest prefix first
+	QList<T> Match(QString const& uri) const
+	{
+		QList<T> result;
+		Node const * node = &root;
+		result += node->values;
+		for(int i = 0; i < uri.size() && !node->children.isEmpty(); i++)
+		{
+			node = node->children.value(uri.at(i));
+			if(!node)
+				break;
+			result += node->values;
+		}
+		return result;
+	}
+
+	bool IsEmpty() const
+	{
+		return root.children.isEmpty() && root.values.isEmpty();
+	}
+
+	void Clear()
+	{
+		Clear(&root);
+		root.values.clear();
+	}
+
+private:
+	struct Node
+	{
+		QHash<QChar, Node *> children;
+		QList<T> values;
+	};
+
+	// Returns true if the node is now useless
+	static bool RemoveAll(Node * node, T const& value)
+	{
+		node->values.removeAll(value);
+		typename QHash<QChar, Node *>::iterator it = node->children.begin();
+		while(it != node->children.end())
+		{
+			if(RemoveAll(it.value(), value))
+			{
+				delete it.value();
+				it = node->children.erase(it);
+			}
+			else
+				++it;
+		}
+		return node->values.isEmpty() && node->children.isEmpty();
+	}
+
+	static void Clear(Node * node)
+	{
+		foreach(Node * child, node->children)
+		{
+			Clear(child);
+			delete child;
+		}
+		node->children.clear();
+	}
+
+	UriTrie(UriTrie const&);
+	UriTrie & operator=(UriTrie const&);
+
+	Node root;
+};
+
+#endif
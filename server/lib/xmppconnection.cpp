@@ -0,0 +1,127 @@
+#include <QTcpSocket>
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "log.h"
+#include "settings.h"
+#include "xmppconnection.h"
+
+// Stanzas bigger than this are never sent by a bunny
+static int const maxStanzaSize = 64 * 1024;
+
+XmppConnection::XmppConnection(int d, QByteArray const& pending):socketDescriptor(d),socket(0),closed(false)
+{
+	parser.Append(pending);
+	maxPendingOutput = GlobalSettings::GetInt("Config/XmppMaxPendingOutput", 262144);
+}
+
+void XmppConnection::Start()
+{
+	if(closed)
+		return;
+	socket = new QTcpSocket(this);
+	if(!socket->setSocketDescriptor(socketDescriptor))
+	{
+#ifdef Q_OS_WIN
+		::closesocket(socketDescriptor);
+#else
+		::close(socketDescriptor);
+#endif
+		Abort("Unable to use the xmpp socket");
+		return;
+	}
+	connect(socket, SIGNAL(disconnected()), this, SLOT(SocketDisconnected()));
+	connect(socket, SIGNAL(readyRead()), this, SLOT(ReadData()));
+	emit Opened(socket->peerAddress().toString());
+	if(socket->bytesAvailable() || parser.PendingSize())
+		ReadData();
+}
+
+void XmppConnection::ReadData()
+{
+	if(closed)
+		return;
+	parser.Append(socket->readAll());
+
+	QList<XmppStanza> stanzas;
+	XmppStanza stanza;
+	while(parser.Next(stanza))
+		stanzas.append(stanza);
+	// Stanzas read before the error are still handled
+	if(!stanzas.isEmpty())
+		emit Received(stanzas);
+	if(closed)
+		return;
+	if(parser.HasError() || parser.PendingSize() > maxStanzaSize)
+		Abort("Malformed xmpp stream, disconnect");
+}
+
+void XmppConnection::Write(QByteArray const& data)
+{
+	if(closed || !socket)
+		return;
+	// The bunny doesn't read fast enough, don't buffer without limit
+	if(socket->bytesToWrite() + data.size() > maxPendingOutput)
+	{
+		Abort("Too much pending output for bunny, disconnect");
+		return;
+	}
+	socket->write(data);
+	socket->flush();
+}
+
+void XmppConnection::SocketDisconnected()
+{
+	if(!closed)
+		emit Disconnected();
+}
+
+void XmppConnection::Abort(QString const& reason)
+{
+	LogError(reason);
+	if(socket)
+	{
+		socket->disconnect(this);
+		socket->abort();
+	}
+	emit Disconnected();
+}
+
+void XmppConnection::Pause()
+{
+	if(socket)
+		disconnect(socket, SIGNAL(readyRead()), this, SLOT(ReadData()));
+}
+
+int XmppConnection::Detach(QByteArray * pending)
+{
+#ifndef Q_OS_WIN
+	if(closed || !socket)
+		return -1;
+	while(socket->bytesToWrite() && socket->waitForBytesWritten(1000))
+		;
+	*pending = parser.Pending() + socket->readAll();
+	int d = ::dup(socket->socketDescriptor());
+	if(d != -1)
+		::fcntl(d, F_SETFD, FD_CLOEXEC);
+	// The connection stays open through the duplicate
+	closed = true;
+	socket->disconnect(this);
+	socket->abort();
+	return d;
+#else
+	Q_UNUSED(pending);
+	return -1;
+#endif
+}
+
+void XmppConnection::Close()
+{
+	closed = true;
+	if(socket)
+		socket->abort();
+	deleteLater();
+}
@@ -0,0 +1,56 @@
+#ifndef _XMPPCONNECTION_H_
+#define _XMPPCONNECTION_H_
+
+#include <QByteArray>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include "global.h"
+#include "xmppstream.h"
+
+class QTcpSocket;
+// Socket side of a bunny's XMPP session : reads and frames the stream, writes the answers
+// It lives in an XmppReactor thread (or the main thread), with its XmppHandler
+class OJN_EXPORT XmppConnection : public QObject
+{
+	Q_OBJECT
+
+public:
+	// pending : bytes already received (see HotUpgrade)
+	XmppConnection(int socketDescriptor, QByteArray const& pending = QByteArray());
+
+public slots:
+	// The socket is created by the connection's thread
+	void Start();
+	void Write(QByteArray const&);
+	// Aborts the connection and deletes it, no signal is sent afterwards
+	void Close();
+	// Hot upgrade : stops handling the incoming data, which is kept by the socket
+	void Pause();
+	// Hot upgrade : returns a duplicate of the descriptor (-1 on error) and closes the socket
+	int Detach(QByteArray * pending);
+
+signals:
+	void Opened(QString const& peerAddress);
+	void Received(QList<XmppStanza> const&);
+	void Disconnected();
+
+private slots:
+	void ReadData();
+	void SocketDisconnected();
+
+private:
+	void Abort(QString const& reason);
+
+	int socketDescriptor;
+	QTcpSocket * socket;
+	XmppStreamParser parser;
+	int maxPendingOutput;
+	bool closed;
+};
+
+Q_DECLARE_METATYPE(XmppStanza)
+Q_DECLARE_METATYPE(QList<XmppStanza>)
+
+#endif
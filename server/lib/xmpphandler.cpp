@@ -1,5 +1,6 @@
+#include <QCoreApplication>
 #include <QDateTime>
-#include <QRegExp>
+#include <QThread>
 #include "bunny.h"
 #include "bunnymanager.h"
 #include "iq.h"
@@ -7,203 +8,376 @@
 #include "messagepacket.h"
 #include "netdump.h"
 #include "openjabnab.h"
+#include "sessionstore.h"
 #include "settings.h"
 #include "ttsmanager.h"
+#include "xmppconnection.h"
 #include "xmpphandler.h"
 
 unsigned short XmppHandler::msgNb = 0;
 unsigned short XmppHandler::msgStreamNb = 0;
 
-XmppHandler::XmppHandler(QTcpSocket * s):pluginManager(PluginManager::Instance())
+XmppHandler::XmppHandler(XmppConnection * c):pluginManager(PluginManager::Instance())
 {
-	incomingXmppSocket = s;
+	connection = c;
 	bunny = 0;
+	authenticated = false;
+	ready = false;
 	currentAuthStep = 0;
+	outQueueSize = 0;
+	lastIPRecorded = false;
+	lastSeen.start();
+	flushScheduled = false;
+	flushThreshold = GlobalSettings::GetInt("Config/XmppFlushThreshold", 8192);
 
-	// Bunny -> OpenJabNab socket
-	incomingXmppSocket->setParent(this);
-	connect(incomingXmppSocket, SIGNAL(disconnected()), this, SLOT(Disconnect()));
-	connect(incomingXmppSocket, SIGNAL(readyRead()), this, SLOT(HandleBunnyXmppMessage()));
+	// Bunny -> OpenJabNab, direct calls once the handler is moved to the connection's thread
+	connect(connection, SIGNAL(Opened(QString const&)), this, SLOT(SetPeerAddress(QString const&)));
+	connect(connection, SIGNAL(Received(QList<XmppStanza> const&)), this, SLOT(HandleStanzas(QList<XmppStanza> const&)));
+	connect(connection, SIGNAL(Disconnected()), this, SLOT(Disconnect()));
 
 	OjnXmppDomain = GlobalSettings::GetString("OpenJabNabServers/XmppServer").toAscii();
 }
 
 void XmppHandler::Disconnect()
 {
-	incomingXmppSocket->abort();
+	// From the Bunny or at the stop
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "Disconnect", Qt::QueuedConnection);
+		return;
+	}
+	if(connection)
+	{
+		QMetaObject::invokeMethod(connection, "Close");
+		connection = 0;
+	}
 	if(bunny)
 	{
 		bunny->RemoveXmppHandler(this);
 		bunny = 0;
 	}
 
+	// Deleted by the main thread, which tracks the handlers
+	moveToThread(QCoreApplication::instance()->thread());
 	deleteLater();
 }
 
-void XmppHandler::HandleBunnyXmppMessage()
+void XmppHandler::Pause()
 {
-	QByteArray data = incomingXmppSocket->readAll();
-	bool handled = false;
-	if(data != " ") {
-		if(bunny)
-			NetworkDump::Log(QString("XMPP Bunny (%1)").arg(QString(bunny->GetID())), data);
-		else
-			NetworkDump::Log("XMPP Bunny", data);
+	if(QThread::currentThread() != thread())
+	{
+		QMetaObject::invokeMethod(this, "Pause", Qt::BlockingQueuedConnection);
+		return;
+	}
+	if(connection)
+		QMetaObject::invokeMethod(connection, "Pause");
+}
+
+bool XmppHandler::Detach(HotUpgrade::Session * session)
+{
+	// After the stanzas and writes already queued to this thread
+	if(QThread::currentThread() != thread())
+	{
+		bool detached = false;
+		QMetaObject::invokeMethod(this, "Detach", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, detached), Q_ARG(HotUpgrade::Session *, session));
+		return detached;
+	}
+	// Sessions still authenticating are dropped, the bunnies will reconnect
+	if(!connection || !bunny || !authenticated)
+		return false;
+	// Queued before the detach, so written first
+	FlushToBunny();
+	int descriptor = -1;
+	QMetaObject::invokeMethod(connection, "Detach", Q_RETURN_ARG(int, descriptor), Q_ARG(QByteArray *, &session->pending));
+	if(descriptor == -1)
+		return false;
+	session->descriptor = descriptor;
+	session->bunnyID = bunny->GetID();
+	session->resource = bunny->GetXmppResource();
+	session->ready = ready;
+	return true;
+}
+
+void XmppHandler::Resume(QByteArray const& bunnyID, QByteArray const& resource, bool ready)
+{
+	bunny = BunnyManager::GetBunny(bunnyID);
+	if(!bunny)
+		return;
+	authenticated = true;
+	this->ready = ready;
+	bunny->Authenticating();
+	bunny->Authenticated();
+	bunny->SetXmppHandler(this);
+	SetXmppResource(resource);
+	if(ready)
+		bunny->Ready();
+}
+
+void XmppHandler::SetPeerAddress(QString const& address)
+{
+	peerAddress = address;
+	// Session handed over without a new boot (Resume), the ticket needs the address
+	if(bunny && ready)
+		SessionStore::Instance().Issue(bunny->GetID(), peerAddress);
+}
+
+void XmppHandler::HandleStanzas(QList<XmppStanza> const& stanzas)
+{
+	if(!connection)
+		return;
+	lastSeen.start();
+	foreach(XmppStanza const& stanza, stanzas)
+	{
+		// Disconnected by a handler or a plugin, the rest of the batch is dropped
+		if(!connection)
+			return;
+		if(!HandleStanza(stanza))
+			return;
+	}
+
+	// Once per session
+	if(!lastIPRecorded && bunny && authenticated)
+	{
+		bunny->SetGlobalSetting("LastIP", peerAddress);
+		lastIPRecorded = true;
 	}
+}
+
+bool XmppHandler::HandleStanza(XmppStanza const& stanza)
+{
+	// Keep-alive : no dump, no dispatch, only the plugins which asked for it
+	if(stanza.type == XmppStanza::Ping)
+	{
+		if(bunny && authenticated)
+		{
+			bunny->XmppBunnyPing(stanza.data);
+			OnPing(stanza);
+		}
+		return true;
+	}
+
+	if(bunny)
+		NetworkDump::Log(QString("XMPP Bunny (%1)").arg(QString(bunny->GetID())), stanza.data);
+	else
+		NetworkDump::Log("XMPP Bunny", stanza.data);
 
 	// If we don't know which bunny is connected, try to authenticate it
-	if (!bunny || !bunny->IsAuthenticated())
+	if (!bunny || !authenticated)
 	{
 		QByteArray ret;
 		// Authentication error, disconnect
-		if(pluginManager.GetAuthPlugin()->DoAuth(this, data, &bunny, ret) == false)
+		if(pluginManager.GetAuthPlugin()->DoAuth(this, stanza.data, &bunny, ret) == false)
 		{
 			Disconnect();
-			return;
+			return false;
 		}
 		// Answer to bunny if needed
 		if(!ret.isNull())
 		{
 			WriteToBunnyAndLog(ret);
-			return;
+			return true;
 		}
 	}
 
 	// No bunny yet
 	if(!bunny)
 	{	
-		LogError(QString("Unable to handle xmpp message : %1").arg(QString(data)));
-		return;
+		LogError(QString("Unable to handle xmpp message : %1").arg(QString(stanza.data)));
+		return true;
 	}
 
 	// Send raw xml info to all 'system' plugins and bunny's plugins
-	bunny->XmppBunnyMessage(data);
-	bunny->SetGlobalSetting("LastIP", incomingXmppSocket->peerAddress().toString());
+	bunny->XmppBunnyMessage(stanza.data);
 
-	// Parse Bunny messages
-	// Check if the data contains <message></message>
-	QRegExp rx("<message[^>]*>(.*)</message>");
-	if (rx.indexIn(data) != -1)
+	bool handled = false;
+	if(stanza.type == XmppStanza::StreamEnd)
+		handled = true; // The bunny will close the socket
+	else
 	{
-		QString message = rx.cap(1);
-		if (message.startsWith("<button"))
-		{
-			// Single Click : <button xmlns="violet:nabaztag:button"><clic>1</clic></button>
-			// Double Click : <button xmlns="violet:nabaztag:button"><clic>2</clic></button>
-			QRegExp rx("<clic>([0-9]+)</clic>");
-			if (rx.indexIn(message) != -1)
-			{
-				int value = rx.cap(1).toInt();
-				if (value == 1)
-					handled = bunny->OnClick(PluginInterface::SingleClick);
-				else if (value == 2)
-					handled = bunny->OnClick(PluginInterface::DoubleClick);
-				else
-					LogWarning(QString("Unable to parse button/click message : %1").arg(QString(data)));
-			}
-			else
-				LogWarning(QString("Unable to parse button message : %1").arg(QString(data)));
-		}
-		else if (message.startsWith("<ears"))
-		{
-			// <ears xmlns="violet:nabaztag:ears"><left>0</left><right>0</right></ears>
-			QRegExp rx("<left>([0-9]+)</left><right>([0-9]+)</right>");
-			if (rx.indexIn(message) != -1)
-				handled = bunny->OnEarsMove(rx.cap(1).toInt(), rx.cap(2).toInt());
-			else
-				LogWarning(QString("Unable to parse ears message : %1").arg(QString(data)));
-		}
-		else
-			LogWarning(QString("Unknown message from bunny : %1").arg(QString(data)));
+		// Most specific key first : name/child#xmlns, name/child, name
+		QHash<QByteArray, StanzaHandler> const& handlers = Handlers();
+		QByteArray key = stanza.name + "/" + stanza.child;
+		StanzaHandler handler = handlers.value(key + "#" + stanza.childXmlns);
+		if(!handler)
+			handler = handlers.value(key);
+		if(!handler)
+			handler = handlers.value(stanza.name);
+		if(handler)
+			handled = (this->*handler)(stanza);
 	}
-	else if (rx.setPattern("<iq.*/iq>"), rx.indexIn(data) != -1)
+
+	// If the message wasn't handled
+	if (!handled)
 	{
-		IQ iq(data);
-		if(iq.IsValid())
-		{
-			if(rx.setPattern("<bind[^>]*><resource>([^<]*)</resource></bind>"), rx.indexIn(iq.Content()) != -1)
-			{
-				QByteArray resource = rx.cap(1).toAscii();
-				bunny->SetXmppResource(resource);
-
-				QByteArray from = bunny->GetID()+"@"+OjnXmppDomain+"/"+resource;
-				WriteToBunnyAndLog(iq.Reply(IQ::Iq_Result, "%1 %4", "<bind xmlns='urn:ietf:params:xml:ns:xmpp-bind'><jid>"+from+"</jid></bind>"));
-				handled = true;
-			}
-			else if(iq.Content() == "<session xmlns='urn:ietf:params:xml:ns:xmpp-session'/>")
-			{
-				WriteToBunnyAndLog(iq.Reply(IQ::Iq_Result, "%4 %3 %2 %1", "<session xmlns='urn:ietf:params:xml:ns:xmpp-session'/>"));
-				handled = true;
-			}
-			else if(iq.Content() == "<query xmlns=\"violet:iq:sources\"><packet xmlns=\"violet:packet\" format=\"1.0\"/></query>")
-			{
-				QByteArray status = bunny->GetInitPacket();
-				WriteToBunnyAndLog(iq.Reply(IQ::Iq_Result, "%2 %3 %1 %4", "<query xmlns='violet:iq:sources'><packet xmlns='violet:packet' format='1.0' ttl='604800'>"+(status.toBase64())+"</packet></query>"));
-				handled = true;
-			}
-			else if(rx.setPattern("<unbind[^>]*><resource>([^<]*)</resource></unbind>"), rx.indexIn(iq.Content()) != -1)
-			{
-				if(rx.cap(1) == "boot")
-				{
-					// Boot process finished
-					bunny->Ready();
-				}
-				WriteToBunnyAndLog(iq.Reply(IQ::Iq_Result, "%1 %4", QByteArray()));
-				handled = true;
-			}
-			else if(rx.setPattern("<query xmlns='jabber:iq:version'><name>Nabaztag/tag</name><version>.*</version></query>"), rx.indexIn(iq.Content()) != -1)
-			{
-                        	if(rx.setPattern("from='"+bunny->GetID()+"@"+OjnXmppDomain+"/([^']+)'"), rx.indexIn(data) != -1)
-	                        {
-        	                        QByteArray resource = rx.cap(1).toAscii();
-                	                bunny->SetXmppResource(resource);
-                        	}
-				handled = true;
-			}
-			else
-			{
-				LogError(QString("Unknown IQ : %1").arg(QString(iq.Content())));
-			}
-		}
-		else
-		{
-			LogError(QString("Invalid IQ : %1").arg(QString(data)));
-		}
+		LogError(QString("Unable to handle bunny xmpp message : %1").arg(QString(stanza.data)));
 	}
-	else if(rx.setPattern("<presence from='(.*)' id='(.*)'></presence>"), rx.indexIn(data) != -1)
+	return true;
+}
+
+QHash<QByteArray, XmppHandler::StanzaHandler> const& XmppHandler::Handlers()
+{
+	static QHash<QByteArray, StanzaHandler> handlers;
+	if(handlers.isEmpty())
 	{
-		QByteArray from = rx.cap(1).toAscii();
-		QByteArray id = rx.cap(2).toAscii();
-		WriteToBunnyAndLog("<presence from='"+from+"' to='"+from+"' id='"+id+"'/>");
-		handled = true;
+		handlers.insert("message/button", &XmppHandler::OnButton);
+		handlers.insert("message/ears", &XmppHandler::OnEars);
+		handlers.insert("iq/bind", &XmppHandler::OnBind);
+		handlers.insert("iq/session", &XmppHandler::OnSession);
+		handlers.insert("iq/query#violet:iq:sources", &XmppHandler::OnSources);
+		handlers.insert("iq/unbind", &XmppHandler::OnUnbind);
+		handlers.insert("iq/query#jabber:iq:version", &XmppHandler::OnVersion);
+		handlers.insert("presence", &XmppHandler::OnPresence);
 	}
-	else if(data.length() == 1)
+	return handlers;
+}
+
+void XmppHandler::OnPing(XmppStanza const&)
+{
+	if(bunny->GetXmppResource() == "streaming")
 	{
-		// Bunny's ping packet, nothing to do
-		handled = true;
+		QByteArray ret = "<iq type='get' from='server@"+OjnXmppDomain+"/idle' to='"+bunny->GetID()+"@"+OjnXmppDomain+"' id='OJN-"+QByteArray::number(msgStreamNb)+"'><query xmlns='jabber:iq:version'/></iq>";
+		WriteToBunnyAndLog(ret);
+		msgStreamNb++;
+	}
+}
 
-		if(bunny->GetXmppResource() == "streaming")
-		{
-			QByteArray ret = "<iq type='get' from='server@"+OjnXmppDomain+"/idle' to='"+bunny->GetID()+"@"+OjnXmppDomain+"' id='OJN-"+QByteArray::number(msgStreamNb)+"'><query xmlns='jabber:iq:version'/></iq>";
-			WriteToBunnyAndLog(ret);
-			msgStreamNb++;
-			//return;
-		}
+bool XmppHandler::OnButton(XmppStanza const& stanza)
+{
+	// Single Click : <button xmlns="violet:nabaztag:button"><clic>1</clic></button>
+	// Double Click : <button xmlns="violet:nabaztag:button"><clic>2</clic></button>
+	QByteArray clic = stanza.Text("clic");
+	if(clic == "1")
+		return bunny->OnClick(PluginInterface::SingleClick);
+	if(clic == "2")
+		return bunny->OnClick(PluginInterface::DoubleClick);
+	LogWarning(QString("Unable to parse button message : %1").arg(QString(stanza.data)));
+	return false;
+}
 
-	}
+bool XmppHandler::OnEars(XmppStanza const& stanza)
+{
+	// <ears xmlns="violet:nabaztag:ears"><left>0</left><right>0</right></ears>
+	bool leftOk, rightOk;
+	int left = stanza.Text("left").toInt(&leftOk);
+	int right = stanza.Text("right").toInt(&rightOk);
+	if(leftOk && rightOk)
+		return bunny->OnEarsMove(left, right);
+	LogWarning(QString("Unable to parse ears message : %1").arg(QString(stanza.data)));
+	return false;
+}
 
-	// If the message wasn't handled
-	if (!handled)
+bool XmppHandler::OnBind(XmppStanza const& stanza)
+{
+	IQ iq(stanza.data);
+	QByteArray resource = stanza.Text("resource");
+	if(!iq.IsValid() || resource.isNull())
+		return false;
+	SetXmppResource(resource);
+
+	QByteArray from = bunny->GetID()+"@"+OjnXmppDomain+"/"+resource;
+	WriteToBunnyAndLog(iq.Reply(IQ::Iq_Result, "%1 %4", "<bind xmlns='urn:ietf:params:xml:ns:xmpp-bind'><jid>"+from+"</jid></bind>"));
+	return true;
+}
+
+bool XmppHandler::OnSession(XmppStanza const& stanza)
+{
+	IQ iq(stanza.data);
+	if(!iq.IsValid())
+		return false;
+	WriteToBunnyAndLog(iq.Reply(IQ::Iq_Result, "%4 %3 %2 %1", "<session xmlns='urn:ietf:params:xml:ns:xmpp-session'/>"));
+	return true;
+}
+
+bool XmppHandler::OnSources(XmppStanza const& stanza)
+{
+	IQ iq(stanza.data);
+	if(!iq.IsValid())
+		return false;
+	bunny->RequestInitPacket(this, stanza.data);
+	return true;
+}
+
+void XmppHandler::AnswerSources(QByteArray const& request, QByteArray const& initPacket)
+{
+	IQ iq(request);
+	WriteToBunnyAndLog(iq.Reply(IQ::Iq_Result, "%2 %3 %1 %4", "<query xmlns='violet:iq:sources'><packet xmlns='violet:packet' format='1.0' ttl='604800'>"+(initPacket.toBase64())+"</packet></query>"));
+}
+
+bool XmppHandler::OnUnbind(XmppStanza const& stanza)
+{
+	IQ iq(stanza.data);
+	if(!iq.IsValid())
+		return false;
+	if(stanza.Text("resource") == "boot")
 	{
-		LogError(QString("Unable to handle bunny xmpp message : %1").arg(QString(data)));
+		// Boot process finished
+		bunny->Ready();
+		ready = true;
+		SessionStore::Instance().Issue(bunny->GetID(), peerAddress);
 	}
+	WriteToBunnyAndLog(iq.Reply(IQ::Iq_Result, "%1 %4", QByteArray()));
+	return true;
+}
+
+bool XmppHandler::OnVersion(XmppStanza const& stanza)
+{
+	// <iq from='<id>@<domain>/<resource>' ...><query xmlns='jabber:iq:version'><name>Nabaztag/tag</name>...
+	QByteArray prefix = bunny->GetID()+"@"+OjnXmppDomain+"/";
+	QByteArray from = stanza.Attribute("from");
+	if(from.startsWith(prefix) && from.size() > prefix.size())
+		SetXmppResource(from.mid(prefix.size()));
+	return true;
 }
 
+bool XmppHandler::OnPresence(XmppStanza const& stanza)
+{
+	QByteArray from = stanza.Attribute("from");
+	QByteArray id = stanza.Attribute("id");
+	if(from.isNull() || id.isNull())
+		return false;
+	WriteToBunnyAndLog("<presence from='"+from+"' to='"+from+"' id='"+id+"'/>");
+	return true;
+}
 
 void XmppHandler::WriteToBunny(QByteArray const& d)
 {
-	incomingXmppSocket->write(d);
-	incomingXmppSocket->flush();
+	if(!connection)
+		return;
+	outQueue.append(d);
+	outQueueSize += d.size();
+	if(outQueueSize >= flushThreshold)
+	{
+		FlushToBunny();
+		return;
+	}
+	if(!flushScheduled)
+	{
+		flushScheduled = true;
+		QMetaObject::invokeMethod(this, "FlushToBunny", Qt::QueuedConnection);
+	}
+}
+
+void XmppHandler::FlushToBunny()
+{
+	flushScheduled = false;
+	if(outQueue.isEmpty() || !connection)
+		return;
+
+	// One write (and one send) for all the stanzas queued during this iteration
+	// The connection enforces Config/XmppMaxPendingOutput
+	QByteArray data;
+	if(outQueue.size() == 1)
+		data = outQueue.first();
+	else
+	{
+		data.reserve(outQueueSize);
+		foreach(QByteArray const& d, outQueue)
+			data.append(d);
+	}
+	outQueue.clear();
+	outQueueSize = 0;
+	// Reactor threads get it through their event queue
+	QMetaObject::invokeMethod(connection, "Write", Q_ARG(QByteArray, data));
 }
 
 void XmppHandler::WriteToBunnyAndLog(QByteArray const& d)
@@ -215,69 +389,35 @@ void XmppHandler::WriteToBunnyAndLog(QByteArray const& d)
 	WriteToBunny(d);
 }
 
-void XmppHandler::WriteDataToBunny(QByteArray const& b)
+void XmppHandler::SetXmppResource(QByteArray const& resource)
 {
-	if(bunny)
-	{
-		QByteArray msg;
-		msg.append("<message from='net.openjabnab.platform@" + OjnXmppDomain + "/services' ");
-		msg.append("to='" + bunny->GetID() + "@" + OjnXmppDomain + "/" + bunny->GetXmppResource() + "' ");
-		msg.append("id='OJaNa-" + QByteArray::number(msgNb) + "'>");
-		msg.append("<packet xmlns='violet:packet' format='1.0' ttl='604800'>");
-		msg.append(b.toBase64());
-		msg.append("</packet></message>");
-		NetworkDump::Log(QString("XMPP To Bunny (%1)").arg(QString(bunny->GetID())), msg);
-		WriteToBunny(msg);
-		msgNb++;
-	}
+	bunny->SetXmppResource(resource);
+	envelopePrefix.clear();
 }
 
-QList<QByteArray> XmppHandler::XmlParse(QByteArray const& data)
+void XmppHandler::WriteDataToBunny(QByteArray const& b)
 {
-	QList<QByteArray> list;
-	msgQueue += data.trimmed();
-
-	QRegExp rx;
+	WriteEncodedDataToBunny(b.toBase64());
+}
 
-	while(!msgQueue.isEmpty())
+void XmppHandler::WriteEncodedDataToBunny(QByteArray const& payload)
+{
+	if(bunny)
 	{
-		if (rx.setPattern("^(<\\?xml[^>]*\\?><stream:stream[^>]*>)"), rx.indexIn(msgQueue) != -1)
-		{
-			list << rx.cap(1).toAscii();
-			msgQueue.remove(0, rx.matchedLength());
-		}
-		else if (rx.setPattern("^(<[^>]*/>)"), rx.indexIn(msgQueue) != -1)
-		{
-			list << rx.cap(1).toAscii();
-			msgQueue.remove(0, rx.matchedLength());
-		}
-		else if (rx.setPattern("^(</[^>]*>)"), rx.indexIn(msgQueue) != -1) // Special case for </stream:stream>
-		{
-			list << rx.cap(1).toAscii();
-			msgQueue.remove(0, rx.matchedLength());
-		}
-		else
+		if(envelopePrefix.isEmpty())
 		{
-			// Full xml message (<xxx>....</xxx>)
-			// Find tag name
-			rx.setPattern("^<([^ >]*)");
-			if (rx.indexIn(msgQueue) == -1)
-			{
-				// Doesn't find the start tag... wait next message
-				break;
-			}
-			QString tagName = rx.cap(1);
-			// Search end tag
-			rx.setPattern(QString("(.*</%1>)").arg(tagName));
-			rx.setMinimal(true);
-			if (rx.indexIn(msgQueue) == -1)
-			{
-				// Doesn't find the end tag... wait next message
-				break;
-			}
-			list << rx.cap(1).toAscii();
-			msgQueue.remove(0, rx.matchedLength());
+			envelopePrefix = "<message from='net.openjabnab.platform@" + OjnXmppDomain + "/services' ";
+			envelopePrefix += "to='" + bunny->GetID() + "@" + OjnXmppDomain + "/" + bunny->GetXmppResource() + "' id='OJaNa-";
+			envelopeSuffix = "</packet></message>";
 		}
+		static char const packetTag[] = "'><packet xmlns='violet:packet' format='1.0' ttl='604800'>";
+		QByteArray id = QByteArray::number(msgNb);
+
+		QByteArray msg;
+		msg.reserve(envelopePrefix.size() + id.size() + sizeof(packetTag) + payload.size() + envelopeSuffix.size());
+		msg.append(envelopePrefix).append(id).append(packetTag).append(payload).append(envelopeSuffix);
+		NetworkDump::Log(QString("XMPP To Bunny (%1)").arg(QString(bunny->GetID())), msg);
+		WriteToBunny(msg);
+		msgNb++;
 	}
-	return list;
 }
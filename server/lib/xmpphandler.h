@@ -2,42 +2,98 @@
 #define _XMPPHANDLER_H_
 
 #include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QList>
 #include <QObject>
-#include <QTcpSocket>
+#include <QString>
 #include "global.h"
+#include "hotupgrade.h"
 #include "packet.h"
+#include "xmppstream.h"
 
 class Bunny;
 class PluginManager;
+class XmppConnection;
+// Bunny side of an XMPP session, moved to its connection's thread (see XmppReactor)
+// Stanzas are parsed, authenticated and answered there, the Bunny gets its state changes and plugin calls queued
 class OJN_EXPORT XmppHandler : public QObject
 {
 	Q_OBJECT
 
 public:
-	XmppHandler(QTcpSocket *);
-	void WriteDataToBunny(QByteArray const& p);
+	XmppHandler(XmppConnection *);
 	void WriteToBunnyAndLog(QByteArray const&);
 	QByteArray const& GetXmppDomain() { return OjnXmppDomain; }
 	unsigned int currentAuthStep;
+	// Milliseconds since the bunny sent something (pings included)
+	qint64 GetIdleTime() const { return lastSeen.elapsed(); }
+	QString const& GetPeerAddress() const { return peerAddress; }
+	// Called by the auth plugin, the Bunny's own state is updated later by the main thread
+	void SetAuthenticated() { authenticated = true; }
+
+	// Session given by the previous process, the bunny is already authenticated
+	// Called by the main thread before the connection starts
+	void Resume(QByteArray const& bunnyID, QByteArray const& resource, bool ready);
 
 public slots:
+	// Can be called by any thread, run by the handler's thread
 	void Disconnect();
+	void WriteDataToBunny(QByteArray const& p);
+	// Data already base64 encoded, only the envelope is added
+	void WriteEncodedDataToBunny(QByteArray const&);
+	// Answer to violet:iq:sources, with the init packet built by the main thread (see Bunny::RequestInitPacket)
+	void AnswerSources(QByteArray const& request, QByteArray const& initPacket);
+
+	// Hot upgrade : stops reading the bunny, then gives its connection and state
+	// The main thread waits for the handler's thread
+	void Pause();
+	bool Detach(HotUpgrade::Session *);
 
 protected:
 	virtual ~XmppHandler() {};
 
 private slots:
-	void HandleBunnyXmppMessage();
+	void HandleStanzas(QList<XmppStanza> const&);
+	void SetPeerAddress(QString const&);
+	void FlushToBunny();
 
 private:
-	QList<QByteArray> XmlParse(QByteArray const&);
+	typedef bool (XmppHandler::*StanzaHandler)(XmppStanza const&);
+
+	// Returns false if the bunny was disconnected
+	bool HandleStanza(XmppStanza const&);
 	void WriteToBunny(QByteArray const&);
+	void SetXmppResource(QByteArray const&);
+
+	void OnPing(XmppStanza const&);
+	bool OnButton(XmppStanza const&);
+	bool OnEars(XmppStanza const&);
+	bool OnBind(XmppStanza const&);
+	bool OnSession(XmppStanza const&);
+	bool OnSources(XmppStanza const&);
+	bool OnUnbind(XmppStanza const&);
+	bool OnVersion(XmppStanza const&);
+	bool OnPresence(XmppStanza const&);
+	static QHash<QByteArray, StanzaHandler> const& Handlers();
 
-	QTcpSocket * incomingXmppSocket;
+	XmppConnection * connection;
 	PluginManager & pluginManager;
 	Bunny * bunny;
-	QByteArray msgQueue;
+	// Session state seen by this thread, the Bunny's one is changed by the main thread
+	bool authenticated;
+	bool ready;
+	QString peerAddress;
+	QElapsedTimer lastSeen;
+	bool lastIPRecorded;
+	// Outgoing stanzas, written together once per event loop iteration
+	QList<QByteArray> outQueue;
+	int outQueueSize;
+	bool flushScheduled;
+	int flushThreshold;
+	// <message> envelope around outgoing packets, rendered when the resource changes
+	QByteArray envelopePrefix;
+	QByteArray envelopeSuffix;
 
 	QByteArray OjnXmppDomain;
 
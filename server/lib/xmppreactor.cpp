@@ -0,0 +1,59 @@
+#include <QList>
+#include <QThread>
+#include "log.h"
+#include "plugininterface.h"
+#include "settings.h"
+#include "xmppconnection.h"
+#include "xmpphandler.h"
+#include "xmppreactor.h"
+
+XmppReactor::XmppReactor():next(0) {}
+
+XmppReactor & XmppReactor::Instance()
+{
+	static XmppReactor r;
+	return r;
+}
+
+void XmppReactor::Init()
+{
+	qRegisterMetaType<XmppStanza>("XmppStanza");
+	qRegisterMetaType<QList<XmppStanza> >("QList<XmppStanza>");
+	// Calls queued between the handlers and their bunny
+	qRegisterMetaType<XmppHandler *>("XmppHandler*");
+	qRegisterMetaType<PluginInterface::ClickType>("PluginInterface::ClickType");
+
+	int count = GlobalSettings::GetInt("Config/XmppReactorThreads", 0);
+	for(int i = 0; i < count; i++)
+	{
+		QThread * thread = new QThread();
+		thread->start();
+		Instance().threads.append(thread);
+	}
+	if(count > 0)
+		LogInfo(QString("XMPP sockets are run on %1 reactor threads").arg(count));
+}
+
+void XmppReactor::Close()
+{
+	foreach(QThread * thread, Instance().threads)
+	{
+		thread->quit();
+		thread->wait();
+		delete thread;
+	}
+	Instance().threads.clear();
+}
+
+void XmppReactor::Attach(XmppConnection * c)
+{
+	if(threads.isEmpty())
+		return;
+	c->moveToThread(threads.at(next));
+	next = (next + 1) % threads.size();
+}
+
+bool XmppReactor::IsReactorThread()
+{
+	return Instance().threads.contains(QThread::currentThread());
+}
@@ -0,0 +1,30 @@
+#ifndef _XMPPREACTOR_H_
+#define _XMPPREACTOR_H_
+
+#include <QList>
+#include "global.h"
+
+class QThread;
+class XmppConnection;
+// Config/XmppReactorThreads threads running the bunnies' XMPP sessions : socket, parsing, authentication
+// and answers. Bunny state changes and plugin calls are queued to the main thread
+// With 0 threads, everything stays on the main thread
+class OJN_EXPORT XmppReactor
+{
+public:
+	static XmppReactor & Instance();
+	static void Init();
+	static void Close();
+
+	// Moves a new connection to the next thread, in turn
+	void Attach(XmppConnection *);
+	static bool IsReactorThread();
+
+private:
+	XmppReactor();
+
+	QList<QThread *> threads;
+	int next;
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include <cstring>
+#include "xmppstream.h"
+
+// Value of 'attribute' in the start tag tag[0..len[, null if missing
+static QByteArray FindAttribute(char const * tag, int len, char const * attribute)
+{
+	int attributeLen = strlen(attribute);
+	int i = 1;
+	// Skip tag name
+	while(i < len && tag[i] != ' ' && tag[i] != '/' && tag[i] != '>')
+		i++;
+	while(i < len)
+	{
+		while(i < len && (tag[i] == ' ' || tag[i] == '\t' || tag[i] == '\r' || tag[i] == '\n'))
+			i++;
+		int nameStart = i;
+		while(i < len && tag[i] != '=' && tag[i] != ' ' && tag[i] != '/' && tag[i] != '>')
+			i++;
+		int nameLen = i - nameStart;
+		if(i >= len || tag[i] != '=' || i + 1 >= len)
+			return QByteArray();
+		char quote = tag[i + 1];
+		if(quote != '\'' && quote != '"')
+			return QByteArray();
+		int valueStart = i + 2;
+		char const * valueEnd = (char const *)memchr(tag + valueStart, quote, len - valueStart);
+		if(!valueEnd)
+			return QByteArray();
+		if(nameLen == attributeLen && !memcmp(tag + nameStart, attribute, nameLen))
+			return QByteArray(tag + valueStart, valueEnd - (tag + valueStart));
+		i = valueEnd - tag + 1;
+	}
+	return QByteArray();
+}
+
+QByteArray XmppStanza::Attribute(char const * attribute) const
+{
+	return FindAttribute(data.constData() + rootTagStart, rootTagEnd - rootTagStart, attribute);
+}
+
+QByteArray XmppStanza::Text(char const * tag) const
+{
+	QByteArray open = QByteArray("<") + tag;
+	int pos = 0;
+	forever
+	{
+		pos = data.indexOf(open, pos);
+		if(pos == -1)
+			return QByteArray();
+		pos += open.size();
+		if(pos < data.size() && (data.at(pos) == '>' || data.at(pos) == ' '))
+			break;
+	}
+	int textStart = data.indexOf('>', pos);
+	if(textStart == -1 || data.at(textStart - 1) == '/')
+		return QByteArray();
+	textStart++;
+	int textEnd = data.indexOf(QByteArray("</") + tag + ">", textStart);
+	if(textEnd == -1)
+		return QByteArray();
+	return data.mid(textStart, textEnd - textStart);
+}
+
+XmppStreamParser::XmppStreamParser():start(0),cursor(0),depth(0),error(false),rootTagStart(0),rootTagEnd(0)
+{
+}
+
+void XmppStreamParser::Append(QByteArray const& data)
+{
+	if(buffer.isEmpty())
+		buffer = data; // Implicitly shared, no copy for the common single segment case
+	else
+		buffer.append(data);
+}
+
+void XmppStreamParser::TagInfo(char const * tag, int len, QByteArray & name, QByteArray & xmlns)
+{
+	int i = 1;
+	while(i < len && tag[i] != ' ' && tag[i] != '/' && tag[i] != '>' && tag[i] != '\t' && tag[i] != '\r' && tag[i] != '\n')
+		i++;
+	name = QByteArray(tag + 1, i - 1);
+	xmlns = FindAttribute(tag, len, "xmlns");
+}
+
+int XmppStreamParser::TagEnd(int pos) const
+{
+	char const * data = buffer.constData();
+	int size = buffer.size();
+	if(pos + 4 <= size && !memcmp(data + pos, "<!--", 4))
+	{
+		int end = buffer.indexOf("-->", pos + 4);
+		return end == -1 ? -1 : end + 3;
+	}
+	char quote = 0;
+	for(int i = pos + 1; i < size; i++)
+	{
+		char c = data[i];
+		if(quote)
+		{
+			if(c == quote)
+				quote = 0;
+		}
+		else if(c == '\'' || c == '"')
+			quote = c;
+		else if(c == '>')
+			return i + 1;
+	}
+	return -1;
+}
+
+void XmppStreamParser::Reset(int pos)
+{
+	start = cursor = pos;
+	depth = 0;
+	rootTagStart = rootTagEnd = 0;
+	name.clear();
+	xmlns.clear();
+	child.clear();
+	childXmlns.clear();
+	// Drop consumed bytes, without moving memory at each stanza
+	if(start == buffer.size())
+	{
+		buffer.clear();
+		start = cursor = 0;
+	}
+	else if(start >= 4096)
+	{
+		buffer.remove(0, start);
+		start = cursor = 0;
+	}
+}
+
+bool XmppStreamParser::Next(XmppStanza & stanza)
+{
+	if(error)
+		return false;
+	char const * data = buffer.constData();
+	int size = buffer.size();
+
+	// Whitespace between stanzas : the bunny's keep-alive
+	if(cursor == start && cursor < size && IsSpace(data[cursor]))
+	{
+		int end = cursor;
+		while(end < size && IsSpace(data[end]))
+			end++;
+		stanza.type = XmppStanza::Ping;
+		stanza.data = buffer.mid(start, end - start);
+		stanza.name.clear();
+		stanza.xmlns.clear();
+		stanza.child.clear();
+		stanza.childXmlns.clear();
+		stanza.rootTagStart = stanza.rootTagEnd = 0;
+		Reset(end);
+		return true;
+	}
+
+	while(cursor < size)
+	{
+		char const * lt = (char const *)memchr(data + cursor, '<', size - cursor);
+		int pos = lt ? lt - data : size;
+		if(depth == 0)
+		{
+			// Only whitespace is allowed between the prolog and the root tag
+			for(int i = cursor; i < pos; i++)
+				if(!IsSpace(data[i]))
+				{
+					error = true;
+					return false;
+				}
+		}
+		if(!lt)
+		{
+			cursor = size;
+			return false;
+		}
+		int end = TagEnd(pos);
+		if(end == -1)
+		{
+			cursor = pos; // Wait for the end of the tag
+			return false;
+		}
+		cursor = end;
+
+		char next = (pos + 1 < size) ? data[pos + 1] : 0;
+		XmppStanza::Type type;
+		if(next == '?' || next == '!')
+		{
+			// Prolog, comment : part of the current unit
+			continue;
+		}
+		else if(next == '/')
+		{
+			if(depth > 1)
+			{
+				depth--;
+				continue;
+			}
+			// </stream:stream> has no opening tag in this unit
+			type = (depth == 0) ? XmppStanza::StreamEnd : XmppStanza::Element;
+		}
+		else
+		{
+			bool selfClosing = (data[end - 2] == '/');
+			if(depth == 0)
+			{
+				TagInfo(data + pos, end - pos, name, xmlns);
+				rootTagStart = pos - start;
+				rootTagEnd = end - start;
+				if(name == "stream:stream")
+					type = XmppStanza::StreamStart; // Never closed until the end of the session
+				else if(selfClosing)
+					type = XmppStanza::Element;
+				else
+				{
+					depth = 1;
+					continue;
+				}
+			}
+			else
+			{
+				if(depth == 1 && child.isNull())
+					TagInfo(data + pos, end - pos, child, childXmlns);
+				if(!selfClosing)
+					depth++;
+				continue;
+			}
+		}
+
+		stanza.type = type;
+		stanza.data = buffer.mid(start, end - start);
+		stanza.name = name;
+		stanza.xmlns = xmlns;
+		stanza.child = child;
+		stanza.childXmlns = childXmlns;
+		stanza.rootTagStart = rootTagStart;
+		stanza.rootTagEnd = rootTagEnd;
+		Reset(end);
+		return true;
+	}
+	return false;
+}
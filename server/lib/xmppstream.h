@@ -0,0 +1,87 @@
+#ifndef _XMPPSTREAM_H_
+#define _XMPPSTREAM_H_
+
+#include <QByteArray>
+#include "global.h"
+
+// One top-level unit of the bunny's XMPP stream
+struct OJN_EXPORT XmppStanza
+{
+	enum Type { Ping, StreamStart, StreamEnd, Element };
+
+	Type type;
+	QByteArray data; // Raw bytes, as sent by the bunny
+	QByteArray name; // Root tag : iq, message, presence, auth ...
+	QByteArray xmlns;
+	QByteArray child; // First child tag : bind, query, button ...
+	QByteArray childXmlns;
+
+	// Attribute of the root tag, null if missing
+	QByteArray Attribute(char const * attribute) const;
+	// Text of the first <tag>...</tag> in the stanza, null if missing
+	QByteArray Text(char const * tag) const;
+
+private:
+	friend class XmppStreamParser;
+	int rootTagStart;
+	int rootTagEnd;
+};
+
+// Incremental framing of the Nabaztag XMPP subset
+// Bytes are appended as they come from the socket, stanzas split across
+// (or coalesced in) TCP segments are returned one by one
+class OJN_EXPORT XmppStreamParser
+{
+public:
+	XmppStreamParser();
+
+	void Append(QByteArray const&);
+	// Returns false if more data is needed or if the stream is malformed (see HasError)
+	bool Next(XmppStanza &);
+	bool HasError() const;
+	// Size of the incomplete stanza waiting for more data
+	int PendingSize() const;
+	QByteArray Pending() const;
+
+private:
+	// Returns the position after the tag starting at 'pos', -1 if incomplete
+	int TagEnd(int pos) const;
+	void Reset(int pos);
+	static bool IsSpace(char);
+	static void TagInfo(char const * tag, int len, QByteArray & name, QByteArray & xmlns);
+
+	QByteArray buffer;
+	int start; // Start of the current stanza
+	int cursor; // Next byte to scan
+	int depth;
+	bool error;
+	// Info gathered while scanning the current stanza
+	int rootTagStart;
+	int rootTagEnd;
+	QByteArray name;
+	QByteArray xmlns;
+	QByteArray child;
+	QByteArray childXmlns;
+};
+
+inline bool XmppStreamParser::HasError() const
+{
+	return error;
+}
+
+inline int XmppStreamParser::PendingSize() const
+{
+	return buffer.size() - start;
+}
+
+inline QByteArray XmppStreamParser::Pending() const
+{
+	return buffer.mid(start);
+}
+
+inline bool XmppStreamParser::IsSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+#endif
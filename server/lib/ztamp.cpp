@@ -2,18 +2,21 @@
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
+#include <QStringList>
 #include "ambientpacket.h"
 #include "ztamp.h"
 #include "bunny.h"
+#include "configwriter.h"
 #include "log.h"
 #include "httprequest.h"
 #include "netdump.h"
 #include "plugininterface.h"
 #include "pluginmanager.h"
+#include "recordstore.h"
 #include "sleeppacket.h"
 #include "xmpphandler.h"
 
-Ztamp::Ztamp(QByteArray const& ztampID)
+Ztamp::Ztamp(QByteArray const& ztampID, RecordStore const * store)
 {
 	// Check ztamps folder
 	QDir ztampsDir = QDir(QCoreApplication::applicationDirPath());
@@ -28,18 +31,27 @@ Ztamp::Ztamp(QByteArray const& ztampID)
 	}
 	id = ztampID;
 	configFileName = ztampsDir.absoluteFilePath(ztampID.toHex()+".dat");
+	journal.SetOwner(this);
 
 	// Check if config file exists and load it
-	if (QFile::exists(configFileName))
-		LoadConfig();
-
-	saveTimer = new QTimer(this);
-	connect(saveTimer, SIGNAL(timeout()), this, SLOT(SaveConfig()));
-	saveTimer->start(5*60*1000); // 5min
+	if (store && store->Contains(ztampID.toHex()))
+	{
+		QByteArray changes = store->GetJournal(ztampID.toHex());
+		journal.SetFileName(configFileName, changes.size());
+		LoadConfig(store->GetSnapshot(ztampID.toHex()), journal.Load(changes));
+	}
+	else
+	{
+		ConfigWriter::Wait(configFileName);
+		journal.SetFileName(configFileName);
+		if (QFile::exists(configFileName))
+			LoadConfig();
+	}
 }
 
 Ztamp::~Ztamp()
 {
+	PersistenceScheduler::Unschedule(this);
 	SaveConfig();
 }
 
@@ -69,8 +81,12 @@ void Ztamp::LoadConfig()
 		LogError(QString("Cannot open config file for reading : %1").arg(configFileName));
 		return;
 	}
+	LoadConfig(file.readAll(), journal.Load());
+}
 
-	QDataStream in(&file);
+void Ztamp::LoadConfig(QByteArray const& snapshot, QList<ConfigJournal::Record> const& changes)
+{
+	QDataStream in(snapshot);
 	in.setVersion(QDataStream::Qt_4_3);
 	in >> GlobalSettings >> PluginsSettings >> listOfPlugins;
 	if (in.status() != QDataStream::Ok)
@@ -78,6 +94,10 @@ void Ztamp::LoadConfig()
 		LogWarning(QString("Problem when loading config file for ztamp : %1").arg(QString(id.toHex())));
 	}
 
+	// Changes made since the config file was written
+	foreach(ConfigJournal::Record r, changes)
+		ReplayRecord(r);
+
 	// "Load" associated ztamp plugins
 	foreach(QString s, listOfPlugins)
 	{
@@ -93,17 +113,41 @@ void Ztamp::LoadConfig()
 	}
 }
 
+void Ztamp::ReplayRecord(ConfigJournal::Record const& r)
+{
+	switch(r.operation)
+	{
+		case ConfigJournal::SetGlobal:
+			GlobalSettings.insert(r.key, r.value);
+			break;
+		case ConfigJournal::RemoveGlobal:
+			GlobalSettings.remove(r.key);
+			break;
+		case ConfigJournal::SetPlugin:
+			PluginsSettings[r.plugin].insert(r.key, r.value);
+			break;
+		case ConfigJournal::RemovePlugin:
+			PluginsSettings[r.plugin].remove(r.key);
+			break;
+		case ConfigJournal::SetPluginList:
+			listOfPlugins = r.value.toStringList();
+			break;
+	}
+}
+
+// Nothing is written if nothing changed, the config file is only rewritten when the journal is too big
 void Ztamp::SaveConfig()
 {
-	QFile file(configFileName);
-	if (!file.open(QIODevice::WriteOnly))
+	if(!journal.NeedsCompaction())
 	{
-		LogError(QString("Cannot open config file for writing : %1").arg(configFileName));
+		journal.Flush();
 		return;
 	}
-	QDataStream out(&file);
+	QByteArray data;
+	QDataStream out(&data, QIODevice::WriteOnly);
 	out.setVersion(QDataStream::Qt_4_3);
 	out << GlobalSettings << PluginsSettings << listOfPlugins;// << knownRFIDTags;
+	journal.Compact(data);
 }
 
 QVariant Ztamp::GetGlobalSetting(QString const& key, QVariant const& defaultValue) const
@@ -117,11 +161,13 @@ QVariant Ztamp::GetGlobalSetting(QString const& key, QVariant const& defaultValu
 void Ztamp::SetGlobalSetting(QString const& key, QVariant const& value)
 {
 	GlobalSettings.insert(key, value);
+	journal.Append(ConfigJournal::SetGlobal, QString(), key, value);
 }
 
 void Ztamp::RemoveGlobalSetting(QString const& key)
 {
 	GlobalSettings.remove(key);
+	journal.Append(ConfigJournal::RemoveGlobal, QString(), key);
 }
 
 QVariant Ztamp::GetPluginSetting(QString const& pluginName, QString const& key, QVariant const& defaultValue) const
@@ -135,11 +181,13 @@ QVariant Ztamp::GetPluginSetting(QString const& pluginName, QString const& key,
 void Ztamp::SetPluginSetting(QString const& pluginName, QString const& key, QVariant const& value)
 {
 	PluginsSettings[pluginName].insert(key, value);
+	journal.Append(ConfigJournal::SetPlugin, pluginName, key, value);
 }
 
 void Ztamp::RemovePluginSetting(QString const& pluginName, QString const& key)
 {
 	PluginsSettings[pluginName].remove(key);
+	journal.Append(ConfigJournal::RemovePlugin, pluginName, key);
 }
 
 // API Add plugin to this ztamp
@@ -149,6 +197,7 @@ void Ztamp::AddPlugin(PluginInterface * p)
 	{
 		listOfPlugins.append(p->GetName());
 		listOfPluginsPtr.append(p);
+		journal.Append(ConfigJournal::SetPluginList, QString(), QString(), QStringList(listOfPlugins));
 		p->OnZtampConnect(this);
 		SaveConfig();
 	}
@@ -161,6 +210,7 @@ void Ztamp::RemovePlugin(PluginInterface * p)
 	{
 		listOfPlugins.removeAll(p->GetName());
 		listOfPluginsPtr.removeAll(p);
+		journal.Append(ConfigJournal::SetPluginList, QString(), QString(), QStringList(listOfPlugins));
 		p->OnZtampDisconnect(this);
 		SaveConfig();
 	}
@@ -8,12 +8,15 @@
 #include <QVariant>
 #include "apihandler.h"
 #include "apimanager.h"
+#include "configjournal.h"
 #include "global.h"
 #include "packet.h"
+#include "persistencescheduler.h"
 #include "plugininterface.h"
 
+class RecordStore;
 //class XmppHandler;
-class OJN_EXPORT Ztamp : QObject, public ApiHandler<Ztamp>
+class OJN_EXPORT Ztamp : QObject, public ApiHandler<Ztamp>, public Persistent
 {
 	friend class ZtampManager;
 	Q_OBJECT
@@ -50,8 +53,10 @@ private slots:
 	void SaveConfig();
 
 private:
-	Ztamp(QByteArray const&);
+	Ztamp(QByteArray const&, RecordStore const * store = 0);
 	void LoadConfig();
+	void LoadConfig(QByteArray const& snapshot, QList<ConfigJournal::Record> const& changes);
+	void ReplayRecord(ConfigJournal::Record const&);
 	void AddPlugin(PluginInterface * p);
 	void RemovePlugin(PluginInterface * p);
 	void OnConnect();
@@ -73,7 +78,7 @@ private:
 	QHash<QString, QHash<QString, QVariant> > PluginsSettings;
 	QList<QString> listOfPlugins;
 	QList<PluginInterface*> listOfPluginsPtr;
-	QTimer * saveTimer;
+	ConfigJournal journal; // Changes not yet in the config file
 
 	// RFID Tags
 };
@@ -1,8 +1,10 @@
 #include "account.h"
 #include "ztamp.h"
 #include "ztampmanager.h"
+#include "configwriter.h"
 #include "httprequest.h"
 #include "log.h"
+#include "responsecache.h"
 
 ZtampManager::ZtampManager()
 {
@@ -27,6 +29,17 @@ ZtampManager & ZtampManager::Instance()
 
 void ZtampManager::LoadAllZtamps()
 {
+	if(RecordStore::IsEnabled() && store.Open(RecordStore::FileName(ztampsDir)))
+	{
+		foreach(QByteArray hexID, store.Keys())
+		{
+			QByteArray ztampID = QByteArray::fromHex(hexID);
+			listOfZtamps.insert(ztampID, new Ztamp(ztampID, &store));
+		}
+		ResponseCache::Instance().ServerStatsChanged();
+		return;
+	}
+
 	LogInfo(QString("Finding ztamps in : %1").arg(ztampsDir.path()));
 	QStringList filters;
 	filters << "*.dat";
@@ -42,10 +55,14 @@ void ZtampManager::DeleteZtamp(QByteArray const& ID) {
 	if(z != NULL) {
 		LogInfo(QString("Deleted Ztamp: %1").arg(QString(z->GetID())));
 		listOfZtamps.remove(QByteArray::fromHex(z->GetID()));
+		ResponseCache::Instance().ServerStatsChanged();
 		QFile ztampFile(ztampsDir.absoluteFilePath(QString("%1.dat").arg(QString(z->GetID()))));
 		delete z;
+		// Saved by the destructor
+		ConfigWriter::Wait(ztampFile.fileName());
 		if(ztampFile.exists())
 			ztampFile.remove();
+		QFile::remove(ztampFile.fileName() + ".journal");
 	}
 }
 
@@ -73,6 +90,7 @@ Ztamp * ZtampManager::GetZtamp(QByteArray const& ztampHexID)
 
 	Ztamp * z = new Ztamp(ztampID);
 	listOfZtamps.insert(ztampID, z);
+	ResponseCache::Instance().ServerStatsChanged();
 	return z;
 }
 
@@ -94,6 +112,12 @@ void ZtampManager::Close()
 	foreach(Ztamp * z, listOfZtamps)
 		delete z;
 	listOfZtamps.clear();
+
+	// Every config file is saved, the store is written for the next start
+	ZtampManager & m = Instance();
+	if(RecordStore::IsEnabled())
+		RecordStore::Import(m.ztampsDir, RecordStore::FileName(m.ztampsDir), &m.store);
+	m.store.Close();
 }
 
 QVector<Ztamp *> ZtampManager::GetZtamps()
@@ -6,6 +6,7 @@
 #include "global.h"
 #include "apihandler.h"
 #include "apimanager.h"
+#include "recordstore.h"
 #include "ztamp.h"
 
 class Account;
@@ -48,6 +49,7 @@ private:
 	void DeleteZtamp(QByteArray const&);
 
 	QDir ztampsDir;
+	RecordStore store; // Config/UseRecordStore
 	static QHash<QByteArray, Ztamp *> listOfZtamps;
 };
 
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <signal.h>
+#include "hotupgrade.h"
 #include "openjabnab.h"
 
 OpenJabNab * o;
@@ -10,14 +11,27 @@ void sigCatcher(int)
 	QMetaObject::invokeMethod(o, "quit", Qt::QueuedConnection);
 }
 
+#ifndef Q_OS_WIN
+void sigUpgrade(int)
+{
+	QMetaObject::invokeMethod(o, "StartHotUpgrade", Qt::QueuedConnection);
+}
+#endif
+
 int main( int argc, char **argv )
 {
 	signal(SIGINT, sigCatcher);
 	signal(SIGTERM, sigCatcher);
+#ifndef Q_OS_WIN
+	signal(SIGUSR2, sigUpgrade);
+#endif
 
 	o = new OpenJabNab(argc, argv);
 	o->exec();
 	delete o;
 
+	// Replaced by the new binary (same PID), which inherits the sockets
+	if(HotUpgrade::IsPending())
+		return HotUpgrade::Exec();
 	return 0;
 }
@@ -3,22 +3,33 @@
 
 #include "openjabnab.h"
 #include "accountmanager.h"
+#include "apiexecutor.h"
 #include "bunny.h"
 #include "bunnymanager.h"
+#include "configwriter.h"
 #include "ztamp.h"
 #include "ztampmanager.h"
+#include "hotupgrade.h"
 #include "httphandler.h"
+#include "limitedtcpserver.h"
 #include "log.h"
 #include "netdump.h"
+#include "persistencescheduler.h"
 #include "pluginmanager.h"
+#include "sessionstore.h"
 #include "settings.h"
 #include "ttsmanager.h"
+#include "xmppconnection.h"
 #include "xmpphandler.h"
+#include "xmppreactor.h"
 
-OpenJabNab::OpenJabNab(int argc, char ** argv):QCoreApplication(argc, argv)
+OpenJabNab::OpenJabNab(int argc, char ** argv):QCoreApplication(argc, argv),httpListener(0),httpNativeListener(0),xmppListener(0)
 {
 	GlobalSettings::Init();
 	LogInfo("-- OpenJabNab Start --");
+	HotUpgrade::Receive(arguments());
+	ConfigWriter::Init();
+	PersistenceScheduler::Init();
 	TTSManager::Init();
 	BunnyManager::Init();
 	Bunny::Init();
@@ -28,29 +39,61 @@ OpenJabNab::OpenJabNab(int argc, char ** argv):QCoreApplication(argc, argv)
 	NetworkDump::Init();
 	PluginManager::Init();
 	BunnyManager::LoadBunnies();
+	ApiExecutor::Init();
+	XmppReactor::Init();
+	SessionStore::Init();
 	ZtampManager::LoadZtamps();
 
         int now = QDateTime::currentDateTime().toTime_t();
         int next = QDateTime(QDate::currentDate().addDays(1)).toTime_t();
         QTimer::singleShot(1000 * (next - now), this, SLOT(RotateLog()));
 
+	// Admission control, 0 means no limit
+	int maxBunnies = GlobalSettings::GetInt("Config/MaxBurstNumberOfBunnies", GlobalSettings::GetInt("Config/MaxNumberOfBunnies", 64));
+	int maxHttpConnections = GlobalSettings::GetInt("Config/MaxHttpConnections", 256);
+	int httpAcceptRate = GlobalSettings::GetInt("Config/HttpAcceptRate", 0);
+	int httpAcceptBurst = GlobalSettings::GetInt("Config/HttpAcceptBurst", 64);
+
 	if(GlobalSettings::Get("Config/HttpListener", true) == true)
 	{
 		// Create Listeners
-		httpListener = new QTcpServer(this);
-		httpListener->listen(QHostAddress::LocalHost, GlobalSettings::GetInt("OpenJabNabServers/ListeningHttpPort", 8080));
+		httpListener = new LimitedTcpServer("HTTP", maxHttpConnections, httpAcceptRate, httpAcceptBurst, this);
+		Listen(httpListener, "HTTP", QHostAddress::LocalHost, GlobalSettings::GetInt("OpenJabNabServers/ListeningHttpPort", 8080));
 		connect(httpListener, SIGNAL(newConnection()), this, SLOT(NewHTTPConnection()));
 	}
 	else
 		LogWarning("Warning : HTTP Listener is disabled !");
 
+	if(GlobalSettings::Get("Config/HttpNativeListener", false) == true)
+	{
+		// Bunnies talk HTTP/1.1 directly to OpenJabNab, without the PHP wrapper
+		int port = GlobalSettings::GetInt("OpenJabNabServers/ListeningHttpNativePort", 80);
+		LogInfo(QString("Native HTTP Port is: %1").arg(port));
+		httpNativeListener = new LimitedTcpServer("Native HTTP", maxHttpConnections, httpAcceptRate, httpAcceptBurst, this);
+		if(!Listen(httpNativeListener, "Native HTTP", QHostAddress::Any, port))
+			LogError(QString("Unable to listen on native HTTP port %1 : %2").arg(port).arg(httpNativeListener->errorString()));
+		connect(httpNativeListener, SIGNAL(newConnection()), this, SLOT(NewNativeHTTPConnection()));
+	}
+
 	if(GlobalSettings::Get("Config/XmppListener", true) == true)
 	{
 		int port = GlobalSettings::GetInt("OpenJabNabServers/ListeningXmppPort", 5222);
 		LogInfo(QString("XMPP Port is: %1").arg(port));
-		xmppListener = new QTcpServer(this);
-		xmppListener->listen(QHostAddress::Any, port);
-		connect(xmppListener, SIGNAL(newConnection()), this, SLOT(NewXMPPConnection()));
+		// Reconnection storms (power cut ...) are spread by the accept rate
+		xmppListener = new LimitedTcpServer("XMPP", maxBunnies, GlobalSettings::GetInt("Config/XmppAcceptRate", 20), GlobalSettings::GetInt("Config/XmppAcceptBurst", maxBunnies), this);
+		// Sockets are created in the reactor threads
+		xmppListener->SetDescriptorHandoff(true);
+		Listen(xmppListener, "XMPP", QHostAddress::Any, port);
+		connect(xmppListener, SIGNAL(NewDescriptor(int)), this, SLOT(NewXMPPConnection(int)));
+
+		// Bunnies connected to the previous process
+		foreach(HotUpgrade::Session s, HotUpgrade::TakeSessions())
+		{
+			XmppConnection * c = new XmppConnection(s.descriptor, s.pending);
+			xmppListener->Track(c);
+			CreateXmppHandler(c)->Resume(s.bunnyID, s.resource, s.ready);
+			QMetaObject::invokeMethod(c, "Start", Qt::QueuedConnection);
+		}
 	}
 	else
 		LogWarning("Warning : XMPP Listener is disabled !");
@@ -60,6 +103,14 @@ OpenJabNab::OpenJabNab(int argc, char ** argv):QCoreApplication(argc, argv)
 	LogInfo(QString("Parsing of HTTP Api is ").append((httpApi == true)?"enabled":"disabled"));
 }
 
+bool OpenJabNab::Listen(QTcpServer * server, QString const& name, QHostAddress const& address, quint16 port)
+{
+	int descriptor = HotUpgrade::TakeListener(name);
+	if(descriptor != -1)
+		return server->setSocketDescriptor(descriptor);
+	return server->listen(address, port);
+}
+
 void OpenJabNab::RotateLog()
 {
 	LogRotate();
@@ -70,6 +121,8 @@ void OpenJabNab::RotateLog()
 
 void OpenJabNab::Close()
 {
+	// Tickets of the bunnies still connected, before they are disconnected
+	SessionStore::Close();
 	emit Quit();
 }
 
@@ -83,12 +136,25 @@ OpenJabNab::~OpenJabNab()
 	{
 		httpListener->close();
 	}
+	if(httpNativeListener)
+	{
+		httpNativeListener->close();
+	}
+	ApiExecutor::Close();
+	XmppReactor::Close();
+	// Disconnections queued by the reactor threads (Bunny::RemoveXmppHandler)
+	sendPostedEvents();
+	// Everything is saved before the bunnies and ztamps are deleted
+	PersistenceScheduler::Close();
+	SessionStore::Close();
 	NetworkDump::Close();
 	ZtampManager::Close();
 	BunnyManager::Close();
 	TTSManager::Close();
 	PluginManager::Close();
 	AccountManager::Close();
+	// Waits for the last config files
+	ConfigWriter::Close();
 	GlobalSettings::Close();
 	LogInfo("-- OpenJabNab Close --");
 }
@@ -99,8 +165,65 @@ void OpenJabNab::NewHTTPConnection()
 	connect(this, SIGNAL(Quit()), h, SLOT(Disconnect()));
 }
 
-void OpenJabNab::NewXMPPConnection()
+void OpenJabNab::NewNativeHTTPConnection()
 {
-	XmppHandler * x = new XmppHandler(xmppListener->nextPendingConnection());
+	HttpHandler * h = new HttpHandler(httpNativeListener->nextPendingConnection(), httpApi, httpVioletApi, HttpHandler::Protocol_Http);
+	connect(this, SIGNAL(Quit()), h, SLOT(Disconnect()));
+}
+
+void OpenJabNab::NewXMPPConnection(int socketDescriptor)
+{
+	XmppConnection * c = new XmppConnection(socketDescriptor);
+	xmppListener->Track(c);
+	// Signals are connected before the connection starts reading
+	CreateXmppHandler(c);
+	QMetaObject::invokeMethod(c, "Start", Qt::QueuedConnection);
+}
+
+XmppHandler * OpenJabNab::CreateXmppHandler(XmppConnection * c)
+{
+	XmppReactor::Instance().Attach(c);
+	XmppHandler * x = new XmppHandler(c);
+	// Handled by the connection's thread, see XmppHandler::Disconnect for its deletion
+	x->moveToThread(c->thread());
 	connect(this, SIGNAL(Quit()), x, SLOT(Disconnect()));
+	connect(x, SIGNAL(destroyed(QObject *)), this, SLOT(XmppHandlerDestroyed(QObject *)));
+	xmppHandlers.insert(x);
+	return x;
+}
+
+void OpenJabNab::XmppHandlerDestroyed(QObject * o)
+{
+	xmppHandlers.remove(static_cast<XmppHandler *>(o));
+}
+
+void OpenJabNab::StartHotUpgrade()
+{
+	if(HotUpgrade::IsPending())
+		return;
+	LogInfo("Hot upgrade requested");
+	// Nothing is detached if the upgrade can't go on
+	if(!HotUpgrade::Prepare(applicationFilePath(), arguments()))
+		return;
+	if(httpListener)
+		HotUpgrade::AddListener("HTTP", httpListener->socketDescriptor());
+	if(httpNativeListener)
+		HotUpgrade::AddListener("Native HTTP", httpNativeListener->socketDescriptor());
+	if(xmppListener)
+		HotUpgrade::AddListener("XMPP", xmppListener->socketDescriptor());
+
+	// Stop reading the bunnies (what was already read is handled by the reactor threads first),
+	// then run the bunny calls it queued to this thread
+	foreach(XmppHandler * x, xmppHandlers)
+		x->Pause();
+	processEvents();
+	foreach(XmppHandler * x, xmppHandlers)
+	{
+		HotUpgrade::Session s;
+		if(x->Detach(&s))
+			HotUpgrade::AddSession(s);
+	}
+
+	Close();
+	quit();
 }
@@ -2,10 +2,15 @@
 #define _OPENJABNAB_H_
 
 #include <QCoreApplication>
+#include <QHostAddress>
+#include <QSet>
 #include <QTcpServer>
 #include "apimanager.h"
 #include "pluginmanager.h"
 
+class LimitedTcpServer;
+class XmppConnection;
+class XmppHandler;
 class OpenJabNab : public QCoreApplication
 {
 	Q_OBJECT
@@ -21,13 +26,23 @@ signals:
 private slots:
 	void RotateLog();
 	void NewHTTPConnection();
-	void NewXMPPConnection();
+	void NewNativeHTTPConnection();
+	void NewXMPPConnection(int);
+	void XmppHandlerDestroyed(QObject *);
+	// SIGUSR2
+	void StartHotUpgrade();
 
 private:
+	// Listens on the port, or takes the socket given by a hot upgrade
+	bool Listen(QTcpServer *, QString const& name, QHostAddress const&, quint16 port);
+	XmppHandler * CreateXmppHandler(XmppConnection *);
+
 	QTcpServer * httpListener;
-	QTcpServer * xmppListener;
+	QTcpServer * httpNativeListener;
+	LimitedTcpServer * xmppListener;
 	bool httpApi;
 	bool httpVioletApi;
+	QSet<XmppHandler *> xmppHandlers;
 };
 
 #endif
@@ -1,4 +1,5 @@
 #include <QDateTime>
+#include <QHash>
 #include <QMapIterator>
 #include "bunny.h"
 #include "bunnymanager.h"
@@ -47,43 +48,51 @@ bool PluginClock::OnClick(Bunny * b, PluginInterface::ClickType)
 
 void PluginClock::OnCron(Bunny *, QVariant)
 {
-	QMapIterator<Bunny *, QString> i(bunnyList);
+	// Bunnies sharing a voice get the same sound, the packet is encoded once for all of them
+	QHash<QString, QList<QByteArray> > recipients;
+	QMapIterator<QByteArray, QString> i(bunnyList);
 	while (i.hasNext()) {
 		i.next();
-		Bunny * b = i.key();
-		QString voice = i.value();
-		if(b->IsIdle())
+		Bunny * b = BunnyManager::GetConnectedBunny(i.key());
+		if(b && b->IsIdle())
 		{
-			QString hour = QDateTime::currentDateTime().toString("h");
-			QByteArray file;
-			if(voice == "tts")
-				file = TTSManager::CreateNewSound("Il est " + hour + " heure", b->GetTTSVoice());
-			else
+			QString voice = i.value();
+			recipients[(voice == "tts") ? "tts/" + b->GetTTSVoice() : voice].append(b->GetID());
+		}
+	}
+
+	QString hour = QDateTime::currentDateTime().toString("h");
+	QHashIterator<QString, QList<QByteArray> > r(recipients);
+	while (r.hasNext()) {
+		r.next();
+		QString voice = r.key();
+		QByteArray file;
+		if(voice.startsWith("tts/"))
+			file = TTSManager::CreateNewSound("Il est " + hour + " heure", voice.mid(4));
+		else
+		{
+			// Fetch available files
+			QDir * dir = GetLocalHTTPFolder();
+			if(dir)
 			{
-				// Fetch available files
-				QDir * dir = GetLocalHTTPFolder();
-				if(dir)
+				dir->cd(voice);
+				dir->cd(hour);
+				QStringList list = dir->entryList(QDir::Files|QDir::NoDotAndDotDot);
+				if(list.count())
 				{
-					dir->cd(voice);
-					dir->cd(hour);
-					QStringList list = dir->entryList(QDir::Files|QDir::NoDotAndDotDot);
-					if(list.count())
-					{
-						file = GetBroadcastHTTPPath(QString("%1/%2/%3").arg(voice, hour, list.at(qrand()%list.count())));
-					}
-					delete dir;
+					file = GetBroadcastHTTPPath(QString("%1/%2/%3").arg(voice, hour, list.at(qrand()%list.count())));
 				}
-				else
-					LogError("Invalid GetLocalHTTPFolder()");
-			}
-
-			if(!file.isNull())
-			{
-				QByteArray message = "MU "+file+"\nPL 3\nMW\n";
-				b->SendPacket(MessagePacket(message));
+				delete dir;
 			}
+			else
+				LogError("Invalid GetLocalHTTPFolder()");
 		}
 
+		if(!file.isNull())
+		{
+			QByteArray message = "MU "+file+"\nPL 3\nMW\n";
+			BunnyManager::Broadcast(MessagePacket(message), r.value(), BunnyManager::Broadcast_Idle);
+		}
 	}
 }
 
@@ -95,12 +104,12 @@ void PluginClock::OnBunnyConnect(Bunny * b)
 		LogError(QString("Bunny '%1' has invalid voice '%2'").arg(b->GetID(), voice));
 		voice = "tts";
 	}
-	bunnyList.insert(b, voice);
+	bunnyList.insert(b->GetID(), voice);
 }
 
 void PluginClock::OnBunnyDisconnect(Bunny * b)
 {
-	bunnyList.remove(b);
+	bunnyList.remove(b->GetID());
 }
 
 /*******
@@ -121,7 +130,7 @@ PLUGIN_BUNNY_API_CALL(PluginClock::Api_SetVoice)
 	if(availableVoices.contains(voice))
 	{
 		// Update cache, set new voice
-		bunnyList[bunny] = voice;
+		bunnyList[bunny->GetID()] = voice;
 		// Save new config
 		bunny->SetPluginSetting(GetName(), "voice", voice);
 
@@ -26,7 +26,8 @@ public:
 
 private:
 	QDir clockFolder;
-	QMap<Bunny*, QString> bunnyList;
+	// Connected bunnies by ID, Bunny objects can be deleted once idle
+	QMap<QByteArray, QString> bunnyList;
 	QStringList availableVoices;
 };
 
@@ -43,7 +43,6 @@ void PluginGmail::OnBunnyDisconnect(Bunny * b)
 
 void PluginGmail::OnCron(Bunny * b, QVariant)
 {
-	QMapIterator<Bunny *, QString> i(bunnyList);
 	QString email = b->GetPluginSetting(GetName(), QString("Email"), QString()).toString();
 	QString password = b->GetPluginSetting(GetName(), QString("Password"), QString()).toString();
 
@@ -65,6 +64,8 @@ void PluginGmail::OnCron(Bunny * b, QVariant)
 void PluginGmail::readData(const QHttpResponseHeader &resp)
 {
 	Bunny * bunny = BunnyManager::GetBunny(this, http.property("BunnyID").toByteArray());
+	if(!bunny)
+		return;
 
 	if (resp.statusCode() != 200)
 	{
@@ -25,7 +25,7 @@ PLUGIN_BUNNY_API_CALL(Api_SetConfig);
 PLUGIN_BUNNY_API_CALL(Api_GetConfig);
 
 private:
-QMap<Bunny*, QString> bunnyList;
+QMap<QByteArray, QString> bunnyList;
 QTcpSocket *socket;
     int emailsCount;
     int connectionId;
@@ -68,6 +68,32 @@ void PluginSleep::OnInitPacket(const Bunny * b, AmbientPacket &, SleepPacket & s
 		s.SetState(SleepPacket::Sleep);
 }
 
+// The state given by OnInitPacket changes at the next wake up or sleep time
+QDateTime PluginSleep::GetInitPacketExpiry(const Bunny * b)
+{
+	QList<QVariant> wakeupList = b->GetPluginSetting(GetName(), QString("wakeupList"), QList<QVariant>()).toList();
+	QList<QVariant> sleepList = b->GetPluginSetting(GetName(), QString("sleepList"), QList<QVariant>()).toList();
+
+	if(!IsConfigValid(wakeupList, sleepList))
+		return QDateTime();
+
+	QDateTime now = QDateTime::currentDateTime();
+	for(int i = 0; i <= 7; i++)
+	{
+		QDate date = now.date().addDays(i);
+		int day = date.dayOfWeek()-1;
+		QDateTime wakeup(date, wakeupList.at(day).toTime());
+		QDateTime sleep(date, sleepList.at(day).toTime());
+		QDateTime first = qMin(wakeup, sleep);
+		QDateTime second = qMax(wakeup, sleep);
+		if(first > now)
+			return first;
+		if(second > now)
+			return second;
+	}
+	return QDateTime();
+}
+
 void PluginSleep::UpdateState(Bunny * b)
 {
 	// Check if bunny need to sleep or not
@@ -26,6 +26,7 @@ public:
 	void OnBunnyDisconnect(Bunny *);
 	virtual bool OnRFID(Bunny *, QByteArray const&);
 	void OnInitPacket(const Bunny * b, AmbientPacket &, SleepPacket &);
+	QDateTime GetInitPacketExpiry(const Bunny * b);
 
 	void InitApiCalls();
 
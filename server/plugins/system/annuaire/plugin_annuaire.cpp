@@ -29,14 +29,15 @@ QList<BunnyInfos> PluginAnnuaire::SearchBunnyByName(QString name)
 {
 	QEventLoop loop;
 
-	QHttp *http = new QHttp(GetSettings("global/URL", "").toString(), 80);
-	http->get("/whois.php?n=" + QUrl::toPercentEncoding(name));
-	QObject::connect(http, SIGNAL(done(bool)), &loop, SLOT(quit()));
+	// Local objects, the search can be run by an Api worker thread
+	QHttp http(GetSettings("global/URL", "").toString(), 80);
+	http.get("/whois.php?n=" + QUrl::toPercentEncoding(name));
+	QObject::connect(&http, SIGNAL(done(bool)), &loop, SLOT(quit()));
 	loop.exec();
 
 	QXmlStreamReader xml;
 	xml.clear();
-	xml.addData(http->readAll());
+	xml.addData(http.readAll());
 
 	QString currentTag;
 	QList<BunnyInfos> whois = QList<BunnyInfos>();
@@ -76,14 +77,15 @@ QList<BunnyInfos> PluginAnnuaire::SearchBunnyByMac(QByteArray ID)
 {
 	QEventLoop loop;
 
-	QHttp *http = new QHttp(GetSettings("global/URL", "").toString(), 80);
-	http->get("/whois.php?nm" + QUrl::toPercentEncoding(QString(ID)));
-	QObject::connect(http, SIGNAL(done(bool)), &loop, SLOT(quit()));
+	// Local objects, the search can be run by an Api worker thread
+	QHttp http(GetSettings("global/URL", "").toString(), 80);
+	http.get("/whois.php?nm" + QUrl::toPercentEncoding(QString(ID)));
+	QObject::connect(&http, SIGNAL(done(bool)), &loop, SLOT(quit()));
 	loop.exec();
 
 	QXmlStreamReader xml;
 	xml.clear();
-	xml.addData(http->readAll());
+	xml.addData(http.readAll());
 
 	QString currentTag;
 	QList<BunnyInfos> whois = QList<BunnyInfos>();
@@ -191,7 +193,7 @@ PLUGIN_API_CALL(PluginAnnuaire::Api_VerifyMacToken)
 	Bunny * b = BunnyManager::GetBunny(hRequest.GetArg("mac").toAscii());
 	QString xml = "";
 
-	if (hRequest.GetArg("reqtoken").toAscii()==b->GetGlobalSetting("VApiToken","FAILED").toString() )
+	if (b && hRequest.GetArg("reqtoken").toAscii()==b->GetGlobalSetting("VApiToken","FAILED").toString() )
 		xml += "<verify>true</verify>\n";
 	else
 		xml += "<verify>false</verify>\n";
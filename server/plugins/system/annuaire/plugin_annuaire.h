@@ -20,6 +20,7 @@ public:
 	virtual ~PluginAnnuaire();
 
 	void OnBunnyConnect(Bunny *);
+	bool IsApiThreadSafe() const { return true; }
 	QList<BunnyInfos> SearchBunnyByName(QString name);
 	QList<BunnyInfos> SearchBunnyByMac(QByteArray ID);
 
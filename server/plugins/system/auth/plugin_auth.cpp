@@ -1,3 +1,4 @@
+#include <cstring>
 #include <QDateTime>
 #include <QStringList>
 #include "plugin_auth.h"
@@ -6,6 +7,7 @@
 #include "bunnymanager.h"
 #include "iq.h"
 #include "log.h"
+#include "sessionstore.h"
 #include "settings.h"
 #include "xmpphandler.h"
 
@@ -13,20 +15,100 @@ Q_EXPORT_PLUGIN2(plugin_auth, PluginAuth)
 
 PluginAuth::PluginAuth():PluginAuthInterface("auth", "Manage Authentication process")
 {
+	PluginManager::Instance().RegisterHttpRoute("/vl/sendMailXMPP.jsp", this);
 }
 
 // Helpers
 #include <QCryptographicHash>
 #define MD5(x) QCryptographicHash::hash(x, QCryptographicHash::Md5)
 #define MD5_HEX(x) QCryptographicHash::hash(x, QCryptographicHash::Md5).toHex()
-static QByteArray ComputeResponse(QByteArray const& username, QByteArray const& password, QByteArray const& nonce, QByteArray const& cnonce, QByteArray const& nc, QByteArray const& digest_uri, QByteArray const& mode)
+// credentialDigest = MD5(username + "::" + password), cached by the bunny
+static QByteArray ComputeHA1(QByteArray const& credentialDigest, QByteArray const& nonce, QByteArray const& cnonce)
+{
+	return MD5_HEX(credentialDigest + ":" + nonce + ":" + cnonce);
+}
+
+static QByteArray ComputeResponse(QByteArray const& HA1, QByteArray const& nonce, QByteArray const& cnonce, QByteArray const& nc, QByteArray const& digest_uri, QByteArray const& mode)
 {
-	QByteArray HA1 = MD5_HEX(MD5(username + "::" + password) + ":" + nonce + ":" + cnonce);
 	QByteArray HA2 = MD5_HEX(mode + ":" + digest_uri);
 	QByteArray response = MD5_HEX(HA1 + ":" + nonce + ":" + nc + ":" + cnonce + ":auth:" + HA2);
 	return response;
 }
 
+// authString is like : username="",nonce="",cnonce="",nc=,qop=auth,digest-uri="",response=,charset=utf-8
+struct DigestResponse
+{
+	QByteArray username;
+	QByteArray nonce;
+	QByteArray cnonce;
+	QByteArray nc;
+	QByteArray qop;
+	QByteArray digestUri;
+	QByteArray response;
+};
+
+static bool KeyIs(char const * key, int length, char const * expected)
+{
+	return (int)qstrlen(expected) == length && !memcmp(key, expected, length);
+}
+
+static bool ParseDigestResponse(QByteArray const& authString, DigestResponse & r)
+{
+	char const * p = authString.constData();
+	int size = authString.size();
+	int i = 0;
+	while(i < size)
+	{
+		int keyStart = i;
+		while(i < size && p[i] != '=')
+			i++;
+		if(i >= size)
+			return false;
+		int keyLength = i - keyStart;
+		i++;
+		int valueStart, valueEnd;
+		if(i < size && p[i] == '"')
+		{
+			valueStart = ++i;
+			while(i < size && p[i] != '"')
+				i++;
+			if(i >= size)
+				return false;
+			valueEnd = i++;
+		}
+		else
+		{
+			valueStart = i;
+			while(i < size && p[i] != ',')
+				i++;
+			valueEnd = i;
+		}
+		if(i < size && p[i] != ',')
+			return false;
+		i++;
+
+		QByteArray * value = 0;
+		char const * key = p + keyStart;
+		if(KeyIs(key, keyLength, "username"))
+			value = &r.username;
+		else if(KeyIs(key, keyLength, "nonce"))
+			value = &r.nonce;
+		else if(KeyIs(key, keyLength, "cnonce"))
+			value = &r.cnonce;
+		else if(KeyIs(key, keyLength, "nc"))
+			value = &r.nc;
+		else if(KeyIs(key, keyLength, "qop"))
+			value = &r.qop;
+		else if(KeyIs(key, keyLength, "digest-uri"))
+			value = &r.digestUri;
+		else if(KeyIs(key, keyLength, "response"))
+			value = &r.response;
+		if(value)
+			*value = QByteArray(p + valueStart, valueEnd - valueStart);
+	}
+	return !r.username.isNull() && !r.nonce.isNull() && !r.cnonce.isNull() && !r.nc.isNull() && r.qop == "auth" && !r.digestUri.isNull() && !r.response.isNull();
+}
+
 static QByteArray ComputeXor(QByteArray const& v1, QByteArray const& v2)
 {
 	QByteArray t1 = QByteArray::fromHex(v1);
@@ -85,17 +167,18 @@ bool PluginAuth::DoAuth(XmppHandler * xmpp, QByteArray const& data, Bunny ** pBu
 		case 2:
 			{
 				// We should receive <response xmlns='urn:ietf:params:xml:ns:xmpp-sasl'>...</response>
-				QRegExp rx("<response[^>]*>(.*)</response>");
-				if (rx.indexIn(data) != -1)
+				int start = data.indexOf('>');
+				int end = data.lastIndexOf("</response>");
+				if (data.startsWith("<response") && start != -1 && end > start)
 				{
-					QByteArray authString = QByteArray::fromBase64(rx.cap(1).toAscii()).replace((char)0, "");
-					// authString is like : username="",nonce="",cnonce="",nc=,qop=auth,digest-uri="",response=,charset=utf-8
-					// Parse values
-					rx.setPattern("username=\"([^\"]*)\",nonce=\"([^\"]*)\",cnonce=\"([^\"]*)\",nc=([^,]*),qop=auth,digest-uri=\"([^\"]*)\",response=([^,]*),charset=utf-8");
-					if(rx.indexIn(authString) != -1)
+					QByteArray authString = QByteArray::fromBase64(data.mid(start + 1, end - start - 1)).replace((char)0, "");
+					DigestResponse digest;
+					if(ParseDigestResponse(authString, digest))
 					{
-						QByteArray const username = rx.cap(1).toAscii();
+						QByteArray const& username = digest.username;
 						Bunny * bunny = BunnyManager::GetBunny(username);
+						if(!bunny)
+							return false;
 
 						// Check if we want to bypass auth
 						if(GlobalSettings::Get("Config/StandAloneAuthBypass", false) == true)
@@ -112,18 +195,31 @@ bool PluginAuth::DoAuth(XmppHandler * xmpp, QByteArray const& data, Bunny ** pBu
 						}
 
 
-						QByteArray const password = bunny->GetBunnyPassword();
-						QByteArray const nonce = rx.cap(2).toAscii();
-						QByteArray const cnonce = rx.cap(3).toAscii().append((char)0); // cnonce have a dummy \0 at his end :(
-						QByteArray const nc = rx.cap(4).toAscii();
-						QByteArray const digest_uri = rx.cap(5).toAscii();
-						QByteArray const bunnyResponse = rx.cap(6).toAscii();
-						if(bunnyResponse == ComputeResponse(username, password, nonce, cnonce, nc, digest_uri, "AUTHENTICATE"))
+						// The bunny's cached digest is only valid for its own id
+						QByteArray const credentialDigest = (username == bunny->GetID()) ? bunny->GetCredentialDigest() : MD5(username + "::" + bunny->GetBunnyPassword());
+						QByteArray const& nonce = digest.nonce;
+						QByteArray const cnonce = digest.cnonce + QByteArray(1, (char)0); // cnonce have a dummy \0 at his end :(
+						QByteArray const& nc = digest.nc;
+						QByteArray const& digest_uri = digest.digestUri;
+						QByteArray const HA1 = ComputeHA1(credentialDigest, nonce, cnonce);
+						if(digest.response == ComputeResponse(HA1, nonce, cnonce, nc, digest_uri, "AUTHENTICATE"))
 						{
+							// Session ticket of the last stop : success without the rspauth round trip, as StandAloneAuthBypass
+							if(SessionStore::Instance().IsValid(bunny->GetID(), xmpp->GetPeerAddress()))
+							{
+								answer.append("<success xmlns='urn:ietf:params:xml:ns:xmpp-sasl'/>");
+
+								bunny->Authenticating();
+								*pBunny = bunny; // Auth OK, set current bunny
+
+								xmpp->currentAuthStep = 4;
+								return true;
+							}
+
 							// Send challenge back
 							// <challenge xmlns='urn:ietf:params:xml:ns:xmpp-sasl'>...</challenge>
 							// rspauth=...
-							QByteArray const rspAuth = "rspauth=" + ComputeResponse(username, password, nonce, cnonce, nc, digest_uri, "");
+							QByteArray const rspAuth = "rspauth=" + ComputeResponse(HA1, nonce, cnonce, nc, digest_uri, "");
 							answer.append("<challenge xmlns='urn:ietf:params:xml:ns:xmpp-sasl'>" + rspAuth.toBase64() + "</challenge>");
 
 							bunny->Authenticating();
@@ -134,6 +230,7 @@ bool PluginAuth::DoAuth(XmppHandler * xmpp, QByteArray const& data, Bunny ** pBu
 						}
 
 						LogError(QString("Authentication failure for bunny: %1").arg(QString(username)));
+						SessionStore::Instance().Revoke(bunny->GetID());
 						// Bad password, send failure and restart auth
 						answer.append("<failure xmlns='urn:ietf:params:xml:ns:xmpp-sasl'><not-authorized/></failure>");
 						xmpp->currentAuthStep = 0;
@@ -164,6 +261,7 @@ bool PluginAuth::DoAuth(XmppHandler * xmpp, QByteArray const& data, Bunny ** pBu
 				answer.append("<?xml version='1.0'?><stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' id='1331400675' from='"+ xmpp->GetXmppDomain() +"' version='1.0' xml:lang='en'>");
 				answer.append("<stream:features><bind xmlns='urn:ietf:params:xml:ns:xmpp-bind'><required/></bind><unbind xmlns='urn:ietf:params:xml:ns:xmpp-bind'/><session xmlns='urn:ietf:params:xml:ns:xmpp-session'/></stream:features>");
 				xmpp->currentAuthStep = 0;
+				xmpp->SetAuthenticated();
 				(*pBunny)->Authenticated();
 				(*pBunny)->SetXmppHandler(xmpp);
 				// Bunny is now authenticated
@@ -186,6 +284,8 @@ bool PluginAuth::DoAuth(XmppHandler * xmpp, QByteArray const& data, Bunny ** pBu
 						QByteArray user = rx.cap(1).toAscii();
 						QByteArray password = rx.cap(2).toAscii();
 						Bunny * bunny = BunnyManager::GetBunny(user);
+						if(!bunny)
+							return false;
 						if(bunny->SetBunnyPassword(ComputeXor(user,password)))
 						{
 							answer.append(iqAuth.Reply(IQ::Iq_Result, "%1 %2 %3 %4", content));
@@ -214,6 +314,7 @@ bool PluginAuth::HttpRequestHandle(HTTPRequest & request)
 		QString mac = request.GetArg("m");
 		Bunny * b = BunnyManager::GetBunny(this, mac.toAscii());
 		b->ClearBunnyPassword();
+		SessionStore::Instance().Revoke(b->GetID());
 		LogError("Bunny just call sendMailXMPP, password reset");
 		return true;
 	}
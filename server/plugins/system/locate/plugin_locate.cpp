@@ -4,11 +4,21 @@
 #include "bunny.h"
 #include "bunnymanager.h"
 #include "log.h"
+#include "pluginmanager.h"
+#include "responsecache.h"
 #include "settings.h"
 
 Q_EXPORT_PLUGIN2(plugin_locate, PluginLocate)
 
-PluginLocate::PluginLocate():PluginInterface("locate", "Manage Locate requests", RequiredPlugin) {}
+PluginLocate::PluginLocate():PluginInterface("locate", "Manage Locate requests", RequiredPlugin)
+{
+	PluginManager::Instance().RegisterHttpRoute("/vl/locate.jsp", this);
+	// Read once, the cached answers are built from them
+	pingServer = GlobalSettings::GetString("OpenJabNabServers/PingServer");
+	broadServer = GlobalSettings::GetString("OpenJabNabServers/BroadServer");
+	xmppServer = GlobalSettings::GetString("OpenJabNabServers/XmppServer");
+	xmppPort = GlobalSettings::GetString("OpenJabNabServers/ListeningXmppPort");
+}
 
 bool PluginLocate::HttpRequestHandle(HTTPRequest & request)
 {
@@ -18,20 +28,26 @@ bool PluginLocate::HttpRequestHandle(HTTPRequest & request)
 		QString serialnumber = request.GetArg("sn").remove(':');
 		Bunny * bunny = BunnyManager::GetBunny(this, serialnumber.toAscii());
 
-		QString pingServer = bunny->GetPluginSetting(GetName(), "PingServer", GlobalSettings::GetString("OpenJabNabServers/PingServer")).toString(); 
-		QString broadServer = bunny->GetPluginSetting(GetName(), "BroadServer", GlobalSettings::GetString("OpenJabNabServers/BroadServer")).toString(); 
-		QString xmppServer = bunny->GetPluginSetting(GetName(), "XmppServer", GlobalSettings::GetString("OpenJabNabServers/XmppServer")).toString(); 
-		QString xmppPort = bunny->GetPluginSetting(GetName(), "ListeningXmppPort", GlobalSettings::GetString("OpenJabNabServers/ListeningXmppPort")).toString(); 
-
 		LogInfo(QString("Requesting LOCATE for tag %1").arg(serialnumber));
-		
+		bunny->SetGlobalSetting("LastLocate", QDateTime::currentDateTime());
+
+		// Same answer on each boot until a custom setting changes
+		QString cacheKey = ResponseCache::BunnyKey(bunny->GetID(), "locate");
+		if(ResponseCache::Instance().Get(cacheKey, request.reply))
+			return true;
+
+		QString bunnyPingServer = bunny->GetPluginSetting(GetName(), "PingServer", pingServer).toString(); 
+		QString bunnyBroadServer = bunny->GetPluginSetting(GetName(), "BroadServer", broadServer).toString(); 
+		QString bunnyXmppServer = bunny->GetPluginSetting(GetName(), "XmppServer", xmppServer).toString(); 
+		QString bunnyXmppPort = bunny->GetPluginSetting(GetName(), "ListeningXmppPort", xmppPort).toString(); 
+
 		QString locateString;
-		locateString += QString("ping %1\n").arg(pingServer);
-		locateString += QString("broad %1\n").arg(broadServer);
-		locateString += QString("xmpp_domain %1:%2\n").arg(xmppServer, xmppPort);
+		locateString += QString("ping %1\n").arg(bunnyPingServer);
+		locateString += QString("broad %1\n").arg(bunnyBroadServer);
+		locateString += QString("xmpp_domain %1:%2\n").arg(bunnyXmppServer, bunnyXmppPort);
 		request.reply = locateString.toAscii();
+		ResponseCache::Instance().Insert(cacheKey, request.reply);
 
-		bunny->SetGlobalSetting("LastLocate", QDateTime::currentDateTime());
 		bunny->SetGlobalSetting("LastLocateString", locateString);
 		
 		return true;
@@ -53,6 +69,7 @@ PLUGIN_BUNNY_API_CALL(PluginLocate::Api_SetCustomLocateSetting)
 	QString hParam = hRequest.GetArg("param");
 	if(hParam == "PingServer" || hParam == "BroadServer" || hParam == "XmppServer" || hParam == "ListeningXmppPort")
 	{
+		ResponseCache::Instance().Remove(ResponseCache::BunnyKey(bunny->GetID(), "locate"));
 		if(hRequest.GetArg("value") != "")
 		{
 			bunny->SetPluginSetting(GetName(), hParam, hRequest.GetArg("value"));
@@ -17,6 +17,13 @@ public:
 	virtual void InitApiCalls();
 	PLUGIN_BUNNY_API_CALL(Api_SetCustomLocateSetting);
 	PLUGIN_BUNNY_API_CALL(Api_GetCustomLocateSetting);
+
+private:
+	// OpenJabNabServers/* defaults, not changed while the server runs
+	QString pingServer;
+	QString broadServer;
+	QString xmppServer;
+	QString xmppPort;
 };
 
 #endif
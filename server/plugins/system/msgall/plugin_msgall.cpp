@@ -27,14 +27,20 @@ PLUGIN_API_CALL(PluginMsgall::Api_Say)
 	if(!account.IsAdmin())
 		return new ApiManager::ApiError("Access denied.");
 
-	QByteArray fileName = TTSManager::CreateNewSound(hRequest.GetArg("text"), "Claire");
+	// Sent by SoundReady to the bunnies connected at that time
+	TTSManager::CreateNewSoundAsync(hRequest.GetArg("text"), "Claire", this, SLOT(SoundReady()));
 
-	QList<QByteArray> BList = BunnyManager::GetConnectedBunniesList();
-	foreach (QByteArray BID, BList)
+	return new ApiManager::ApiOk("Message sent.");
+}
+
+void PluginMsgall::SoundReady()
+{
+	TTSReply * reply = qobject_cast<TTSReply *>(sender());
+	if(!reply || reply->GetFileName().isEmpty())
 	{
-		Bunny *b = BunnyManager::GetBunny(this, BID);
-		b->SendPacket(MessagePacket("MU " + fileName + "\nMW\n"));
+		LogError("Msgall : TTS sound could not be created");
+		return;
 	}
 
-	return new ApiManager::ApiOk("Message sent.");
+	BunnyManager::Broadcast(MessagePacket("MU " + reply->GetFileName() + "\nMW\n"));
 }
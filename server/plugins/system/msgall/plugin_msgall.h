@@ -13,6 +13,9 @@ public:
 	virtual ~PluginMsgall();
 void InitApiCalls();
 	PLUGIN_API_CALL(Api_Say);
+
+private slots:
+	void SoundReady();
 };
 
 #endif
@@ -1,14 +1,51 @@
 #include <QDateTime>
+#include <QFile>
 #include <QStringList>
 #include <memory>
 #include "plugin_record.h"
 #include "bunny.h"
 #include "bunnymanager.h"
+#include "httpbodystream.h"
 #include "log.h"
+#include "pluginmanager.h"
 #include "settings.h"
 
 Q_EXPORT_PLUGIN2(plugin_record, PluginRecord)
 
+// Writes the uploaded wav directly to the record folder
+class RecordStream : public HttpBodyStream
+{
+public:
+	RecordStream(PluginRecord * p, QString const& sn, QString const& f, QString const& path):plugin(p),serialnumber(sn),filename(f),wavFile(path),finished(false) {}
+	virtual ~RecordStream()
+	{
+		// Don't keep truncated records
+		if(!finished && wavFile.isOpen())
+		{
+			wavFile.close();
+			wavFile.remove();
+		}
+	}
+	bool Open() { return wavFile.open(QFile::WriteOnly); }
+	virtual bool Write(QByteArray const& data)
+	{
+		return wavFile.write(data) == data.size();
+	}
+	virtual void Finish(HTTPRequest &)
+	{
+		finished = true;
+		wavFile.close();
+		Bunny * b = BunnyManager::GetBunny(plugin, serialnumber.toAscii());
+		b->SetGlobalSetting("LastRecord", filename);
+	}
+private:
+	PluginRecord * plugin;
+	QString serialnumber;
+	QString filename;
+	QFile wavFile;
+	bool finished;
+};
+
 PluginRecord::PluginRecord():PluginInterface("record", "Manage Record requests", SystemPlugin)
 {
 	std::auto_ptr<QDir> dir(GetLocalHTTPFolder());
@@ -16,25 +53,32 @@ PluginRecord::PluginRecord():PluginInterface("record", "Manage Record requests",
 	{
 		recordFolder = *dir;
 	}
+	PluginManager::Instance().RegisterHttpRoute("/vl/record.jsp", this, PluginManager::HttpHandleHook | PluginManager::HttpStreamHook);
+}
+
+HttpBodyStream * PluginRecord::HttpRequestStream(HTTPRequest & request)
+{
+	QString serialnumber = request.GetArg("sn");
+	QString filename ="record_"+serialnumber+"_"+QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss")+".wav";
+	RecordStream * stream = new RecordStream(this, serialnumber, filename, recordFolder.absoluteFilePath(filename));
+	if(!stream->Open())
+	{
+		LogError("Impossible to write record file");
+		delete stream;
+		return 0;
+	}
+	return stream;
 }
 
+// Used when the whole record was received at once
 bool PluginRecord::HttpRequestHandle(HTTPRequest & request)
 {
 	QString uri = request.GetURI();
 	if (uri.startsWith("/vl/record.jsp"))
 	{
-		QString serialnumber = request.GetArg("sn");
-		QString filename ="record_"+serialnumber+"_"+QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss")+".wav";
-		QString filepath = recordFolder.absoluteFilePath(filename);
-		QFile wavFile( filepath );
-		if(wavFile.open(QFile::WriteOnly)) {
-			wavFile.write(request.GetPostRaw());
-			Bunny * b = BunnyManager::GetBunny(this, serialnumber.toAscii());
-			b->SetGlobalSetting("LastRecord", filename);
-			wavFile.close();
-		} else {
-			LogError("Impossible to write record file");
-		}
+		std::auto_ptr<HttpBodyStream> stream(HttpRequestStream(request));
+		if(stream.get() && stream->Write(request.GetPostRaw()))
+			stream->Finish(request);
 		return true;
 	}
 	return false;
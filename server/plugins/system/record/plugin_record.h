@@ -13,6 +13,7 @@ public:
 	PluginRecord();
 	virtual ~PluginRecord() {};
 	virtual bool HttpRequestHandle(HTTPRequest &);
+	virtual HttpBodyStream * HttpRequestStream(HTTPRequest &);
 private:
 	QDir recordFolder;
 };
@@ -8,11 +8,15 @@
 #include "ztamp.h"
 #include "ztampmanager.h"
 #include "log.h"
+#include "pluginmanager.h"
 #include "settings.h"
 
 Q_EXPORT_PLUGIN2(plugin_rfid, PluginRFID)
 
-PluginRFID::PluginRFID():PluginInterface("rfid", "Manage RFID requests", SystemPlugin) {}
+PluginRFID::PluginRFID():PluginInterface("rfid", "Manage RFID requests", SystemPlugin)
+{
+	PluginManager::Instance().RegisterHttpRoute("/vl/rfid.jsp", this);
+}
 
 bool PluginRFID::HttpRequestHandle(HTTPRequest & request)
 {
@@ -4,12 +4,14 @@
 #include "choregraphy.h"
 #include "httprequest.h"
 #include "messagepacket.h"
+#include "pluginmanager.h"
 
 Q_EXPORT_PLUGIN2(plugin_test, PluginTest)
 
 PluginTest::PluginTest():PluginInterface("test", "Test choregraphy generation",BunnyPlugin)
 {
 	angle = 0;
+	PluginManager::Instance().RegisterHttpRoute("/openjabnab/plugin_test", this);
 }
 
 PluginTest::~PluginTest()
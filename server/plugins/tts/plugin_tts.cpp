@@ -31,8 +31,6 @@ PLUGIN_BUNNY_API_CALL(PluginTTS::Api_Say)
 	if(!bunny->IsIdle())
 		return new ApiManager::ApiError(QString("Bunny '%1' is not connected").arg(QString(bunny->GetID())));
 
-	QByteArray fileName = TTSManager::CreateNewSound(hRequest.GetArg("text"), "Claire");
-
-	bunny->SendPacket(MessagePacket("MU " + fileName + "\nMW\n"));
+	bunny->SendTTSMessage(hRequest.GetArg("text"), "Claire", "MU %1\nMW\n");
 	return new ApiManager::ApiOk(QString("Sending '%1' to bunny '%2'").arg(hRequest.GetArg("text"), QString(bunny->GetID())));
 }
@@ -12,6 +12,7 @@ class PluginTTS : public PluginInterface
 public:
 	PluginTTS();
 	virtual ~PluginTTS() {};
+	bool IsApiThreadSafe() const { return true; }
 
 	// API
 	void InitApiCalls();
@@ -136,18 +136,13 @@ QByteArray TTSAcapela::CreateNewSound(QString text, QString voice, bool forceOve
         {
                 QString acapelaFile = rx.cap(1);
                 QUrl urlfile(acapelaFile);
-                QNetworkAccessManager * manager = new QNetworkAccessManager(this);
-                QObject::connect(manager, SIGNAL(finished(QNetworkReply*)), &loop, SLOT(quit()));
-                QNetworkReply * reply = manager->get(QNetworkRequest(urlfile));
+                // Local manager (and its reply) : CreateNewSound can be called from an Api worker thread
+                QNetworkAccessManager manager;
+                QObject::connect(&manager, SIGNAL(finished(QNetworkReply*)), &loop, SLOT(quit()));
+                QNetworkReply * reply = manager.get(QNetworkRequest(urlfile));
                 loop.exec();
-                QFile file(filePath);
-                if (!file.open(QIODevice::WriteOnly))
-                {
-                    LogError("Cannot open sound file for writing");
+                if (!WriteSoundFile(filePath, reply->readAll()))
                     return QByteArray();
-                }
-                file.write(reply->readAll());
-                file.close();
                 return ttsHTTPUrl.arg(voice, fileName).toAscii();
         }
  	LogError("Acapela demo did not return a sound file");
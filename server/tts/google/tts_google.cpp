@@ -57,14 +57,8 @@ QByteArray TTSGoogle::CreateNewSound(QString text, QString voice, bool forceOver
 	http.request(Header, ContentData);
 	loop.exec();
 
-	QFile file(filePath);
-	if (!file.open(QIODevice::WriteOnly))
-	{
-		LogError("Cannot open sound file for writing");
+	if (!WriteSoundFile(filePath, http.readAll()))
 		return QByteArray();
-	}
-	file.write(http.readAll());
-	file.close();
 	return ttsHTTPUrl.arg(voice, fileName).toAscii();
 }
 